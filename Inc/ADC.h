@@ -9,6 +9,13 @@
 #define ADC_H_
 
 #define ADC_NUM_CHANNELS                   (4)
+
+// Period (ms) at which ADC_Process() averages the readings.
+#define ADC_TICK_INCREMENT                 (250)
+
+// Rate TIM6 counts at, whatever the core clock; it triggers a sequence every 100 counts.
+#define ADC_TIMER_TICK_HZ                  (10000)
+
 #define ADC_VREF_CAL_VOLT                  (3000)
 #define ADC_MAX_COUNTS                     (4095)
 #define ADC_VREF_VOLT                      (1200)
@@ -35,8 +42,14 @@
 // Number of iterations required before we report back ADC results
 #define ADC_ITERATIONS                     (1)
 
-#define ADC_TEMP1                          (30.0)
-#define ADC_TEMP2                          (110.0)
+#define ADC_TEMP1                          (30)
+#define ADC_TEMP2                          (110)
+
+// Input dividers on the monitored supplies (total and bottom resistance).
+#define ADC_24V_DIVIDER_TOTAL              (10590)
+#define ADC_24V_DIVIDER_LOW                (590)
+#define ADC_3V3_DIVIDER_TOTAL              (25000)
+#define ADC_3V3_DIVIDER_LOW                (15000)
 
 #define ADC_TEMP1_COUNTS                   ((uint16_t*)((uint32_t)0x1FFF75A8))
 #define ADC_TEMP2_COUNTS                   ((uint16_t*)((uint32_t)0x1FFF75CA))
@@ -46,11 +59,46 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Order of the channels in the conversion sequence.
+typedef enum
+{
+  ADC_INPUT_24V,
+  ADC_INPUT_3V3,
+  ADC_INPUT_TEMPERATURE,
+  ADC_INPUT_VREFINT,
+} ADC_Input_T;
+
+typedef enum
+{
+  ADC_STATISTIC_MIN,
+  ADC_STATISTIC_MAX,
+  ADC_STATISTIC_AVG,
+  ADC_STATISTIC_COUNT,
+} ADC_Statistic_T;
+
+void     ADC_Init(void);
 void     ADC_Process(void);
+void     ADC_UpdateClock(void);
 uint16_t ADC_Get_Supply_Voltage(void);
 uint16_t ADC_Get_3V3_Voltage(void);
 uint16_t ADC_Get_VrefInt_Voltage(void);
 uint16_t ADC_Get_Temperature(void);
 bool     ADC_StartupTasksComplete(void);
 
+uint16_t ADC_GetWatchdogTrips(void);
+uint16_t ADC_CountsTo24V(uint16_t nCounts);
+uint16_t ADC_GetStatistic(ADC_Input_T eInput, ADC_Statistic_T eStatistic);
+uint16_t ADC_Get_24V_Min(void);
+uint16_t ADC_Get_24V_Max(void);
+uint16_t ADC_Get_24V_Avg(void);
+uint16_t ADC_Get_3V3_Min(void);
+uint16_t ADC_Get_3V3_Max(void);
+uint16_t ADC_Get_3V3_Avg(void);
+uint16_t ADC_Get_Temperature_Min(void);
+uint16_t ADC_Get_Temperature_Max(void);
+uint16_t ADC_Get_Temperature_Avg(void);
+uint16_t ADC_Get_VrefInt_Min(void);
+uint16_t ADC_Get_VrefInt_Max(void);
+uint16_t ADC_Get_VrefInt_Avg(void);
+
 #endif/* ADC_H_ */
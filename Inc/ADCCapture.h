@@ -0,0 +1,60 @@
+/*
+ * ADCCapture.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef ADCCAPTURE_H_
+#define ADCCAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "ModbusSlave.h"
+
+// Length of a capture of the 24V supply around a relay write,
+// and how many of the samples come before the write.
+#define ADC_CAPTURE_SAMPLES             (1024)
+#define ADC_CAPTURE_PRE_SAMPLES         (128)
+
+// Time between samples: the 247.5 cycle sample time of the 24V channel
+// plus the 12.5 cycle conversion, at the 32 MHz ADC clock.
+#define ADC_CAPTURE_SAMPLE_PERIOD_NS    (8125)
+
+// How far below the pre-write level the supply may be and still count as recovered.
+#define ADC_CAPTURE_RECOVERY_MV         (250)
+
+// Longest the relay write is held off for the samples ahead of it.
+#define ADC_CAPTURE_PRE_TIMEOUT_US      (2000)
+
+// Modbus file number (FC 0x14) of the capture.
+// Record n is sample n in mV, once the capture is complete.
+#define ADC_CAPTURE_FILE_NUMBER         (8)
+
+typedef enum
+{
+  ADC_CAPTURE_IDLE,
+  ADC_CAPTURE_ARMED,
+  ADC_CAPTURE_RUNNING,
+  ADC_CAPTURE_DONE,
+  ADC_CAPTURE_COMPLETE,
+} ADCCapture_State_T;
+
+ModbusException_T ADCCapture_Arm(uint16_t nValue);
+bool              ADCCapture_Armed(void);
+bool              ADCCapture_Running(void);
+bool              ADCCapture_Start(void);
+void              ADCCapture_Trigger(void);
+void              ADCCapture_Complete(ADC_HandleTypeDef* hadc);
+void              ADCCapture_Process(void);
+uint16_t          ADCCapture_GetState(void);
+uint16_t          ADCCapture_GetBaseline(void);
+uint16_t          ADCCapture_GetMinimum(void);
+uint16_t          ADCCapture_GetMinimumTime(void);
+uint16_t          ADCCapture_GetRecoveryTime(void);
+uint16_t          ADCCapture_GetTriggerIndex(void);
+uint16_t          ADCCapture_GetSamplePeriod(void);
+ModbusException_T ADCCapture_ReadFileRecord(uint16_t nRecord, uint16_t* pValue);
+
+#endif /* ADCCAPTURE_H_ */
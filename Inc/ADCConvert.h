@@ -0,0 +1,40 @@
+/*
+ * ADCConvert.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef ADCCONVERT_H_
+#define ADCCONVERT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ADC.h"
+
+// Conversion scale factors, folded together from the factory calibration
+// and the divider ratios by ADCConvert_Init(), so that the conversion only
+// needs integer multiplies and a couple of 32-bit divides.
+//  nVrefScale        Vref (mV) = nVrefScale / VREFINT counts
+//  n24VScale         24V (mV)  = (counts * Vref * n24VScale) >> 32
+//  n3V3Scale         3V3 (mV)  = (counts * Vref * n3V3Scale) >> 32
+//  nVrefIntScale     VREFINT (mV), likewise
+//  nTempCalQ8        Sensor counts, normalised to the calibration Vref, in Q8:
+//                      (counts * nTempCalQ8) / VREFINT counts
+//  nTempSlopeQ16     Degrees per normalised count, in Q16
+typedef struct
+{
+  uint32_t    nVrefScale;
+  uint32_t    n24VScale;
+  uint32_t    n3V3Scale;
+  uint32_t    nVrefIntScale;
+  uint32_t    nTempCalQ8;
+  int32_t     nTempOffsetQ8;
+  int32_t     nTempSlopeQ16;
+} ADCConvert_T;
+
+void     ADCConvert_Init(ADCConvert_T * pConvert, uint16_t nVrefCal, uint16_t nTempCal1, uint16_t nTempCal2);
+uint16_t ADCConvert_Sequence(const ADCConvert_T * pConvert, const uint16_t * aCounts, int32_t * aValues);
+uint16_t ADCConvert_24V(const ADCConvert_T * pConvert, uint16_t nCounts, uint16_t nVref);
+
+#endif/* ADCCONVERT_H_ */
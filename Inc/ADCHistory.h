@@ -0,0 +1,62 @@
+/*
+ * ADCHistory.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef ADCHISTORY_H_
+#define ADCHISTORY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ModbusSlave.h"
+
+// Length of the two rings kept for each channel:
+// one sample a second, and one min/avg/max aggregate a minute.
+// The second ring still fits in a single FC 0x14 read.
+#define ADCHISTORY_SECONDS             (120)
+#define ADCHISTORY_MINUTES             (60)
+#define ADCHISTORY_SAMPLE_PERIOD_MS    (1000)
+
+// Size of one step of the delta encoding, in the units of each channel.
+#define ADCHISTORY_QUANTUM_24V            (10) // mV
+#define ADCHISTORY_QUANTUM_3V3            (2)  // mV
+#define ADCHISTORY_QUANTUM_TEMPERATURE    (1)  // C
+
+// Modbus file numbers (FC 0x14) of each ring.
+// Every file is laid out as follows, a record (register) at a time:
+//   0     Number of entries
+//   1     Value of the oldest entry (its average, for the minute rings)
+//   2     Quantum
+//   3...  Entries, oldest first, packed a byte at a time (high byte first).
+//         Second rings: one byte per entry, the signed change from the
+//         previous entry, in quanta.
+//         Minute rings: three bytes per entry; the signed change of the
+//         average from the previous entry, then how far the minimum was
+//         below and the maximum above the average, in quanta.
+// Changes too large for a byte are saturated, and made up in later entries.
+#define ADCHISTORY_FILE_SECONDS_24V            (2)
+#define ADCHISTORY_FILE_SECONDS_3V3            (3)
+#define ADCHISTORY_FILE_SECONDS_TEMPERATURE    (4)
+#define ADCHISTORY_FILE_MINUTES_24V            (5)
+#define ADCHISTORY_FILE_MINUTES_3V3            (6)
+#define ADCHISTORY_FILE_MINUTES_TEMPERATURE    (7)
+
+typedef enum
+{
+  ADCHISTORY_CHANNEL_24V,
+  ADCHISTORY_CHANNEL_3V3,
+  ADCHISTORY_CHANNEL_TEMPERATURE,
+  ADCHISTORY_CHANNEL_COUNT,
+} ADCHistory_Channel_T;
+
+void              ADCHistory_Process(void);
+ModbusException_T ADCHistory_ReadSeconds24V(uint16_t nRecord, uint16_t* pValue);
+ModbusException_T ADCHistory_ReadSeconds3V3(uint16_t nRecord, uint16_t* pValue);
+ModbusException_T ADCHistory_ReadSecondsTemperature(uint16_t nRecord, uint16_t* pValue);
+ModbusException_T ADCHistory_ReadMinutes24V(uint16_t nRecord, uint16_t* pValue);
+ModbusException_T ADCHistory_ReadMinutes3V3(uint16_t nRecord, uint16_t* pValue);
+ModbusException_T ADCHistory_ReadMinutesTemperature(uint16_t nRecord, uint16_t* pValue);
+
+#endif/* ADCHISTORY_H_ */
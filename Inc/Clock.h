@@ -0,0 +1,70 @@
+/*
+ * Clock.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ModbusSlave.h"
+
+//	The two core clocks.
+//	Low is HSI16 directly. High is the main PLL, also from HSI16:
+//	/2 (shared with PLLSAI1, which clocks the ADC) x20 /2.
+//	Both run in voltage range 1; range 2 would be enough for the low clock,
+//	but not for the 32 MHz ADC clock, which runs regardless.
+#define CLOCK_LOW_HZ				(16000000)
+#define CLOCK_HIGH_HZ				(80000000)
+#define CLOCK_LOW_FLASH_LATENCY		FLASH_LATENCY_0
+#define CLOCK_HIGH_FLASH_LATENCY	FLASH_LATENCY_4
+
+//	Flash prefetch only pays for its current when there are wait states to
+//	hide, so it is on at the high clock and off at the low one. The ART
+//	instruction and data caches are set on at both clocks along with it,
+//	rather than left to what HAL_Init() made of stm32l4xx_hal_conf.h; the
+//	hot paths run from SRAM regardless (see RAMFUNC in main.h).
+
+//	How long there has to be nothing to do before dropping back to the low
+//	clock, so that back to back requests don't switch for each one.
+#define CLOCK_IDLE_HOLD_MS			(10)
+
+/*
+	Enum:	Clock_Demand_T
+	Description:
+		The kinds of work that want the high clock.
+		Each is raised and dropped by the module doing the work.
+*/
+typedef enum
+{
+	CLOCK_DEMAND_MODBUS		= (1 << 0),		//	Request coming in, or response going out
+	CLOCK_DEMAND_SPIFLASH	= (1 << 1),		//	Serial flash request queued or in progress
+	CLOCK_DEMAND_RELAY		= (1 << 2),		//	Relay write or verification under way
+}	Clock_Demand_T;
+
+/*
+	Enum:	Clock_Policy_T
+	Description:
+		How the core clock is chosen. The fixed policies are there to
+		compare latency and current against the dynamic one.
+*/
+typedef enum
+{
+	CLOCK_POLICY_LOW,
+	CLOCK_POLICY_DYNAMIC,
+	CLOCK_POLICY_HIGH,
+	CLOCK_POLICY_COUNT,
+}	Clock_Policy_T;
+
+void Clock_Demand(uint32_t nDemand, bool bActive);
+void Clock_Process(void);
+ModbusException_T Clock_SetPolicy(uint16_t nPolicy);
+uint16_t Clock_GetPolicy(void);
+uint16_t Clock_GetFrequency(void);
+uint16_t Clock_GetHighResidency(void);
+uint16_t Clock_GetSwitchCount(void);
+
+#endif /* CLOCK_H_ */
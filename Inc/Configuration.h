@@ -65,7 +65,7 @@ typedef struct
   uint8_t     nWordLength;
 
   // Fault relay map
-  // Stored as a uint16_t in EEPROM module
+  // Stored as a uint64_t in EEPROM module
 
   // Parameter Unlock Code
   bool        bParameterUnlocked;
@@ -113,10 +113,22 @@ uint16_t          Configuration_GetWordLength(void);
 
 ModbusException_T Configuration_SetFaultRelayMap(uint16_t nFaultRelayMap);
 uint16_t          Configuration_GetFaultRelayMap();
+ModbusException_T Configuration_SetFaultRelayMap_17_32(uint16_t nFaultRelayMap);
+uint16_t          Configuration_GetFaultRelayMap_17_32(void);
+ModbusException_T Configuration_SetFaultRelayMap_33_48(uint16_t nFaultRelayMap);
+uint16_t          Configuration_GetFaultRelayMap_33_48(void);
+ModbusException_T Configuration_SetFaultRelayMap_49_64(uint16_t nFaultRelayMap);
+uint16_t          Configuration_GetFaultRelayMap_49_64(void);
 
 ModbusException_T Configuration_SetFailsafeRelayEnable(uint16_t nFailsafeRelayEnable);
 uint16_t          Configuration_GetFailsafeRelayEnable();
 
+ModbusException_T Configuration_SetRelayVerifyPeriod(uint16_t nPeriod);
+uint16_t          Configuration_GetRelayVerifyPeriod(void);
+
+ModbusException_T Configuration_SetEEPROMCoalesceWindow(uint16_t nWindow);
+uint16_t          Configuration_GetEEPROMCoalesceWindow(void);
+
 ModbusException_T Configuration_SetParameterUnlockCode(uint16_t nParameterUnlockCode);
 uint16_t          Configuration_GetParameterUnlockCode(void);
 
@@ -46,21 +46,30 @@
 #endif
 
 
+//	Direct register access to the relay bus pins.
+//	These are toggled several times for every bit shifted through the chain,
+//	so going through BSRR/IDR rather than the HAL calls keeps the cost
+//	of a transfer down as more DRV8860s are added.
+#define DRV8860_GPIO_WRITE(PORT, PIN, B) \
+	((PORT)->BSRR = (B) ? (uint32_t) (PIN) : ((uint32_t) (PIN) << 16))
+#define DRV8860_GPIO_READ(PORT, PIN) \
+	(((PORT)->IDR & (PIN)) != 0)
+
 //	Macros to set pins simultaneously
 #define DRV8860_PIN_CLK(B) \
-	HAL_GPIO_WritePin(R_CLK_GPIO_Port, R_CLK_Pin, B); \
+	DRV8860_GPIO_WRITE(R_CLK_GPIO_Port, R_CLK_Pin, B); \
 	DRV8860_PIN_CLK_DBG(B)
 #define DRV8860_PIN_LAT(B) \
-	HAL_GPIO_WritePin(R_LAT_GPIO_Port, R_LAT_Pin, B); \
+	DRV8860_GPIO_WRITE(R_LAT_GPIO_Port, R_LAT_Pin, B); \
 	DRV8860_PIN_LAT_DBG(B)
 #define DRV8860_PIN_DOUT(B) \
-	HAL_GPIO_WritePin(R_DOUT_GPIO_Port, R_DOUT_Pin, B); \
+	DRV8860_GPIO_WRITE(R_DOUT_GPIO_Port, R_DOUT_Pin, B); \
 	DRV8860_PIN_DOUT_DBG(B)
 #define DRV8860_PIN_DIN() \
-	HAL_GPIO_ReadPin(R_DIN_GPIO_Port, R_DIN_Pin); \
+	DRV8860_GPIO_READ(R_DIN_GPIO_Port, R_DIN_Pin); \
 	DRV8860_PIN_DIN_DBG()
 #define DRV8860_PIN_FLT() \
-	HAL_GPIO_ReadPin(R_FLT_GPIO_Port, R_FLT_Pin); \
+	DRV8860_GPIO_READ(R_FLT_GPIO_Port, R_FLT_Pin); \
 	DRV8860_PIN_FLT_DBG()
 
 
@@ -90,6 +99,20 @@
 #define DRV8860_FR_OUT2_OL  	(1 << 1)
 #define DRV8860_FR_OUT1_OL  	(1 << 0)
 
+//	Position of the devices in the chain.
+//	Further devices follow on from DRV8860_B.
+//	Each fault register holds the open load flags for OUT1-8
+//	in the lower byte, and the over current flags in the upper byte.
+#define DRV8860_FR_OL_MASK   	(0x00FF)
+#define DRV8860_FR_OCP_SHIFT 	(8)
+
+//	Reading the fault registers back (during a DR rewrite) is left out
+//	until the sequence has been checked on the bench. Until then, the
+//	relay fault follows the fault line (and any DR mismatch), and the
+//	per-relay open load and over current registers are left out of the
+//	Modbus data model.
+//	#define DRV8860_READ_FAULT_REGISTERS
+
 #define DRV8860_A (0)
 #define DRV8860_B (1)
 
@@ -101,6 +124,9 @@ void DRV8860_ControlRegisterWrite(DRV8860_ControlRegister_T * aWrite, uint8_t nD
 void DRV8860_DataRegisterWrite(DRV8860_DataRegister_T * aWrite, uint8_t nDevCount);
 void DRV8860_ControlRegisterRead(DRV8860_ControlRegister_T * aRead, uint8_t nDevCount);
 void DRV8860_DataRegisterRead(DRV8860_DataRegister_T * aRead, uint8_t nDevCount);
+#ifdef DRV8860_READ_FAULT_REGISTERS
+void DRV8860_DataRegisterWriteFaultRead(DRV8860_DataRegister_T * aWrite, DRV8860_FaultRegister_T * aFault, uint8_t nDevCount);
+#endif
 
 void DRV8860_Update_Driver_Output(uint16_t nPattern);
 
@@ -10,6 +10,7 @@
 
 //	Debug macros
 //	#define DEBUG_USE_J19_HEADER_AS_RELAY_OUTPUT
+//	#define DEBUG_HOT_PATHS_IN_FLASH
 
 //	Other debug macro enables, if required by certain macros
 #ifdef DEBUG_USE_J19_HEADER_AS_RELAY_OUTPUT
@@ -0,0 +1,95 @@
+/*
+ * Diagnostics.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "ModbusSlave.h"
+
+//	Current value of the DWT cycle counter.
+//	Free-running at the core clock, wraps roughly every 268 seconds at 16MHz.
+//	Differences between two readings are safe across a single wrap.
+#define DIAGNOSTICS_CYCLES() (DWT->CYCCNT)
+
+//	Weight of the loop time moving average, as a power of two.
+//	A value of 4 averages over roughly the last 16 passes.
+#define DIAGNOSTICS_LOOP_AVERAGE_SHIFT (4)
+
+/*
+	Enum:	Diagnostics_HotPath_T
+	Description:
+		The hot paths run from SRAM (see RAMFUNC in main.h). Their run
+		times are kept in cycles, to compare builds with and without
+		DEBUG_HOT_PATHS_IN_FLASH, and the low and high clocks.
+*/
+typedef enum
+{
+	DIAGNOSTICS_HOTPATH_MODBUS_RX,		//	Modbus byte in, USART1 receive interrupt
+	DIAGNOSTICS_HOTPATH_MODBUS_IRQ,		//	Modbus interrupt, collecting and answering a request
+	DIAGNOSTICS_HOTPATH_MODBUS_CRC,		//	CRC16 check of a complete request
+	DIAGNOSTICS_HOTPATH_DRV8860_WRITE,	//	DRV8860 data register write
+	DIAGNOSTICS_HOTPATH_DRV8860_READ,	//	DRV8860 data and fault register read
+	DIAGNOSTICS_HOTPATH_COUNT,
+}	Diagnostics_HotPath_T;
+
+//	Modbus file number (FC 0x14) of the hot path run times.
+//	Each hot path takes DIAGNOSTICS_HOTPATH_REGISTERS records (registers), in the order above:
+//		0	Shortest run (cycles), high word
+//		1	Shortest run (cycles), low word
+//		2	Longest run (cycles), high word
+//		3	Longest run (cycles), low word
+//		4	Runs, since power up
+#define DIAGNOSTICS_HOTPATH_FILE_NUMBER		(10)
+#define DIAGNOSTICS_HOTPATH_REGISTERS		(5)
+
+/*
+	Enum:	Diagnostics_Benchmark_T
+	Description:
+		Fixed workloads timed with the ART caches as Clock_Switch() sets
+		them, and again with both caches off, once at each core clock.
+		The CRC16 run is the Modbus CRC hot path (code in SRAM, tables in
+		flash); the flash CRC run is code and data both in flash.
+*/
+typedef enum
+{
+	DIAGNOSTICS_BENCHMARK_CRC16,		//	CRC16() over the first DIAGNOSTICS_BENCHMARK_BYTES of SRAM
+	DIAGNOSTICS_BENCHMARK_FLASH_CRC,	//	CRC_Fast_CRC16() over DIAGNOSTICS_BENCHMARK_BYTES of flash
+	DIAGNOSTICS_BENCHMARK_COUNT,
+}	Diagnostics_Benchmark_T;
+
+//	Size of the benchmark workloads, a maximum length Modbus frame.
+//	The contents don't matter, only the time taken.
+//	Each is timed DIAGNOSTICS_BENCHMARK_RUNS times and the shortest run
+//	kept, so an interrupt landing in one of them doesn't count.
+#define DIAGNOSTICS_BENCHMARK_BYTES			(256)
+#define DIAGNOSTICS_BENCHMARK_RUNS			(4)
+
+//	The benchmarks follow the hot paths in the same file, with
+//	DIAGNOSTICS_BENCHMARK_REGISTERS records each, in the order above
+//	(cycles, saturated, 0 until that clock has been reached):
+//		0	Low clock, caches on
+//		1	Low clock, caches off
+//		2	High clock, caches on
+//		3	High clock, caches off
+#define DIAGNOSTICS_BENCHMARK_REGISTERS		(4)
+
+void Diagnostics_Init(void);
+uint32_t Diagnostics_CyclesToMicroseconds(uint32_t nCycles);
+void Diagnostics_LoopProcess(void);
+
+uint16_t Diagnostics_GetLoopTimeLast(void);
+uint16_t Diagnostics_GetLoopTimeMax(void);
+uint16_t Diagnostics_GetLoopTimeAverage(void);
+
+void Diagnostics_HotPathRecord(Diagnostics_HotPath_T eHotPath, uint32_t nStart);
+void Diagnostics_CacheBenchmark(bool bHighClock);
+ModbusException_T Diagnostics_ReadHotPathRecord(uint16_t nRecord, uint16_t * pValue);
+
+#endif /* DIAGNOSTICS_H_ */
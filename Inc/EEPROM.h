@@ -11,20 +11,44 @@
 typedef enum
 {
   NVVER_V0,
+  NVVER_V1,
+  NVVER_V2,
   NVVER_MAX = 0xFFFF,
 } EEPROM_Version_T;
 
+// The version presently written out.
+// From NVVER_V2 on, the configuration is stored as a log of records
+// (see EEPROM_Record_T) rather than as a single structure at page 0.
+#define NVVER_CURRENT    (NVVER_V2)
+
+// The configuration log occupies the first EEPROM_LOG_PAGE_COUNT pages
+// of the serial flash, one record per page, written round-robin.
+// The remaining pages are left free for other users of the flash.
+#define EEPROM_LOG_FIRST_PAGE    (0)
+#define EEPROM_LOG_PAGE_COUNT    (96)
+
+// How long changes are collected in the RAM mirror before the
+// dirty pages are written out, in milliseconds.
+#define EEPROM_COALESCE_WINDOW_MS_DEFAULT    (250)
+#define EEPROM_COALESCE_WINDOW_MS_MAX        (10000)
+
+// The in-RAM copy of the configuration.
+// This is also the NVVER_V1 layout, which was written as-is to page 0.
 typedef struct
 {
   // Configuration structure version
   EEPROM_Version_T    nVersion;
 
   // Parameters
-  uint16_t    nFaultRegisterMap;
   uint16_t    nFailsafeRelayEnable;
+  // Reserved (zero) in NVVER_V1; zero reads as the default
+  // period (see Relay_GetVerifyPeriod()).
+  uint16_t    nRelayVerifyPeriod;
+  uint64_t    nFaultRegisterMap;
 
   // CRC
   // The CRC shall always be the last value.
+  // It covers everything up to (but not including) itself.
   uint16_t    nCRC;
 
 } EEPROM_Configuration_T;
@@ -33,10 +57,23 @@ typedef struct
 #define EEPROM_DEFAULT_FAILSAFE_RELAY_ENABLE    (1)
 
 void     EEPROM_Process(void);
-uint16_t EEPROM_GetFaultRegisterMap(void);
-void     EEPROM_SetFaultRegisterMap(uint16_t nFaultRegisterMap);
+bool     EEPROM_Ready(void);
+void     EEPROM_MarkConfigurationAsDirty(void);
+uint64_t EEPROM_GetFaultRegisterMap(void);
+void     EEPROM_SetFaultRegisterMap(uint64_t nFaultRegisterMap);
 uint16_t EEPROM_GetFailsafeRelayEnable(void);
 void     EEPROM_SetFailsafeRelayEnable(uint16_t nFailsafeRelayEnable);
+uint16_t EEPROM_GetRelayVerifyPeriod(void);
+void     EEPROM_SetRelayVerifyPeriod(uint16_t nRelayVerifyPeriod);
 void     EEPROM_SetDefaultEEPROMValues(void);
 
+bool     EEPROM_MirrorRead(uint16_t nAddress, void* pBuffer, uint16_t nSize);
+bool     EEPROM_MirrorWrite(uint16_t nAddress, const void* pBuffer, uint16_t nSize);
+bool     EEPROM_SetCoalesceWindow(uint16_t nWindow);
+uint16_t EEPROM_GetCoalesceWindow(void);
+uint16_t EEPROM_GetPageWriteCount(void);
+uint16_t EEPROM_GetPageFlushCount(void);
+uint16_t EEPROM_GetCoalescingRatio(void);
+uint16_t EEPROM_GetVerifyFailureCount(void);
+
 #endif/* EEPROM_H_ */
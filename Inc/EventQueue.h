@@ -0,0 +1,58 @@
+/*
+ * EventQueue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef EVENTQUEUE_H_
+#define EVENTQUEUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ModbusSlave.h"
+
+//	Number of events held until the master acknowledges them.
+#define EVENTQUEUE_SIZE				(64)
+
+//	Each event is a single register:
+//		Bits 15-12	Type (EventQueue_Type_T)
+//		Bits 11-8	Detail, depending on the type
+//		Bits 7-0	Index, depending on the type
+#define EVENTQUEUE_EVENT(type, detail, index)	((uint16_t) ((((type) & 0x0F) << 12) | (((detail) & 0x0F) << 8) | ((index) & 0xFF)))
+
+/*
+	Enum:	EventQueue_Type_T
+	Description:
+		The kinds of change reported through the event queue.
+*/
+typedef enum
+{
+	EVENTQUEUE_TYPE_OVERFLOW,		//	Events were lost here.		Detail, index: unused
+	EVENTQUEUE_TYPE_RELAY,			//	A relay changed.			Detail: 1 = on, 0 = off.		Index: relay (0 = relay 1)
+	EVENTQUEUE_TYPE_FAULT,			//	A fault bit changed.		Detail: 1 = set, 0 = clear.		Index: Fault_T
+	EVENTQUEUE_TYPE_THRESHOLD,		//	An ADC reading crossed a limit.	Detail: EventQueue_Threshold_T.	Index: EventQueue_Channel_T
+}	EventQueue_Type_T;
+
+typedef enum
+{
+	EVENTQUEUE_THRESHOLD_IN_BAND,
+	EVENTQUEUE_THRESHOLD_LOW,
+	EVENTQUEUE_THRESHOLD_HIGH,
+}	EventQueue_Threshold_T;
+
+typedef enum
+{
+	EVENTQUEUE_CHANNEL_24V,
+	EVENTQUEUE_CHANNEL_3V3,
+	EVENTQUEUE_CHANNEL_TEMPERATURE,
+}	EventQueue_Channel_T;
+
+void EventQueue_Post(EventQueue_Type_T eType, uint8_t nDetail, uint8_t nIndex);
+uint16_t EventQueue_Read(uint16_t * pEvents, uint16_t nMax);
+ModbusException_T EventQueue_Acknowledge(uint16_t nSequence);
+uint16_t EventQueue_GetSequence(void);
+uint16_t EventQueue_GetCount(void);
+uint16_t EventQueue_GetOverflowCount(void);
+
+#endif /* EVENTQUEUE_H_ */
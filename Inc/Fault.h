@@ -17,7 +17,8 @@
 //			I'm not as familiar with editing that, so for now, we'll hardcode the value.
 #define FAULT_CRC_FLASH_SIZE_BYTES (1024 * 128)
 #define FAULT_CRC_FLASH_SIZE_WORD (FAULT_CRC_FLASH_SIZE_BYTES / 4)
-#define FAULT_CRC_DIVISOR (16)
+#define FAULT_CRC_FLASH_ADDRESS (0x08000000)
+#define FAULT_CRC_STORED_ADDRESS (FAULT_CRC_FLASH_ADDRESS + FAULT_CRC_FLASH_SIZE_BYTES - 4)
 #define FAULT_CRC_CALCULATE_RATE_MS (60000)
 
 
@@ -49,5 +50,7 @@ uint16_t Fault_NotOK(void);
 //	CRC
 void Fault_CRC_Process(void);
 bool Fault_CRC_StartupTasksComplete(void);
+uint16_t Fault_CRC_GetStallMax(void);
+uint16_t Fault_CRC_GetStallAverage(void);
 
 #endif /* FAULT_H_ */
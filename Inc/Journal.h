@@ -0,0 +1,71 @@
+/*
+ * Journal.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ModbusSlave.h"
+#include "SPIFlash.h"
+#include "EEPROM.h"
+
+//	The journal takes the pages of the serial flash after the configuration log.
+#define JOURNAL_FIRST_PAGE			(EEPROM_LOG_FIRST_PAGE + EEPROM_LOG_PAGE_COUNT)
+#define JOURNAL_PAGE_COUNT			(SPIFLASH_PAGE_COUNT - JOURNAL_FIRST_PAGE)
+#define JOURNAL_ENTRY_SIZE			(16)
+#define JOURNAL_ENTRY_COUNT			((JOURNAL_PAGE_COUNT * SPIFLASH_PAGE_SIZE) / JOURNAL_ENTRY_SIZE)
+
+//	Number of events that can be waiting to be written to the journal.
+//	Events are queued from wherever they happen (including interrupts,
+//	and before the serial flash has been read in) and written by Journal_Process().
+#define JOURNAL_QUEUE_SIZE			(24)
+
+//	Modbus file number (FC 0x14) under which the journal is read.
+//	Each entry takes JOURNAL_ENTRY_REGISTERS records (registers), oldest entry first:
+//		0, 1	Sequence number (high, low)
+//		2		Boot number
+//		3, 4	Uptime since that boot, in milliseconds (high, low)
+//		5		Event (high byte) and code (low byte)
+//		6		Data
+//		7		CRC of the entry
+#define JOURNAL_FILE_NUMBER			(1)
+#define JOURNAL_ENTRY_REGISTERS		(JOURNAL_ENTRY_SIZE / 2)
+
+/*
+	Enum:	JournalEvent_T
+	Description:
+		The kinds of event recorded in the journal, along with what
+		the code and data of each means.
+		Loss of Modbus communication is recorded as FAULT_MODBUS.
+*/
+typedef enum
+{
+	JOURNAL_EVENT_NONE,
+	JOURNAL_EVENT_RESET,			//	Code: unused,		Data: RCC_CSR reset flags (bits 24-31)
+	JOURNAL_EVENT_FAULT_SET,		//	Code: Fault_T,		Data: all faults, after the change
+	JOURNAL_EVENT_FAULT_CLEAR,		//	Code: Fault_T,		Data: all faults, after the change
+	JOURNAL_EVENT_RELAY_CHANGE,		//	Code: relay word (0 = relays 1-16, ...),	Data: relay states
+	JOURNAL_EVENT_CONFIG_WRITE,		//	Code: JournalConfig_T,	Data: new value (low 16 bits)
+}	JournalEvent_T;
+
+typedef enum
+{
+	JOURNAL_CONFIG_FAULT_RELAY_MAP,			//	0-3, one for each word of the map
+	JOURNAL_CONFIG_FAILSAFE_RELAY_ENABLE = 4,
+	JOURNAL_CONFIG_DEFAULTS,
+	JOURNAL_CONFIG_RELAY_VERIFY_PERIOD,
+}	JournalConfig_T;
+
+void Journal_Init(void);
+void Journal_Log(JournalEvent_T eEvent, uint8_t nCode, uint16_t nData);
+void Journal_Process(void);
+ModbusException_T Journal_ReadFileRecord(uint16_t nRecord, uint16_t * pValue);
+uint16_t Journal_GetEntryCount(void);
+uint16_t Journal_GetDroppedCount(void);
+
+#endif /* JOURNAL_H_ */
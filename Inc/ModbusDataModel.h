@@ -9,6 +9,7 @@
 #define MODBUSDATAMODEL_H_
 
 #include "ModbusSlave.h"
+#include "DRV8860.h"
 
 #define HOLDING_REGISTER(addr, str, read, write) \
   case addr: \
@@ -16,6 +17,22 @@
     pWriteFunction = write; \
     break;
 
+//	The per-relay open load and over current maps are only offered
+//	while the DRV8860 fault registers are read back (see DRV8860.h).
+#ifdef DRV8860_READ_FAULT_REGISTERS
+#define FOREACH_RELAY_DIAGNOSTIC_REGISTER(HOLDING_REGISTER) \
+  HOLDING_REGISTER(1140,  "Relay Open Load",              Relay_GetOpenLoad,                NULL) \
+  HOLDING_REGISTER(1141,  "Relay Open Load 17-32",        Relay_GetOpenLoad_17_32,          NULL) \
+  HOLDING_REGISTER(1142,  "Relay Open Load 33-48",        Relay_GetOpenLoad_33_48,          NULL) \
+  HOLDING_REGISTER(1143,  "Relay Open Load 49-64",        Relay_GetOpenLoad_49_64,          NULL) \
+  HOLDING_REGISTER(1150,  "Relay Over Current",           Relay_GetOverCurrent,             NULL) \
+  HOLDING_REGISTER(1151,  "Relay Over Current 17-32",     Relay_GetOverCurrent_17_32,       NULL) \
+  HOLDING_REGISTER(1152,  "Relay Over Current 33-48",     Relay_GetOverCurrent_33_48,       NULL) \
+  HOLDING_REGISTER(1153,  "Relay Over Current 49-64",     Relay_GetOverCurrent_49_64,       NULL)
+#else
+#define FOREACH_RELAY_DIAGNOSTIC_REGISTER(HOLDING_REGISTER)
+#endif
+
 #define FOREACH_HOLDING_REGISTER(HOLDING_REGISTER) \
   HOLDING_REGISTER(1101,  "Relay States Requested", Relay_Get,                              Relay_Request) \
   HOLDING_REGISTER(1102,  "Relay States Actual",    Relay_Get,                              NULL) \
@@ -25,6 +42,19 @@
   HOLDING_REGISTER(1106,  "Supply Voltage",         ADC_Get_Supply_Voltage,                 NULL) \
   HOLDING_REGISTER(1107,  "3.3V Reference Voltage", ADC_Get_3V3_Voltage,                    NULL) \
   HOLDING_REGISTER(1108,  "Temperature (C)",        ADC_Get_Temperature,                    NULL) \
+  HOLDING_REGISTER(1111,  "Relay States Requested 17-32", Relay_Get_17_32,                  Relay_Request_17_32) \
+  HOLDING_REGISTER(1112,  "Relay States Requested 33-48", Relay_Get_33_48,                  Relay_Request_33_48) \
+  HOLDING_REGISTER(1113,  "Relay States Requested 49-64", Relay_Get_49_64,                  Relay_Request_49_64) \
+  HOLDING_REGISTER(1121,  "Relay States Actual 17-32",    Relay_Get_17_32,                  NULL) \
+  HOLDING_REGISTER(1122,  "Relay States Actual 33-48",    Relay_Get_33_48,                  NULL) \
+  HOLDING_REGISTER(1123,  "Relay States Actual 49-64",    Relay_Get_49_64,                  NULL) \
+  HOLDING_REGISTER(1131,  "Relay Fault 17-32",            Relay_GetFaulted_17_32,           NULL) \
+  HOLDING_REGISTER(1132,  "Relay Fault 33-48",            Relay_GetFaulted_33_48,           NULL) \
+  HOLDING_REGISTER(1133,  "Relay Fault 49-64",            Relay_GetFaulted_49_64,           NULL) \
+  FOREACH_RELAY_DIAGNOSTIC_REGISTER(HOLDING_REGISTER) \
+  HOLDING_REGISTER(1160,  "Transient Capture Arm",        ADCCapture_GetState,              ADCCapture_Arm) \
+  HOLDING_REGISTER(1161,  "Clock Policy",                 Clock_GetPolicy,                  Clock_SetPolicy) \
+  HOLDING_REGISTER(1162,  "Event Queue Acknowledge",      EventQueue_GetSequence,           EventQueue_Acknowledge) \
   HOLDING_REGISTER(2100,  "Parameter Unlock",       Configuration_GetParameterUnlockCode,   Configuration_SetParameterUnlockCode) \
   HOLDING_REGISTER(2101,  "RS-485 Node Address",    Configuration_GetModbusAddress,         NULL) \
   HOLDING_REGISTER(2102,  "Baud Rate",              Configuration_IsBaudRate19200,          NULL) \
@@ -32,6 +62,11 @@
   HOLDING_REGISTER(2104,  "Parity",                 Configuration_GetParity,                NULL) \
   HOLDING_REGISTER(2105,  "Fault Relay Map",        Configuration_GetFaultRelayMap,         Configuration_SetFaultRelayMap) \
   HOLDING_REGISTER(2106,  "Failsafe Relay Enable",  Configuration_GetFailsafeRelayEnable,   Configuration_SetFailsafeRelayEnable) \
+  HOLDING_REGISTER(2107,  "Relay Verify Period (ms)", Configuration_GetRelayVerifyPeriod, Configuration_SetRelayVerifyPeriod) \
+  HOLDING_REGISTER(2108,  "Fault Relay Map 17-32",  Configuration_GetFaultRelayMap_17_32,   Configuration_SetFaultRelayMap_17_32) \
+  HOLDING_REGISTER(2109,  "Fault Relay Map 33-48",  Configuration_GetFaultRelayMap_33_48,   Configuration_SetFaultRelayMap_33_48) \
+  HOLDING_REGISTER(2110,  "Fault Relay Map 49-64",  Configuration_GetFaultRelayMap_49_64,   Configuration_SetFaultRelayMap_49_64) \
+  HOLDING_REGISTER(2111,  "EEPROM Coalesce Window (ms)", Configuration_GetEEPROMCoalesceWindow, Configuration_SetEEPROMCoalesceWindow) \
   HOLDING_REGISTER(2800,  "Manual Override Enable", Configuration_GetManualOverrideEnabled, Configuration_SetManualOverrideEnabled) \
   HOLDING_REGISTER(2801,  "Green LED State",        Configuration_GetGreenLED,              Configuration_SetGreenLED) \
   HOLDING_REGISTER(2802,  "Red LED State",          Configuration_GetRedLED,                Configuration_SetRedLED) \
@@ -51,6 +86,61 @@
   INPUT_REGISTER(1200, "Software Version Major",  Configuration_GetMajorVersion, NULL) \
   INPUT_REGISTER(1201, "Software Version Minor",  Configuration_GetMinorVersion, NULL) \
   INPUT_REGISTER(1202, "Software Version Build",  Configuration_GetBuildVersion, NULL) \
+  INPUT_REGISTER(1300, "Loop Time Last (us)",     Diagnostics_GetLoopTimeLast,    NULL) \
+  INPUT_REGISTER(1301, "Loop Time Max (us)",      Diagnostics_GetLoopTimeMax,     NULL) \
+  INPUT_REGISTER(1302, "Loop Time Average (us)",  Diagnostics_GetLoopTimeAverage, NULL) \
+  INPUT_REGISTER(1303, "Relay Write Count",       Relay_GetWriteCount,            NULL) \
+  INPUT_REGISTER(1304, "Relay Verify Failures",   Relay_GetVerifyFailureCount,    NULL) \
+  INPUT_REGISTER(1305, "Relay Latency P50 (us)",  Relay_GetLatencyP50,            NULL) \
+  INPUT_REGISTER(1306, "Relay Latency P90 (us)",  Relay_GetLatencyP90,            NULL) \
+  INPUT_REGISTER(1307, "Relay Latency P99 (us)",  Relay_GetLatencyP99,            NULL) \
+  INPUT_REGISTER(1308, "Relay Latency Max (us)",  Relay_GetLatencyMax,            NULL) \
+  INPUT_REGISTER(1309, "Relay Latency Samples",   Relay_GetLatencyCount,          NULL) \
+  INPUT_REGISTER(1310, "Fault Reaction Last (us)", Relay_GetFaultReactionLast,    NULL) \
+  INPUT_REGISTER(1311, "Fault Reaction Max (us)", Relay_GetFaultReactionMax,      NULL) \
+  INPUT_REGISTER(1312, "EEPROM Page Writes",      EEPROM_GetPageWriteCount,       NULL) \
+  INPUT_REGISTER(1313, "EEPROM Page Flushes",     EEPROM_GetPageFlushCount,       NULL) \
+  INPUT_REGISTER(1314, "EEPROM Coalescing Ratio (x100)", EEPROM_GetCoalescingRatio, NULL) \
+  INPUT_REGISTER(1315, "EEPROM Verify Failures",  EEPROM_GetVerifyFailureCount,   NULL) \
+  INPUT_REGISTER(1316, "Journal Entries",         Journal_GetEntryCount,          NULL) \
+  INPUT_REGISTER(1317, "Journal Dropped Events",  Journal_GetDroppedCount,        NULL) \
+  INPUT_REGISTER(EVENTQUEUE_FIFO_ADDRESS, "Event Queue Count", EventQueue_GetCount, NULL) \
+  INPUT_REGISTER(1319, "Event Queue Overflows",   EventQueue_GetOverflowCount,    NULL) \
+  INPUT_REGISTER(1320, "Flash CRC Stall Max (us)", Fault_CRC_GetStallMax,        NULL) \
+  INPUT_REGISTER(1321, "Flash CRC Stall Avg (us)", Fault_CRC_GetStallAverage,    NULL) \
+  INPUT_REGISTER(1322, "RAM Test Lockout Max (us)", RAMIntegrity_GetLockoutMax,  NULL) \
+  INPUT_REGISTER(1323, "RAM Test Chunk (words)",  RAMIntegrity_GetChunkWords,     NULL) \
+  INPUT_REGISTER(1324, "RAM Test Sweeps",         RAMIntegrity_GetSweepCount,     NULL) \
+  INPUT_REGISTER(1325, "Boot To First Response (ms)", ModbusSlave_GetBootToFirstResponse, NULL) \
+  INPUT_REGISTER(1326, "24V Min (mV)",            ADC_Get_24V_Min,                NULL) \
+  INPUT_REGISTER(1327, "24V Max (mV)",            ADC_Get_24V_Max,                NULL) \
+  INPUT_REGISTER(1328, "24V Avg (mV)",            ADC_Get_24V_Avg,                NULL) \
+  INPUT_REGISTER(1329, "3V3 Min (mV)",            ADC_Get_3V3_Min,                NULL) \
+  INPUT_REGISTER(1330, "3V3 Max (mV)",            ADC_Get_3V3_Max,                NULL) \
+  INPUT_REGISTER(1331, "3V3 Avg (mV)",            ADC_Get_3V3_Avg,                NULL) \
+  INPUT_REGISTER(1332, "Temperature Min (C)",     ADC_Get_Temperature_Min,        NULL) \
+  INPUT_REGISTER(1333, "Temperature Max (C)",     ADC_Get_Temperature_Max,        NULL) \
+  INPUT_REGISTER(1334, "Temperature Avg (C)",     ADC_Get_Temperature_Avg,        NULL) \
+  INPUT_REGISTER(1335, "VrefInt Min (mV)",        ADC_Get_VrefInt_Min,            NULL) \
+  INPUT_REGISTER(1336, "VrefInt Max (mV)",        ADC_Get_VrefInt_Max,            NULL) \
+  INPUT_REGISTER(1337, "VrefInt Avg (mV)",        ADC_Get_VrefInt_Avg,            NULL) \
+  INPUT_REGISTER(1338, "Supply Watchdog Trips",   ADC_GetWatchdogTrips,           NULL) \
+  INPUT_REGISTER(1339, "Transient Capture State", ADCCapture_GetState,            NULL) \
+  INPUT_REGISTER(1340, "Transient Baseline (mV)", ADCCapture_GetBaseline,         NULL) \
+  INPUT_REGISTER(1341, "Transient Minimum (mV)",  ADCCapture_GetMinimum,          NULL) \
+  INPUT_REGISTER(1342, "Transient Minimum Time (us)",  ADCCapture_GetMinimumTime,  NULL) \
+  INPUT_REGISTER(1343, "Transient Recovery Time (us)", ADCCapture_GetRecoveryTime, NULL) \
+  INPUT_REGISTER(1344, "Transient Trigger Sample", ADCCapture_GetTriggerIndex,    NULL) \
+  INPUT_REGISTER(1345, "Transient Sample Period (ns)", ADCCapture_GetSamplePeriod, NULL) \
+  INPUT_REGISTER(1346, "Relay Fault Line Events", Relay_GetFaultLineCount,       NULL) \
+  INPUT_REGISTER(1347, "Relay Fault Line Uptime (min)", Relay_GetFaultLineTimestamp, NULL) \
+  INPUT_REGISTER(1348, "Relay Fault Line Readback (us)", Relay_GetFaultLineReadback, NULL) \
+  INPUT_REGISTER(1349, "CPU Load (0.1%)",         Scheduler_GetLoad,              NULL) \
+  INPUT_REGISTER(1350, "Task Budget Overruns",    Scheduler_GetOverrunCount,      NULL) \
+  INPUT_REGISTER(1351, "Modbus Response Time Max (us)", ModbusSlave_GetResponseTimeMax, NULL) \
+  INPUT_REGISTER(1352, "Core Clock (MHz)",        Clock_GetFrequency,             NULL) \
+  INPUT_REGISTER(1353, "High Clock Residency (0.1%)", Clock_GetHighResidency,     NULL) \
+  INPUT_REGISTER(1354, "Clock Switches",          Clock_GetSwitchCount,           NULL) \
   // To be continued.
 
 #define COIL(addr, str, read, write) \
@@ -64,6 +154,47 @@
   COIL(04102, "Clear Last Faults",  NULL, NULL) \
   // To be continued.
 
+// Blocks of coils served by a single pair of functions,
+// which take the offset of the coil within the block.
+// The offset is worked out unsigned, so a single comparison covers both
+// ends of the block (and a block at address 0 doesn't warn).
+#define COIL_RANGE(base, count, str, read, write) \
+  if ((uint16_t) (nAddress - (base)) < (count)) \
+  { \
+    pRangeReadFunction  = read; \
+    pRangeWriteFunction = write; \
+    nRangeOffset        = nAddress - (base); \
+  }
+#define FOREACH_COIL_RANGE(COIL_RANGE) \
+  COIL_RANGE(RELAY_COIL_BASE, RELAY_COUNT, "Relay States", Relay_GetCoil, Relay_SetCoil) \
+
+// Files readable with FC 0x14, a record (register) at a time.
+#define FILE_RECORD(file, str, read) \
+  case file: \
+    pFileReadFunction = read; \
+    break;
+#define FOREACH_FILE_RECORD(FILE_RECORD) \
+  FILE_RECORD(JOURNAL_FILE_NUMBER, "Event Journal", Journal_ReadFileRecord) \
+  FILE_RECORD(ADCHISTORY_FILE_SECONDS_24V,         "24V History (s)",         ADCHistory_ReadSeconds24V) \
+  FILE_RECORD(ADCHISTORY_FILE_SECONDS_3V3,         "3V3 History (s)",         ADCHistory_ReadSeconds3V3) \
+  FILE_RECORD(ADCHISTORY_FILE_SECONDS_TEMPERATURE, "Temperature History (s)", ADCHistory_ReadSecondsTemperature) \
+  FILE_RECORD(ADCHISTORY_FILE_MINUTES_24V,         "24V History (min)",       ADCHistory_ReadMinutes24V) \
+  FILE_RECORD(ADCHISTORY_FILE_MINUTES_3V3,         "3V3 History (min)",       ADCHistory_ReadMinutes3V3) \
+  FILE_RECORD(ADCHISTORY_FILE_MINUTES_TEMPERATURE, "Temperature History (min)", ADCHistory_ReadMinutesTemperature) \
+  FILE_RECORD(ADC_CAPTURE_FILE_NUMBER,             "24V Transient Capture",   ADCCapture_ReadFileRecord) \
+  FILE_RECORD(SCHEDULER_FILE_NUMBER,               "Task Statistics",         Scheduler_ReadFileRecord) \
+  FILE_RECORD(DIAGNOSTICS_HOTPATH_FILE_NUMBER,     "Hot Path Run Times",      Diagnostics_ReadHotPathRecord) \
+
+// FIFO queues readable with FC 0x18.
+// The FIFO pointer address is also an input register holding the queue count.
+#define EVENTQUEUE_FIFO_ADDRESS    (1318)
+#define FIFO_QUEUE(addr, str, read) \
+  case addr: \
+    pFIFOReadFunction = read; \
+    break;
+#define FOREACH_FIFO_QUEUE(FIFO_QUEUE) \
+  FIFO_QUEUE(EVENTQUEUE_FIFO_ADDRESS, "Event Queue", EventQueue_Read) \
+
 #define OBJECT_ID(id, str, ascii, write) \
   case id: \
     pASCIIStr = (uint8_t*) ascii; \
@@ -77,11 +208,14 @@
 // To be continued.
 
 bool              ModbusDataModel_ReadCoil(uint16_t nAddress, bool* bReturn);
+ModbusException_T ModbusDataModel_WriteCoil(uint16_t nAddress, bool* bValue);
 ModbusException_T ModbusDataModel_ReadHoldingRegister(uint16_t nAddress, uint16_t* nReturn);
 ModbusException_T ModbusDataModel_ReadInputRegister(uint16_t nAddress, uint16_t* nReturn);
 ModbusException_T ModbusDataModel_ReadObjectID( uint16_t nObjectID, uint8_t* pBuffer,
                                                 int nBufferLen,
                                                 uint8_t* nBufferUsed);
 ModbusException_T ModbusDataModel_WriteHoldingRegister(uint16_t nAddress, uint16_t* nValue);
+ModbusException_T ModbusDataModel_ReadFileRecord(uint16_t nFile, uint16_t nRecord, uint16_t* nReturn);
+ModbusException_T ModbusDataModel_ReadFIFOQueue(uint16_t nAddress, uint16_t* pValues, uint16_t nMax, uint16_t* pCount);
 
 #endif/* MODBUSINTERFACE_H_ */
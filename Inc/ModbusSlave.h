@@ -12,8 +12,16 @@
 #include "stm32l4xx_hal.h"
 
 #define MODBUS_SLAVE_TIMER htim2
+#define MODBUS_SLAVE_TIMER_IRQn TIM2_IRQn
 #define MODBUS_SLAVE_COMMUNICATION_TIMEOUT_FAULT_MS (300 * 1000)
 
+//	Requests are decoded and answered from a software-triggered interrupt,
+//	so that the response never waits on whatever the main loop is doing.
+//	COMP is not used on this board, so its vector is borrowed for this.
+//	It sits below the UARTs and the relay fault reaction.
+#define MODBUS_SLAVE_IRQn COMP_IRQn
+#define MODBUS_SLAVE_IRQ_PRIORITY (2)
+
 typedef enum
 {
 	MODBUS_EXCEPTION_OK 						= 0x00,
@@ -29,17 +37,24 @@ typedef enum
 	MODBUS_EXCEPTION_UNKNOWN					= 0xFF,
 }	ModbusException_T;
 
+//	Packed to two bytes, since the FIFO holds a good number of these.
 typedef struct
 {
 	uint8_t nByte;
-	bool bContiguousDataTimeout;
-	bool bIncomingMsgTimeout;
+	bool bContiguousDataTimeout : 1;
+	bool bIncomingMsgTimeout : 1;
 } ModbusByte_T;
 
 void ModbusSlave_Init(void);
+void ModbusSlave_UpdateClock(uint32_t nOldClock);
+void ModbusSlave_TimerIRQHandler(void);
+void ModbusSlave_IRQHandler(void);
 const FIFOControl_T * ModbusSlave_GetFIFO(void);
 void ModbusSlave_Debug_StartTimer(void);
 void ModbusSlave_Process(void);
+void ModbusSlave_SetWritesBusy(bool bBusy);
+uint16_t ModbusSlave_GetBootToFirstResponse(void);
+uint16_t ModbusSlave_GetResponseTimeMax(void);
 void ModbusSlave_SetupTimerValues(TIM_HandleTypeDef * htim);
 bool ModbusSlave_CheckCRC(const uint8_t * pBuffer, uint32_t nBufferLen);
 
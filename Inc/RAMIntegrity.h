@@ -8,9 +8,26 @@
 #ifndef RAMINTEGRITY_H_
 #define RAMINTEGRITY_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #define VOLATILE_DEREF(type, variable) (*((volatile type *) variable))
 
+//	Limits of the chunk tested with interrupts disabled, in words.
+#define RAMINTEGRITY_CHUNK_MIN_WORDS (4)
+#define RAMINTEGRITY_CHUNK_MAX_WORDS (64)
+
+//	Longest time interrupts may be disabled for a single chunk.
+//	At low baud rates, half a character time is used if that is shorter.
+#define RAMINTEGRITY_LOCKOUT_MAX_US (100)
+
+//	Time spent testing on each call to RAMIntegrity_Process().
+#define RAMINTEGRITY_PASS_BUDGET_US (200)
+
 void RAMIntegrity_Process(void);
 bool RAMIntegrity_StartupTasksComplete(void);
+uint16_t RAMIntegrity_GetLockoutMax(void);
+uint16_t RAMIntegrity_GetChunkWords(void);
+uint16_t RAMIntegrity_GetSweepCount(void);
 
 #endif /* RAMINTEGRITY_H_ */
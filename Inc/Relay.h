@@ -19,15 +19,97 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "ModbusSlave.h"
+#include "DRV8860.h"
 
+// Number of DRV8860s daisy-chained on the relay bus.
+// Fixed per hardware variant; override at build time with -DDRV8860_CNT=n.
+#ifndef DRV8860_CNT
 #define DRV8860_CNT (2)
+#endif
 
+#if (DRV8860_CNT < 1) || (DRV8860_CNT > 8)
+#error "DRV8860_CNT must be between 1 and 8"
+#endif
+
+// Each DRV8860 drives 8 relays.
+// Relay maps are carried in a single 64-bit word regardless of the
+// chain length, and exposed over Modbus as RELAY_MAP_WORDS registers
+// of 16 relays each (relays 1-16 in the first word, and so on).
+#define RELAY_COUNT        (DRV8860_CNT * 8)
+#define RELAY_MAP_WORDS    ((RELAY_COUNT + 15) / 16)
+#define RELAY_MAP_ALL      ((RELAY_COUNT >= 64) ? UINT64_MAX : ((1ULL << RELAY_COUNT) - 1))
+
+typedef uint64_t RelayMap_T;
+
+// The relays are also exposed as coils, one per relay,
+// starting at this coil address (relay 1).
+#define RELAY_COIL_BASE    (0)
+
+// Period at which the CR and DR are read back and verified
+// while the relay pattern is not changing.
+#define RELAY_VERIFY_PERIOD_MS_DEFAULT (1000)
+#define RELAY_VERIFY_PERIOD_MS_MIN     (100)
+#define RELAY_VERIFY_PERIOD_MS_MAX     (60000)
+
+// Number of command-to-actuation latency samples kept for the percentiles.
+#define RELAY_LATENCY_SAMPLES          (32)
+
+// The fault reaction runs from a software-triggered interrupt.
+// SWPMI1 is not used on this board, so its vector is borrowed for this.
+#define RELAY_FAULT_REACTION_IRQn          SWPMI1_IRQn
+#define RELAY_FAULT_REACTION_IRQ_PRIORITY  (1)
+
+void Relay_Init(void);
 ModbusException_T Relay_Request(uint16_t nPattern);
+ModbusException_T Relay_RequestMap(RelayMap_T nMap);
+RelayMap_T Relay_GetRequestMap(void);
+RelayMap_T Relay_GetMap(void);
+RelayMap_T Relay_GetFaultedMap(void);
 void Relay_Process(void);
 uint16_t Relay_Get(void);
 void Relay_Run_Demo();
 void Relay_Set_CommRelay(_Bool state);
 uint16_t Relay_GetFaulted(void);
+ModbusException_T Relay_Request_17_32(uint16_t nPattern);
+ModbusException_T Relay_Request_33_48(uint16_t nPattern);
+ModbusException_T Relay_Request_49_64(uint16_t nPattern);
+uint16_t Relay_Get_17_32(void);
+uint16_t Relay_Get_33_48(void);
+uint16_t Relay_Get_49_64(void);
+uint16_t Relay_GetFaulted_17_32(void);
+uint16_t Relay_GetFaulted_33_48(void);
+uint16_t Relay_GetFaulted_49_64(void);
+#ifdef DRV8860_READ_FAULT_REGISTERS
+RelayMap_T Relay_GetOpenLoadMap(void);
+RelayMap_T Relay_GetOverCurrentMap(void);
+uint16_t Relay_GetOpenLoad(void);
+uint16_t Relay_GetOpenLoad_17_32(void);
+uint16_t Relay_GetOpenLoad_33_48(void);
+uint16_t Relay_GetOpenLoad_49_64(void);
+uint16_t Relay_GetOverCurrent(void);
+uint16_t Relay_GetOverCurrent_17_32(void);
+uint16_t Relay_GetOverCurrent_33_48(void);
+uint16_t Relay_GetOverCurrent_49_64(void);
+#endif
+bool Relay_GetCoil(uint16_t nRelay);
+ModbusException_T Relay_SetCoil(uint16_t nRelay, bool bState);
+ModbusException_T Relay_SetVerifyPeriod(uint16_t nPeriod);
+uint16_t Relay_GetVerifyPeriod(void);
+uint16_t Relay_GetWriteCount(void);
+uint16_t Relay_GetVerifyFailureCount(void);
+void Relay_FastPath(void);
+uint16_t Relay_GetLatencyP50(void);
+uint16_t Relay_GetLatencyP90(void);
+uint16_t Relay_GetLatencyP99(void);
+uint16_t Relay_GetLatencyMax(void);
+uint16_t Relay_GetLatencyCount(void);
+void Relay_FaultEvent(void);
+void Relay_FaultReactionProcess(void);
+uint16_t Relay_GetFaultReactionLast(void);
+uint16_t Relay_GetFaultReactionMax(void);
+uint16_t Relay_GetFaultLineCount(void);
+uint16_t Relay_GetFaultLineTimestamp(void);
+uint16_t Relay_GetFaultLineReadback(void);
 
 
 #endif /* _RELAY_H_ */
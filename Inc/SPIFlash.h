@@ -1,5 +1,5 @@
 /*
- * ModbusSlave.h
+ * SPIFlash.h
  *
  *  Created on: Aug 18, 2020
  *      Author: BFS
@@ -24,6 +24,10 @@
 #define SPIFLASH_PAGE_COUNT				(SPIFLASH_CHIP_SIZE / SPIFLASH_PAGE_SIZE)	//	Page count
 #define SPIFLASH_MAX_STEPS				(8)
 
+//	Maximum SCK frequency of the CAT25320 at 2.5V-5.5V.
+//	The SPI1 prescaler is chosen to be as fast as possible without exceeding this.
+#define SPIFLASH_MAX_CLOCK_HZ			(10000000)
+
 //	Macro to construct address within the three address bytes specified.
 #define SPIFLASH_CONSTRUCT_ADDRESS(pDest, nPage, nPageOffset)		*((pDest)) = (((nPage) >> 3) & 0x0F); 	\
 																	*((pDest)+1) = (((nPage) << 5) & 0xE0) | (nPageOffset & 0x1F)
@@ -53,24 +57,67 @@ typedef enum
 {
 	SPIFLASH_STATE_IDLE,
 	SPIFLASH_STATE_PROCESS,
+	SPIFLASH_STATE_POLL,
 	SPIFLASH_STATE_COUNT,
 }	SPIFlash_State_T;
 
 /*
-	Structure:	SPIWriteStatus_T
+	Typedef:	SPIFlash_Operation_T
+				SPIFlash_RequestState_T
 	Description:
-		Keeps track of the write in progress, if there is one.
+		What a request asks for, and where it is in the queue.
 */
-typedef struct
+typedef enum
+{
+	SPIFLASH_OPERATION_READ,
+	SPIFLASH_OPERATION_WRITE,
+}	SPIFlash_Operation_T;
+
+typedef enum
+{
+	SPIFLASH_REQUEST_IDLE,
+	SPIFLASH_REQUEST_QUEUED,
+	SPIFLASH_REQUEST_ACTIVE,
+}	SPIFlash_RequestState_T;
+
+/*
+	Structure:	SPIFlash_Request_T
+	Description:
+		A single read or write of the serial flash.
+		Each client owns its requests (typically statically), and may have
+		as many queued at once as it likes. A request, and the buffer it
+		points to, must be left alone until it has completed.
+
+		On completion, bSuccess is set, the request goes back to
+		SPIFLASH_REQUEST_IDLE, and pCallback (if any) is called from
+		SPIFlash_Process(), in the main loop.
+*/
+typedef struct SPIFlash_Request
 {
+	//	Filled in by the client.
+	SPIFlash_Operation_T eOperation;
 	uint8_t * pBuffer;
-	uint32_t nPage;
-	uint32_t nPageOffset;
-	uint32_t nBytesLeft;
-} SPIWriteStatus_T;
+	uint16_t nAddress;
+	uint16_t nSize;
+	void (*pCallback)(struct SPIFlash_Request * pRequest);
+	void * pContext;
+
+	//	Filled in by the SPIFlash driver.
+	volatile SPIFlash_RequestState_T eState;
+	bool bSuccess;
+
+	//	Internal; the progress of the request, and the queue.
+	uint16_t nBytesDone;
+	struct SPIFlash_Request * pNext;
+} SPIFlash_Request_T;
 
+void SPIFlash_Init(void);
+void SPIFlash_UpdateClock(void);
+bool SPIFlash_Submit(SPIFlash_Request_T * pRequest);
+bool SPIFlash_Read(SPIFlash_Request_T * pRequest, uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize);
+bool SPIFlash_Write(SPIFlash_Request_T * pRequest, uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize);
+bool SPIFlash_RequestBusy(const SPIFlash_Request_T * pRequest);
 bool SPIFlash_IsFree(void);
-bool SPIFlash_Write(uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize);
-bool SPIFlash_Read(uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize);
+bool SPIFlash_InTransfer(void);
 void SPIFlash_Process(void);
 #endif /* SPIFLASH_H_ */
@@ -0,0 +1,50 @@
+/*
+ * Scheduler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ModbusSlave.h"
+
+/*
+	Enum:	Scheduler_Event_T
+	Description:
+		Events that make a task ready straight away, rather than at its
+		next period. Posted from the interrupts that have work for the
+		main loop, and by tasks that want to be run again right away.
+*/
+typedef enum
+{
+	SCHEDULER_EVENT_MODBUS		= (1 << 0),		//	Request answered by the Modbus interrupt
+	SCHEDULER_EVENT_COMMAND		= (1 << 1),		//	USART3 byte in
+	SCHEDULER_EVENT_SPIFLASH	= (1 << 2),		//	SPI1 transfer finished
+	SCHEDULER_EVENT_ADC			= (1 << 3),		//	ADC sequence or capture finished
+	SCHEDULER_EVENT_RELAY		= (1 << 4),		//	Relay request, fault line, or state machine busy
+}	Scheduler_Event_T;
+
+//	Modbus file number (FC 0x14) of the task statistics.
+//	Each task takes SCHEDULER_TASK_REGISTERS records (registers), in table order:
+//		0	Period (ms), 0 if it only runs on events
+//		1	Priority (0 runs first)
+//		2	Budget for a single run (us)
+//		3	Longest run (us)
+//		4	Average run (us)
+//		5	Runs that went over budget
+//		6	Share of the CPU over the last load window (0.1%)
+#define SCHEDULER_FILE_NUMBER		(9)
+#define SCHEDULER_TASK_REGISTERS	(7)
+
+void Scheduler_Init(void);
+void Scheduler_Post(uint32_t nEvents);
+void Scheduler_Run(void);
+uint16_t Scheduler_GetLoad(void);
+uint16_t Scheduler_GetOverrunCount(void);
+ModbusException_T Scheduler_ReadFileRecord(uint16_t nRecord, uint16_t * pValue);
+
+#endif /* SCHEDULER_H_ */
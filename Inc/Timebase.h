@@ -0,0 +1,22 @@
+/*
+ * Timebase.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ */
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+
+void Timebase_Init(void);
+void Timebase_Update(void);
+void Timebase_ClockChange(void);
+uint64_t Timebase_GetMicroseconds(void);
+bool Timebase_ElapsedMicroseconds(uint64_t nSince, uint64_t nInterval);
+bool Timebase_ElapsedMilliseconds(uint32_t nSince, uint32_t nInterval);
+
+#endif /* TIMEBASE_H_ */
@@ -52,6 +52,20 @@ extern "C" {
 
 /* Exported macro ------------------------------------------------------------*/
 /* USER CODE BEGIN EM */
+//	Places a hot path in the .ramfunc section, which the startup code copies
+//	into SRAM. It then runs at the same speed whatever the flash wait states,
+//	and its fetches don't contend with the background flash CRC.
+//	Defining DEBUG_HOT_PATHS_IN_FLASH leaves them in flash, for comparison.
+#ifndef DEBUG_HOT_PATHS_IN_FLASH
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+//	Buffers that DMA reads or writes. Disabling interrupts doesn't hold DMA
+//	off, so these are gathered into one place (zeroed with the rest of .bss)
+//	that the RAM test steps over.
+#define DMA_BUFFER __attribute__((section(".bss.dma")))
 
 /* USER CODE END EM */
 
@@ -63,18 +77,22 @@ void Error_Handler(void);
 //	Define external variables so that we can see things from outside
 //	the scope of the main.h file.
 extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
 extern CRC_HandleTypeDef hcrc;
 extern SPI_HandleTypeDef hspi1;
 extern UART_HandleTypeDef huart1;
 extern UART_HandleTypeDef huart3;
 extern ADC_HandleTypeDef hadc1;
+extern DMA_HandleTypeDef hdma_memtomem_dma1_channel4;
 
 #define Main_Get_Modbus_Slave_Timer_Handle() 	(&htim2)
 #define Main_Get_CRC_Handle() 					(&hcrc)
+#define Main_Get_CRC_DMA_Handle() 				(&hdma_memtomem_dma1_channel4)
 #define Main_Get_SPI_Handle() 					(&hspi1)
 #define Main_Get_Modbus_UART_Handle() 			(&huart1)
 #define Main_Get_Command_UART_Handle() 			(&huart3)
 #define Main_Get_ADC_Handle() 					(&hadc1)
+#define Main_Get_ADC_Timer_Handle() 			(&htim6)
 
 /* USER CODE END EFP */
 
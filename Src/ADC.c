@@ -7,13 +7,13 @@
 
 #include <stdbool.h>
 #include "ADC.h"
+#include "ADCConvert.h"
 #include "main.h"
 #include "Fault.h"
-
-#define ADC_TICK_INCREMENT    250
-
-/* Variable to report ADC sequencer status */
-uint8_t    ubSequenceCompleted = RESET; /* Set when all ranks of the sequence have been converted */
+#include "EventQueue.h"
+#include "ADCCapture.h"
+#include "Scheduler.h"
+#include "Timebase.h"
 
 // Boolean value, representing whether or not at least one value was calculated.
 // This is used for the startup test.
@@ -28,75 +28,297 @@ uint16_t    ADC_Vref        = 0;
 
 uint16_t    ADC_VrefInt_Counts = 0;
 
-double    temporary;
+// Conversion scale factors, from the factory calibration (see ADCConvert.h).
+static ADCConvert_T    m_sADCConvert;
+
+// Vref the analog watchdog thresholds were last worked out for,
+// and the number of times they have tripped.
+static uint16_t    m_nADCWatchdogVref  = 0;
+static uint16_t    m_nADCWatchdogTrips = 0;
+
+// Filtered temperature, in Q8 degrees C.
+static int32_t     m_nADCTemperatureQ8     = 0;
+static bool        m_bADCTemperatureFilled = false;
 
 extern __IO uint16_t    aADCxConvertedValues[ADC_NUM_CHANNELS];
 
-void ADC_Process(void)
+// Running min/max/sum of the converted readings, fed from the DMA interrupt.
+// Readings are in mV, except the temperature which is in Q8 degrees C.
+typedef struct
 {
-  ADC_HandleTypeDef*   adc     = Main_Get_ADC_Handle();
-  static uint32_t      adcTick = 0;
+  int32_t     nMin;
+  int32_t     nMax;
+  int64_t     nSum;
+  uint32_t    nCount;
+} ADC_Accumulator_T;
+
+// m_aADCWindow collects the readings between passes of ADC_Process(),
+// which works from their average. m_aADCStatistics collects them until
+// the master reads them out; m_aADCLatched holds what it read.
+static ADC_Accumulator_T    m_aADCWindow[ADC_NUM_CHANNELS];
+static ADC_Accumulator_T    m_aADCStatistics[ADC_NUM_CHANNELS];
+static int16_t              m_aADCLatched[ADC_NUM_CHANNELS][ADC_STATISTIC_COUNT];
+
+// Where each monitored reading was last reported to be, relative to its limits.
+static EventQueue_Threshold_T    m_aADCThreshold[3] = {EVENTQUEUE_THRESHOLD_IN_BAND};
+
+/*
+   Function:  ADC_ReportThreshold()
+   Description:
+    Posts an event when a monitored reading moves out of its limits
+    (as decided by the fault handling) or back into them.
+ */
+static void ADC_ReportThreshold(EventQueue_Channel_T eChannel, Fault_T eFault, int32_t nValue, int32_t nNominal)
+{
+  EventQueue_Threshold_T    eThreshold = EVENTQUEUE_THRESHOLD_IN_BAND;
+
+  if (Fault_Get(eFault))
+  {
+    eThreshold = (nValue < nNominal) ? EVENTQUEUE_THRESHOLD_LOW : EVENTQUEUE_THRESHOLD_HIGH;
+  }
+
+  if (eThreshold != m_aADCThreshold[eChannel])
+  {
+    m_aADCThreshold[eChannel] = eThreshold;
+    EventQueue_Post(EVENTQUEUE_TYPE_THRESHOLD, eThreshold, eChannel);
+  }
+}
+
+/*
+   Function:  ADC_Init()
+   Description:
+    Precomputes the conversion scale factors from the factory calibration
+    values. Must be called once at startup, before ADC_Process().
+ */
+void ADC_Init(void)
+{
+  ADCConvert_Init(&m_sADCConvert, *VREFINT_CALDATA, *ADC_TEMP1_COUNTS, *ADC_TEMP2_COUNTS);
+}
 
-  if (uwTick > adcTick)
+/*
+   Function:  ADC_UpdateClock()
+   Description:
+    Called, with interrupts masked, after the core clock changes. TIM6 runs
+    from PCLK1, so its prescaler is set to keep it ticking at
+    ADC_TIMER_TICK_HZ and the sequence triggered every 10 ms, whatever the
+    clock.
+    The prescaler is preloaded, and would otherwise only take effect at
+    the next update, leaving the period under way 5x too short or too long
+    and skewing the averages. An update event is forced to load it now;
+    that clears the count, so it's put back (it's in ticks, which are the
+    same at either clock).
+    The forced update is also a TRGO edge, so the regular scan is stopped
+    around it, and the ADC doesn't take it for a trigger. A sequence cut
+    short by the stop is dropped, and the DMA started again from the top
+    of the buffer. A transient capture is left alone; it isn't triggered
+    from TIM6, and puts the scan back itself.
+ */
+void ADC_UpdateClock(void)
+{
+  TIM_HandleTypeDef*  htim  = Main_Get_ADC_Timer_Handle();
+  ADC_HandleTypeDef*  hadc  = Main_Get_ADC_Handle();
+  DMA_HandleTypeDef*  hdma  = hadc->DMA_Handle;
+  bool                bScan = !ADCCapture_Running() && LL_ADC_REG_IsConversionOngoing(hadc->Instance);
+  uint32_t            nCount;
+
+  if (bScan)
   {
-    adcTick = uwTick + ADC_TICK_INCREMENT;
-
-    /* Start ADC conversion */
-    /* Since sequencer is enabled in discontinuous mode, this will perform    */
-    /* the conversion of the next rank in sequencer.                          */
-    /* Note: For this example, conversion is triggered by software start,     */
-    /*       therefore "HAL_ADC_Start()" must be called for each conversion.  */
-    /*       Since DMA transfer has been initiated previously by function     */
-    /*       "HAL_ADC_Start_DMA()", this function will keep DMA transfer      */
-    /*       active.                                                          */
-    if (HAL_ADC_Start(adc) != HAL_OK)
+    LL_ADC_REG_StopConversion(hadc->Instance);
+
+    while (LL_ADC_REG_IsStopConversionOngoing(hadc->Instance))
     {
-      Error_Handler();
     }
+  }
+
+  nCount = htim->Instance->CNT;
+  __HAL_TIM_SET_PRESCALER(htim, (HAL_RCC_GetPCLK1Freq() / ADC_TIMER_TICK_HZ) - 1);
+  htim->Instance->EGR = TIM_EGR_UG;
+  htim->Instance->CNT = nCount;
 
-    /* After each intermediate conversion,
-       - EOS remains reset (EOS is set only every third conversion)
-       - EOC is set then immediately reset by DMA reading of DR register.
-       Therefore, the only reliable flag to check the conversion end is EOSMP
-       (end of sampling flag).
-       Once EOSMP is set, the end of conversion will be reached when the successive
-       approximations are over.
-       RM indicates 12.5 ADC clock cycles for the successive approximations
-       duration with a 12-bit resolution, or 185.ns at 80 MHz.
-       Therefore, it is known that the conversion is over at
-       HAL_ADC_PollForConversion() API return */
-    if (HAL_ADC_PollForEvent(adc, ADC_EOSMP_EVENT, 10) != HAL_OK)
+  if (bScan)
+  {
+    if (__HAL_DMA_GET_COUNTER(hdma) != ADC_NUM_CHANNELS)
     {
-      Error_Handler();
+      HAL_DMA_Abort(hdma);
+      HAL_DMA_Start_IT(hdma, (uint32_t) &hadc->Instance->DR, (uint32_t) aADCxConvertedValues, ADC_NUM_CHANNELS);
     }
 
-    if (ubSequenceCompleted == SET)
+    LL_ADC_REG_StartConversion(hadc->Instance);
+  }
+}
+
+/*
+   Function:  ADC_Convert()
+   Description:
+    Converts one sequence of conversions into readings: mV for the
+    supplies and VREFINT, Q8 degrees C for the temperature.
+ */
+static void ADC_Convert(const uint16_t * aCounts, int32_t * aValues)
+{
+  ADC_Vref = ADCConvert_Sequence(&m_sADCConvert, aCounts, aValues);
+}
+
+/*
+   Function:  ADC_CountsTo24V()
+   Description:
+    Converts a single raw reading of the 24V channel into mV,
+    at the present Vref.
+ */
+uint16_t ADC_CountsTo24V(uint16_t nCounts)
+{
+  return ADCConvert_24V(&m_sADCConvert, nCounts, ADC_Vref);
+}
+
+/*
+   Function:  ADC_Accumulate()
+              ADC_AccumulatorReset()
+   Description:
+    Folds a reading into an accumulator, and empties one.
+ */
+static void ADC_Accumulate(ADC_Accumulator_T * pAccumulator, int32_t nValue)
+{
+  if (pAccumulator->nCount == 0 || nValue < pAccumulator->nMin)
+  {
+    pAccumulator->nMin = nValue;
+  }
+  if (pAccumulator->nCount == 0 || nValue > pAccumulator->nMax)
+  {
+    pAccumulator->nMax = nValue;
+  }
+  pAccumulator->nSum += nValue;
+  pAccumulator->nCount++;
+}
+static void ADC_AccumulatorReset(ADC_Accumulator_T * pAccumulator)
+{
+  pAccumulator->nSum   = 0;
+  pAccumulator->nCount = 0;
+}
+
+/*
+   Function:  ADC_WatchdogCounts()
+   Description:
+    Converts a supply voltage (mV) into the raw counts it would read as,
+    through the given divider, at the present Vref.
+ */
+static uint32_t ADC_WatchdogCounts(uint32_t nMillivolts, uint32_t nTotal, uint32_t nLow)
+{
+  uint64_t    nCounts = ((uint64_t) nMillivolts * nLow * ADC_MAX_COUNTS) / ((uint32_t) nTotal * ADC_Vref);
+
+  return (nCounts > ADC_MAX_COUNTS) ? ADC_MAX_COUNTS : (uint32_t) nCounts;
+}
+
+/*
+   Function:  ADC_WatchdogUpdate()
+   Description:
+    Programs the analog watchdogs with the tolerance windows of the supplies,
+    converted to raw counts at the present Vref:
+      AWD1  24V (channel 1), 12 bit thresholds
+      AWD2  3V3 (channel 2), 8 bit thresholds (the top 8 bits of the reading)
+    The thresholds can only be written with the ADC stopped, so this is
+    called from the end of sequence, while it waits for the next trigger,
+    and only when Vref has moved.
+ */
+static void ADC_WatchdogUpdate(ADC_HandleTypeDef * hadc)
+{
+  if (ADC_Vref == m_nADCWatchdogVref || ADC_Vref == 0)
+  {
+    return;
+  }
+  m_nADCWatchdogVref = ADC_Vref;
+
+  uint32_t    n24VLow  = ADC_WatchdogCounts(ADC_24V_TOLERANCE_LOW,  ADC_24V_DIVIDER_TOTAL, ADC_24V_DIVIDER_LOW);
+  uint32_t    n24VHigh = ADC_WatchdogCounts(ADC_24V_TOLERANCE_HIGH, ADC_24V_DIVIDER_TOTAL, ADC_24V_DIVIDER_LOW);
+  uint32_t    n3V3Low  = ADC_WatchdogCounts(ADC_3V3_TOLERANCE_LOW,  ADC_3V3_DIVIDER_TOTAL, ADC_3V3_DIVIDER_LOW);
+  uint32_t    n3V3High = ADC_WatchdogCounts(ADC_3V3_TOLERANCE_HIGH, ADC_3V3_DIVIDER_TOTAL, ADC_3V3_DIVIDER_LOW);
+
+  LL_ADC_REG_StopConversion(hadc->Instance);
+
+  while (LL_ADC_REG_IsStopConversionOngoing(hadc->Instance))
+  {
+  }
+
+  LL_ADC_ConfigAnalogWDThresholds(hadc->Instance, LL_ADC_AWD1, n24VHigh, n24VLow);
+  LL_ADC_ConfigAnalogWDThresholds(hadc->Instance, LL_ADC_AWD2, (n3V3High + 8) >> 4, (n3V3Low + 8) >> 4);
+
+  LL_ADC_REG_StartConversion(hadc->Instance);
+}
+
+/*
+   Function:  ADC_WatchdogRearm()
+   Description:
+    Re-enables a watchdog interrupt, after its fault has been cleared.
+ */
+static void ADC_WatchdogRearm(uint32_t nFlag, uint32_t nInterrupt)
+{
+  ADC_HandleTypeDef*   adc = Main_Get_ADC_Handle();
+
+  __HAL_ADC_CLEAR_FLAG(adc, nFlag);
+  __HAL_ADC_ENABLE_IT(adc, nInterrupt);
+}
+
+/*
+   Function:  ADC_GetWatchdogTrips()
+   Description:
+    Returns the number of times the supply watchdogs have raised a fault.
+ */
+uint16_t ADC_GetWatchdogTrips(void)
+{
+  return m_nADCWatchdogTrips;
+}
+
+/*
+   Function:  ADC_Process()
+   Description:
+    The ADC runs on its own: TIM6 triggers a sequence of all four
+    channels every 10 ms, each 16x oversampled by the hardware, and the
+    DMA interrupt folds the results into the accumulators. Every
+    ADC_TICK_INCREMENT, this takes the average of the readings since
+    the last pass and runs the fault handling on it.
+ */
+void ADC_Process(void)
+{
+  static uint32_t      adcTick = 0;
+
+  if (Timebase_ElapsedMilliseconds(adcTick, ADC_TICK_INCREMENT))
+  {
+    ADC_Accumulator_T    aWindow[ADC_NUM_CHANNELS];
+
+    adcTick = uwTick;
+
+    uint32_t    nPRIMASK = __get_PRIMASK();
+    __set_PRIMASK(1);
+
+    for (int i = 0; i < ADC_NUM_CHANNELS; i++)
+    {
+      aWindow[i] = m_aADCWindow[i];
+      ADC_AccumulatorReset(&m_aADCWindow[i]);
+    }
+
+    __set_PRIMASK(nPRIMASK);
+
+    // A window only holds a few dozen readings, so its sums fit in 32 bits.
+    if (aWindow[ADC_INPUT_24V].nCount > 0)
     {
-      /* Computation of ADC conversions raw data to physical values */
-      /* Note: ADC results are transferred into array "aADCxConvertedValues"  */
-      /*       in the order of their rank in ADC sequencer.                   */
-      ADC_Vref = (double)((uint32_t)*VREFINT_CALDATA * ADC_VREF_CAL_VOLT) /  aADCxConvertedValues[3];
+      int32_t    nCount = (int32_t) aWindow[ADC_INPUT_24V].nCount;
 
-      ADC_24V_Mon = (double)aADCxConvertedValues[0] * ADC_Vref / ADC_MAX_COUNTS * 10590 / 590;
-      ADC_3V3_Mon = (double)aADCxConvertedValues[1] * ADC_Vref / ADC_MAX_COUNTS * 25000 / 15000;
+      ADC_24V_Mon = (int32_t) aWindow[ADC_INPUT_24V].nSum / nCount;
+      ADC_3V3_Mon = (int32_t) aWindow[ADC_INPUT_3V3].nSum / nCount;
+      ADC_VrefInt = (int32_t) aWindow[ADC_INPUT_VREFINT].nSum / nCount;
 
-      temporary  = ((double)aADCxConvertedValues[2] * (uint32_t)*VREFINT_CALDATA / aADCxConvertedValues[3]) - (uint32_t)*ADC_TEMP1_COUNTS;
-      temporary *= (double)(ADC_TEMP2 - ADC_TEMP1);
-      temporary /= (double)(int32_t)((uint32_t)*ADC_TEMP2_COUNTS - (uint32_t)*ADC_TEMP1_COUNTS);
+      int32_t    nTemperatureQ8 = (int32_t) aWindow[ADC_INPUT_TEMPERATURE].nSum / nCount;
 
       // apply some averaging to the temperature
-      if (ADC_Temperature != 0)
+      if (m_bADCTemperatureFilled)
       {
-        ADC_Temperature = (int16_t) ((ADC_Temperature * 0.75) + (temporary + ADC_TEMP1) * 0.25);
+        m_nADCTemperatureQ8 += (nTemperatureQ8 - m_nADCTemperatureQ8) / 4;
       }
       else
       {
-        ADC_Temperature = (temporary + ADC_TEMP1);
+        m_nADCTemperatureQ8     = nTemperatureQ8;
+        m_bADCTemperatureFilled = true;
       }
 
-      ADC_VrefInt = (double)aADCxConvertedValues[3] * ADC_Vref / ADC_MAX_COUNTS;
-
-      ubSequenceCompleted = RESET;
+      ADC_Temperature = (int16_t) (m_nADCTemperatureQ8 / 256);
 
       // Reflect our internal counter for when these values are ready.
       m_nADCValuesOK = (m_nADCValuesOK > 0) ? m_nADCValuesOK - 1 : 0;
@@ -106,33 +328,24 @@ void ADC_Process(void)
   // Fault handling
   if (!m_nADCValuesOK)
   {
-    if (FALSE == Fault_Get(FAULT_VOLTAGE_24V_OUT_OF_SPEC))
-    {
-      if ((ADC_24V_Mon < ADC_24V_TOLERANCE_LOW) || (ADC_24V_Mon > ADC_24V_TOLERANCE_HIGH))
-      {
-        Fault_Set(FAULT_VOLTAGE_24V_OUT_OF_SPEC, TRUE);
-      }
-    }
-    else
+    // The supply faults are raised by the analog watchdogs; here they
+    // are only cleared, once the supply is back inside the hysteresis
+    // band, and the watchdog re-armed.
+    if (Fault_Get(FAULT_VOLTAGE_24V_OUT_OF_SPEC))
     {
       if ((ADC_24V_Mon < ADC_24V_HYSTERISIS_HIGH) && (ADC_24V_Mon > ADC_24V_HYSTERISIS_LOW))
       {
         Fault_Set(FAULT_VOLTAGE_24V_OUT_OF_SPEC, FALSE);
+        ADC_WatchdogRearm(ADC_FLAG_AWD1, ADC_IT_AWD1);
       }
     }
 
-    if (FALSE == Fault_Get(FAULT_VOLTAGE_3V3_OUT_OF_SPEC))
-    {
-      if ((ADC_3V3_Mon < ADC_3V3_TOLERANCE_LOW) || (ADC_3V3_Mon > ADC_3V3_TOLERANCE_HIGH))
-      {
-        Fault_Set(FAULT_VOLTAGE_3V3_OUT_OF_SPEC, TRUE);
-      }
-    }
-    else
+    if (Fault_Get(FAULT_VOLTAGE_3V3_OUT_OF_SPEC))
     {
       if ((ADC_3V3_Mon < ADC_3V3_HYSTERISIS_HIGH) && (ADC_3V3_Mon > ADC_3V3_HYSTERISIS_LOW))
       {
         Fault_Set(FAULT_VOLTAGE_3V3_OUT_OF_SPEC, FALSE);
+        ADC_WatchdogRearm(ADC_FLAG_AWD2, ADC_IT_AWD2);
       }
     }
 
@@ -154,6 +367,11 @@ void ADC_Process(void)
                            ((int16_t) ADC_Temperature) > ADC_TEMPERATURE_TOLERANCE_HIGH;
 
     Fault_Set(FAULT_TEMPERATURE, bTemperature);
+
+    ADC_ReportThreshold(EVENTQUEUE_CHANNEL_24V, FAULT_VOLTAGE_24V_OUT_OF_SPEC, ADC_24V_Mon, ADC_24V_NOMINAL);
+    ADC_ReportThreshold(EVENTQUEUE_CHANNEL_3V3, FAULT_VOLTAGE_3V3_OUT_OF_SPEC, ADC_3V3_Mon, ADC_3V3_NOMINAL);
+    ADC_ReportThreshold(EVENTQUEUE_CHANNEL_TEMPERATURE, FAULT_TEMPERATURE, (int16_t) ADC_Temperature,
+                        (ADC_TEMPERATURE_TOLERANCE_LOW + ADC_TEMPERATURE_TOLERANCE_HIGH) / 2);
   }
 }
 
@@ -177,6 +395,52 @@ uint16_t ADC_Get_Temperature(void)
   return (!m_nADCValuesOK) ? ADC_Temperature : 0;
 }
 
+/*
+   Function:  ADC_GetStatistic()
+   Description:
+    Returns the minimum, maximum or average of a reading since the
+    master last read it out, in mV (or degrees C for the temperature).
+    Reading the minimum latches all three for that reading and starts
+    collecting afresh, so they should be read together, minimum first.
+ */
+uint16_t ADC_GetStatistic(ADC_Input_T eInput, ADC_Statistic_T eStatistic)
+{
+  if (eStatistic == ADC_STATISTIC_MIN)
+  {
+    ADC_Accumulator_T    sStatistics;
+
+    uint32_t    nPRIMASK = __get_PRIMASK();
+    __set_PRIMASK(1);
+    sStatistics = m_aADCStatistics[eInput];
+    ADC_AccumulatorReset(&m_aADCStatistics[eInput]);
+    __set_PRIMASK(nPRIMASK);
+
+    if (sStatistics.nCount > 0)
+    {
+      int32_t    nDivisor = (eInput == ADC_INPUT_TEMPERATURE) ? 256 : 1;
+
+      m_aADCLatched[eInput][ADC_STATISTIC_MIN] = sStatistics.nMin / nDivisor;
+      m_aADCLatched[eInput][ADC_STATISTIC_MAX] = sStatistics.nMax / nDivisor;
+      m_aADCLatched[eInput][ADC_STATISTIC_AVG] = (sStatistics.nSum / (int32_t) sStatistics.nCount) / nDivisor;
+    }
+  }
+
+  return (uint16_t) m_aADCLatched[eInput][eStatistic];
+}
+
+uint16_t ADC_Get_24V_Min(void)          { return ADC_GetStatistic(ADC_INPUT_24V, ADC_STATISTIC_MIN); }
+uint16_t ADC_Get_24V_Max(void)          { return ADC_GetStatistic(ADC_INPUT_24V, ADC_STATISTIC_MAX); }
+uint16_t ADC_Get_24V_Avg(void)          { return ADC_GetStatistic(ADC_INPUT_24V, ADC_STATISTIC_AVG); }
+uint16_t ADC_Get_3V3_Min(void)          { return ADC_GetStatistic(ADC_INPUT_3V3, ADC_STATISTIC_MIN); }
+uint16_t ADC_Get_3V3_Max(void)          { return ADC_GetStatistic(ADC_INPUT_3V3, ADC_STATISTIC_MAX); }
+uint16_t ADC_Get_3V3_Avg(void)          { return ADC_GetStatistic(ADC_INPUT_3V3, ADC_STATISTIC_AVG); }
+uint16_t ADC_Get_Temperature_Min(void)  { return ADC_GetStatistic(ADC_INPUT_TEMPERATURE, ADC_STATISTIC_MIN); }
+uint16_t ADC_Get_Temperature_Max(void)  { return ADC_GetStatistic(ADC_INPUT_TEMPERATURE, ADC_STATISTIC_MAX); }
+uint16_t ADC_Get_Temperature_Avg(void)  { return ADC_GetStatistic(ADC_INPUT_TEMPERATURE, ADC_STATISTIC_AVG); }
+uint16_t ADC_Get_VrefInt_Min(void)      { return ADC_GetStatistic(ADC_INPUT_VREFINT, ADC_STATISTIC_MIN); }
+uint16_t ADC_Get_VrefInt_Max(void)      { return ADC_GetStatistic(ADC_INPUT_VREFINT, ADC_STATISTIC_MAX); }
+uint16_t ADC_Get_VrefInt_Avg(void)      { return ADC_GetStatistic(ADC_INPUT_VREFINT, ADC_STATISTIC_AVG); }
+
 /*
    Function:  ADC_StartupTasksComplete()
    Description:
@@ -196,8 +460,58 @@ bool ADC_StartupTasksComplete(void)
  */
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* AdcHandle)
 {
-  /* Report to main program that ADC sequencer has reached its end */
-  ubSequenceCompleted = SET;
+  uint16_t    aCounts[ADC_NUM_CHANNELS];
+  int32_t     aValues[ADC_NUM_CHANNELS];
+
+  Scheduler_Post(SCHEDULER_EVENT_ADC);
+
+  // The end of a transient capture, rather than of the regular scan.
+  if (ADCCapture_Running())
+  {
+    ADCCapture_Complete(AdcHandle);
+    return;
+  }
+
+  for (int i = 0; i < ADC_NUM_CHANNELS; i++)
+  {
+    aCounts[i] = aADCxConvertedValues[i];
+  }
+
+  ADC_Convert(aCounts, aValues);
+
+  for (int i = 0; i < ADC_NUM_CHANNELS; i++)
+  {
+    ADC_Accumulate(&m_aADCWindow[i], aValues[i]);
+    ADC_Accumulate(&m_aADCStatistics[i], aValues[i]);
+  }
+
+  ADC_WatchdogUpdate(AdcHandle);
+}
+
+/**
+ * @brief  Analog watchdog 1 (24V) callback
+ * @note   Raises the fault straight away, and masks the watchdog until
+ *         ADC_Process() has seen the supply come back.
+ * @param  hadc: ADC handle
+ * @retval None
+ */
+void HAL_ADC_LevelOutOfWindowCallback(ADC_HandleTypeDef* hadc)
+{
+  __HAL_ADC_DISABLE_IT(hadc, ADC_IT_AWD1);
+  m_nADCWatchdogTrips++;
+  Fault_Activate(FAULT_VOLTAGE_24V_OUT_OF_SPEC);
+}
+
+/**
+ * @brief  Analog watchdog 2 (3V3) callback
+ * @param  hadc: ADC handle
+ * @retval None
+ */
+void HAL_ADCEx_LevelOutOfWindow2Callback(ADC_HandleTypeDef* hadc)
+{
+  __HAL_ADC_DISABLE_IT(hadc, ADC_IT_AWD2);
+  m_nADCWatchdogTrips++;
+  Fault_Activate(FAULT_VOLTAGE_3V3_OUT_OF_SPEC);
 }
 /**
  * @brief  Conversion DMA half-transfer callback in non blocking mode
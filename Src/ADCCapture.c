@@ -0,0 +1,342 @@
+/*
+ * ADCCapture.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *    Captures the 24V supply at a high rate around a relay write, so that
+ *    the dip as the coils pull in (and how long the supply takes to come
+ *    back) can be seen, rather than being averaged away by the 100 Hz scan.
+ *    Once armed over Modbus, the next DR write from Relay_Process() takes
+ *    the ADC over for a single burst of the 24V channel, DMA'd into RAM,
+ *    and then hands it back to the regular scan.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "ADC.h"
+#include "ADCCapture.h"
+#include "Diagnostics.h"
+
+_Static_assert(ADC_CAPTURE_PRE_SAMPLES < ADC_CAPTURE_SAMPLES, "The capture must have room after the write");
+
+static uint16_t                      m_aADCCapture[ADC_CAPTURE_SAMPLES] DMA_BUFFER;
+static volatile ADCCapture_State_T   m_eADCCaptureState = ADC_CAPTURE_IDLE;
+
+// The regular scan setup, put back once the capture is over.
+static uint32_t    m_nADCCaptureCFGR  = 0;
+static uint32_t    m_nADCCaptureCFGR2 = 0;
+static uint32_t    m_nADCCaptureSQR1  = 0;
+
+// Results of the last capture. Sample indices count from the start of
+// the buffer; times are from the write.
+static uint16_t    m_nADCCaptureTrigger  = 0;
+static uint16_t    m_nADCCaptureBaseline = 0;
+static uint16_t    m_nADCCaptureMinimum  = 0;
+static uint16_t    m_nADCCaptureMinimumTime  = 0;
+static uint16_t    m_nADCCaptureRecoveryTime = 0;
+
+extern __IO uint16_t    aADCxConvertedValues[ADC_NUM_CHANNELS];
+
+/*
+   Function:  ADCCapture_Arm()
+   Description:
+    Writing 1 arms a capture of the next relay write, and 0 disarms it.
+    A capture that is already under way can't be re-armed until it is done.
+ */
+ModbusException_T ADCCapture_Arm(uint16_t nValue)
+{
+  ModbusException_T    eReturn = MODBUS_EXCEPTION_OK;
+
+  if (nValue > 1)
+  {
+    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+  }
+  else if (m_eADCCaptureState == ADC_CAPTURE_RUNNING || m_eADCCaptureState == ADC_CAPTURE_DONE)
+  {
+    eReturn = MODBUS_EXCEPTION_SLAVE_DEVICE_BUSY;
+  }
+  else
+  {
+    m_eADCCaptureState = nValue ? ADC_CAPTURE_ARMED : ADC_CAPTURE_IDLE;
+  }
+
+  return eReturn;
+}
+
+/*
+   Function:  ADCCapture_Armed()
+              ADCCapture_Running()
+   Description:
+    Returns whether the next relay write is to be captured,
+    and whether the ADC currently belongs to a capture.
+ */
+bool ADCCapture_Armed(void)
+{
+  return m_eADCCaptureState == ADC_CAPTURE_ARMED;
+}
+bool ADCCapture_Running(void)
+{
+  return m_eADCCaptureState == ADC_CAPTURE_RUNNING;
+}
+
+/*
+   Function:  ADCCapture_Count()
+   Description:
+    Returns the number of samples captured so far.
+ */
+static uint16_t ADCCapture_Count(void)
+{
+  return ADC_CAPTURE_SAMPLES - __HAL_DMA_GET_COUNTER(Main_Get_ADC_Handle()->DMA_Handle);
+}
+
+/*
+   Function:  ADCCapture_Start()
+   Description:
+    If a capture is armed, switches the ADC over from the TIM6 triggered
+    scan to converting the 24V channel back to back (no oversampling),
+    into the capture buffer, and waits for the samples that go ahead of
+    the write. Returns true if the capture was started, in which case
+    ADCCapture_Trigger() must be called as the DR is written.
+    Called from Relay_Process(), just ahead of the write.
+ */
+bool ADCCapture_Start(void)
+{
+  ADC_HandleTypeDef*   hadc = Main_Get_ADC_Handle();
+  DMA_HandleTypeDef*   hdma = hadc->DMA_Handle;
+
+  if (m_eADCCaptureState != ADC_CAPTURE_ARMED)
+  {
+    return false;
+  }
+
+  // The configuration can only be changed with the ADC stopped.
+  LL_ADC_REG_StopConversion(hadc->Instance);
+
+  while (LL_ADC_REG_IsStopConversionOngoing(hadc->Instance))
+  {
+  }
+
+  HAL_DMA_Abort(hdma);
+
+  // The capture is armed and disarmed from the Modbus interrupt, so it may
+  // have been disarmed since the check above. With the scan stopped, its
+  // DMA interrupt can't get in the way of claiming the ADC.
+  uint32_t    nPRIMASK = __get_PRIMASK();
+  __set_PRIMASK(1);
+  bool        bArmed   = (m_eADCCaptureState == ADC_CAPTURE_ARMED);
+
+  if (bArmed)
+  {
+    m_eADCCaptureState = ADC_CAPTURE_RUNNING;
+  }
+  __set_PRIMASK(nPRIMASK);
+
+  if (!bArmed)
+  {
+    HAL_DMA_Start_IT(hdma, (uint32_t) &hadc->Instance->DR, (uint32_t) aADCxConvertedValues, ADC_NUM_CHANNELS);
+    LL_ADC_REG_StartConversion(hadc->Instance);
+    return false;
+  }
+
+  m_nADCCaptureCFGR  = hadc->Instance->CFGR;
+  m_nADCCaptureCFGR2 = hadc->Instance->CFGR2;
+  m_nADCCaptureSQR1  = hadc->Instance->SQR1;
+
+  LL_ADC_REG_SetSequencerLength(hadc->Instance, LL_ADC_REG_SEQ_SCAN_DISABLE);
+  LL_ADC_REG_SetSequencerRanks(hadc->Instance, LL_ADC_REG_RANK_1, LL_ADC_CHANNEL_1);
+  LL_ADC_SetOverSamplingScope(hadc->Instance, LL_ADC_OVS_DISABLE);
+  LL_ADC_REG_SetTriggerSource(hadc->Instance, LL_ADC_REG_TRIG_SOFTWARE);
+  LL_ADC_REG_SetContinuousMode(hadc->Instance, LL_ADC_REG_CONV_CONTINUOUS);
+  LL_ADC_REG_SetDMATransfer(hadc->Instance, LL_ADC_REG_DMA_TRANSFER_LIMITED);
+
+  // A single pass of the buffer. The ADC carries on converting after the
+  // last transfer until it is stopped, so its overrun is of no interest.
+  __HAL_ADC_DISABLE_IT(hadc, ADC_IT_OVR);
+  CLEAR_BIT(hdma->Instance->CCR, DMA_CCR_CIRC);
+
+  HAL_DMA_Start_IT(hdma, (uint32_t) &hadc->Instance->DR, (uint32_t) m_aADCCapture, ADC_CAPTURE_SAMPLES);
+  LL_ADC_REG_StartConversion(hadc->Instance);
+
+  // Give it a bounded time to fill the samples ahead of the write.
+  uint32_t    nStart   = DIAGNOSTICS_CYCLES();
+  uint32_t    nTimeout = ADC_CAPTURE_PRE_TIMEOUT_US * (SystemCoreClock / 1000000);
+
+  while (ADCCapture_Count() < ADC_CAPTURE_PRE_SAMPLES
+         && DIAGNOSTICS_CYCLES() - nStart < nTimeout)
+  {
+  }
+
+  return true;
+}
+
+/*
+   Function:  ADCCapture_Trigger()
+   Description:
+    Marks where in the capture the DR write happened.
+ */
+void ADCCapture_Trigger(void)
+{
+  m_nADCCaptureTrigger = ADCCapture_Count();
+}
+
+/*
+   Function:  ADCCapture_Complete()
+   Description:
+    Called from the DMA interrupt once the capture buffer is full.
+    Puts the regular scan back as it was, ready for the next TIM6 trigger.
+ */
+void ADCCapture_Complete(ADC_HandleTypeDef* hadc)
+{
+  DMA_HandleTypeDef*   hdma = hadc->DMA_Handle;
+
+  LL_ADC_REG_StopConversion(hadc->Instance);
+
+  while (LL_ADC_REG_IsStopConversionOngoing(hadc->Instance))
+  {
+  }
+
+  hadc->Instance->CFGR  = m_nADCCaptureCFGR;
+  hadc->Instance->CFGR2 = m_nADCCaptureCFGR2;
+  hadc->Instance->SQR1  = m_nADCCaptureSQR1;
+
+  SET_BIT(hdma->Instance->CCR, DMA_CCR_CIRC);
+  __HAL_ADC_CLEAR_FLAG(hadc, ADC_FLAG_OVR);
+  __HAL_ADC_ENABLE_IT(hadc, ADC_IT_OVR);
+
+  HAL_DMA_Start_IT(hdma, (uint32_t) &hadc->Instance->DR, (uint32_t) aADCxConvertedValues, ADC_NUM_CHANNELS);
+  LL_ADC_REG_StartConversion(hadc->Instance);
+
+  m_eADCCaptureState = ADC_CAPTURE_DONE;
+}
+
+/*
+   Function:  ADCCapture_SamplesToMicroseconds()
+   Description:
+    Converts a number of samples into microseconds, saturated to a register.
+ */
+static uint16_t ADCCapture_SamplesToMicroseconds(uint32_t nSamples)
+{
+  uint32_t    nMicroseconds = (nSamples * ADC_CAPTURE_SAMPLE_PERIOD_NS) / 1000;
+
+  return (nMicroseconds >= UINT16_MAX) ? (UINT16_MAX - 1) : (uint16_t) nMicroseconds;
+}
+
+/*
+   Function:  ADCCapture_Process()
+   Description:
+    Once a capture is in, works out the summary of it:
+      Baseline   Average of the samples ahead of the write (mV).
+      Minimum    Lowest sample after the write (mV), and how long after
+                 the write it came (us).
+      Recovery   How long after the write the supply first came back to
+                 within ADC_CAPTURE_RECOVERY_MV of the baseline, after the
+                 minimum (us), or 0xFFFF if it didn't within the capture.
+ */
+void ADCCapture_Process(void)
+{
+  if (m_eADCCaptureState != ADC_CAPTURE_DONE)
+  {
+    return;
+  }
+
+  uint16_t    nTrigger = m_nADCCaptureTrigger;
+  uint32_t    nSum     = 0;
+
+  // The write can't come before the first sample; there's always a baseline.
+  nTrigger = (nTrigger > 0) ? nTrigger : 1;
+
+  for (uint16_t i = 0; i < nTrigger; i++)
+  {
+    nSum += m_aADCCapture[i];
+  }
+
+  uint16_t    nBaselineCounts = (uint16_t) ((nSum + nTrigger / 2) / nTrigger);
+  uint16_t    nMinimumIndex   = nTrigger;
+
+  for (uint16_t i = nTrigger; i < ADC_CAPTURE_SAMPLES; i++)
+  {
+    if (m_aADCCapture[i] < m_aADCCapture[nMinimumIndex])
+    {
+      nMinimumIndex = i;
+    }
+  }
+
+  m_nADCCaptureBaseline    = ADC_CountsTo24V(nBaselineCounts);
+  m_nADCCaptureMinimum     = ADC_CountsTo24V(m_aADCCapture[nMinimumIndex]);
+  m_nADCCaptureMinimumTime = ADCCapture_SamplesToMicroseconds(nMinimumIndex - nTrigger);
+  m_nADCCaptureRecoveryTime = UINT16_MAX;
+
+  for (uint16_t i = nMinimumIndex; i < ADC_CAPTURE_SAMPLES; i++)
+  {
+    if (ADC_CountsTo24V(m_aADCCapture[i]) + ADC_CAPTURE_RECOVERY_MV >= m_nADCCaptureBaseline)
+    {
+      m_nADCCaptureRecoveryTime = ADCCapture_SamplesToMicroseconds(i - nTrigger);
+      break;
+    }
+  }
+
+  m_eADCCaptureState = ADC_CAPTURE_COMPLETE;
+}
+
+/*
+   Function:  ADCCapture_GetState()
+              ADCCapture_GetBaseline()
+              ADCCapture_GetMinimum()
+              ADCCapture_GetMinimumTime()
+              ADCCapture_GetRecoveryTime()
+              ADCCapture_GetTriggerIndex()
+              ADCCapture_GetSamplePeriod()
+   Description:
+    Returns the state (ADCCapture_State_T) and the summary of the last
+    capture, as described in ADCCapture_Process().
+ */
+uint16_t ADCCapture_GetState(void)
+{
+  return (uint16_t) m_eADCCaptureState;
+}
+uint16_t ADCCapture_GetBaseline(void)
+{
+  return m_nADCCaptureBaseline;
+}
+uint16_t ADCCapture_GetMinimum(void)
+{
+  return m_nADCCaptureMinimum;
+}
+uint16_t ADCCapture_GetMinimumTime(void)
+{
+  return m_nADCCaptureMinimumTime;
+}
+uint16_t ADCCapture_GetRecoveryTime(void)
+{
+  return m_nADCCaptureRecoveryTime;
+}
+uint16_t ADCCapture_GetTriggerIndex(void)
+{
+  return m_nADCCaptureTrigger;
+}
+uint16_t ADCCapture_GetSamplePeriod(void)
+{
+  return ADC_CAPTURE_SAMPLE_PERIOD_NS;
+}
+
+/*
+   Function:  ADCCapture_ReadFileRecord()
+   Description:
+    Reads a single sample of the last capture, in mV.
+    Only available once the capture is complete.
+ */
+ModbusException_T ADCCapture_ReadFileRecord(uint16_t nRecord, uint16_t* pValue)
+{
+  ModbusException_T    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+  if (m_eADCCaptureState == ADC_CAPTURE_COMPLETE && nRecord < ADC_CAPTURE_SAMPLES)
+  {
+    *pValue = ADC_CountsTo24V(m_aADCCapture[nRecord]);
+    eReturn = MODBUS_EXCEPTION_OK;
+  }
+
+  return eReturn;
+}
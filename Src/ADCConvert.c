@@ -0,0 +1,87 @@
+/*
+ * ADCConvert.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *    Fixed-point conversion of the ADC readings into mV and degrees C.
+ *    Kept free of the HAL, so that the host check in Support/ADCAccuracy
+ *    builds this same source against the double-precision conversion.
+ */
+
+#include "ADCConvert.h"
+
+/*
+   Function:  ADCConvert_Scale()
+   Description:
+    Returns NUM / (ADC_MAX_COUNTS * DEN) in Q32, rounded up, so that
+    truncating a product with it gives the same result as the exact ratio.
+ */
+static uint32_t ADCConvert_Scale(uint32_t nNum, uint32_t nDen)
+{
+  uint64_t    nDivisor = (uint64_t) ADC_MAX_COUNTS * nDen;
+
+  return (uint32_t) ((((uint64_t) nNum << 32) + nDivisor - 1) / nDivisor);
+}
+
+/*
+   Function:  ADCConvert_Init()
+   Description:
+    Precomputes the scale factors from the factory calibration values:
+    the VREFINT reading at ADC_VREF_CAL_VOLT, and the temperature sensor
+    readings at ADC_TEMP1 and ADC_TEMP2.
+ */
+void ADCConvert_Init(ADCConvert_T * pConvert, uint16_t nVrefCal, uint16_t nTempCal1, uint16_t nTempCal2)
+{
+  pConvert->nVrefScale    = (uint32_t) nVrefCal * ADC_VREF_CAL_VOLT;
+  pConvert->n24VScale     = ADCConvert_Scale(ADC_24V_DIVIDER_TOTAL, ADC_24V_DIVIDER_LOW);
+  pConvert->n3V3Scale     = ADCConvert_Scale(ADC_3V3_DIVIDER_TOTAL, ADC_3V3_DIVIDER_LOW);
+  pConvert->nVrefIntScale = ADCConvert_Scale(1, 1);
+
+  pConvert->nTempCalQ8    = (uint32_t) nVrefCal << 8;
+  pConvert->nTempOffsetQ8 = (int32_t) nTempCal1 << 8;
+  pConvert->nTempSlopeQ16 = (int32_t) ((((int64_t) (ADC_TEMP2 - ADC_TEMP1)) << 16) / ((int32_t) nTempCal2 - nTempCal1));
+}
+
+/*
+   Function:  ADCConvert_Sequence()
+   Description:
+    Converts one sequence of conversions into readings: mV for the
+    supplies and VREFINT, Q8 degrees C for the temperature.
+    Returns Vref (mV), as worked out from the VREFINT reading.
+ */
+uint16_t ADCConvert_Sequence(const ADCConvert_T * pConvert, const uint16_t * aCounts, int32_t * aValues)
+{
+  uint32_t    nVrefIntCounts = aCounts[ADC_INPUT_VREFINT];
+  uint16_t    nVref;
+
+  // A zero reading would only come from a broken ADC; don't divide by it.
+  nVrefIntCounts = (nVrefIntCounts != 0) ? nVrefIntCounts : 1;
+
+  nVref = pConvert->nVrefScale / nVrefIntCounts;
+
+  aValues[ADC_INPUT_24V] = ((uint64_t) (aCounts[ADC_INPUT_24V] * nVref) * pConvert->n24VScale) >> 32;
+  aValues[ADC_INPUT_3V3] = ((uint64_t) (aCounts[ADC_INPUT_3V3] * nVref) * pConvert->n3V3Scale) >> 32;
+
+  int32_t    nTemperatureQ8 = (int32_t) ((aCounts[ADC_INPUT_TEMPERATURE] * pConvert->nTempCalQ8) / nVrefIntCounts) - pConvert->nTempOffsetQ8;
+
+  nTemperatureQ8  = (int32_t) (((int64_t) nTemperatureQ8 * pConvert->nTempSlopeQ16) >> 16);
+  nTemperatureQ8 += ADC_TEMP1 << 8;
+
+  aValues[ADC_INPUT_TEMPERATURE] = nTemperatureQ8;
+  aValues[ADC_INPUT_VREFINT]     = ((uint64_t) (nVrefIntCounts * nVref) * pConvert->nVrefIntScale) >> 32;
+
+  return nVref;
+}
+
+/*
+   Function:  ADCConvert_24V()
+   Description:
+    Converts a single raw reading of the 24V channel into mV,
+    at the given Vref (mV).
+ */
+uint16_t ADCConvert_24V(const ADCConvert_T * pConvert, uint16_t nCounts, uint16_t nVref)
+{
+  return ((uint64_t) (nCounts * nVref) * pConvert->n24VScale) >> 32;
+}
@@ -0,0 +1,298 @@
+/*
+ * ADCHistory.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *    History of the supply voltages and temperature, so that the master
+ *    can see trends without polling the live readings at a high rate.
+ *    Each channel keeps a ring of one second samples, and a ring of one
+ *    minute min/avg/max aggregates, delta encoded a byte at a time so
+ *    that an hour of a channel comes back in a single FC 0x14 request.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "ADC.h"
+#include "ADCHistory.h"
+#include "Timebase.h"
+
+/*
+   Structure: ADCHistory_Ring_T
+   Description:
+    A ring of delta encoded entries. The first byte of each entry is the
+    change from the previous entry; any other bytes belong to the caller.
+    nBase is the value of the oldest entry, and nLast the value of the
+    newest, as a reader would reconstruct it.
+ */
+typedef struct
+{
+  uint8_t*    pBuffer;
+  uint16_t    nEntrySize;
+  uint16_t    nEntries;
+  uint16_t    nHead;
+  uint16_t    nCount;
+  int32_t     nBase;
+  int32_t     nLast;
+} ADCHistory_Ring_T;
+
+#define ADCHISTORY_SECOND_ENTRY_SIZE    (1)
+#define ADCHISTORY_MINUTE_ENTRY_SIZE    (3)
+
+static uint8_t              m_aADCHistorySeconds[ADCHISTORY_CHANNEL_COUNT][ADCHISTORY_SECONDS * ADCHISTORY_SECOND_ENTRY_SIZE];
+static uint8_t              m_aADCHistoryMinutes[ADCHISTORY_CHANNEL_COUNT][ADCHISTORY_MINUTES * ADCHISTORY_MINUTE_ENTRY_SIZE];
+static ADCHistory_Ring_T    m_aADCHistorySecondRing[ADCHISTORY_CHANNEL_COUNT];
+static ADCHistory_Ring_T    m_aADCHistoryMinuteRing[ADCHISTORY_CHANNEL_COUNT];
+
+static const int32_t        m_aADCHistoryQuantum[ADCHISTORY_CHANNEL_COUNT] =
+{
+  ADCHISTORY_QUANTUM_24V,
+  ADCHISTORY_QUANTUM_3V3,
+  ADCHISTORY_QUANTUM_TEMPERATURE,
+};
+
+// The minute currently being collected.
+static int32_t     m_aADCHistorySum[ADCHISTORY_CHANNEL_COUNT];
+static int32_t     m_aADCHistoryMin[ADCHISTORY_CHANNEL_COUNT];
+static int32_t     m_aADCHistoryMax[ADCHISTORY_CHANNEL_COUNT];
+static uint16_t    m_nADCHistorySamples = 0;
+
+static bool        m_bADCHistoryInit      = false;
+static uint32_t    m_nADCHistoryTimestamp = 0;
+
+/*
+   Function:  ADCHistory_Quantise()
+   Description:
+    Converts a difference into the nearest whole number of quanta,
+    saturated to fit in the given range.
+ */
+static int32_t ADCHistory_Quantise(int32_t nDifference, int32_t nQuantum, int32_t nMin, int32_t nMax)
+{
+  int32_t    nSteps = (nDifference >= 0) ? (nDifference + nQuantum / 2) / nQuantum
+                                         : -((-nDifference + nQuantum / 2) / nQuantum);
+
+  return (nSteps < nMin) ? nMin : (nSteps > nMax) ? nMax : nSteps;
+}
+
+/*
+   Function:  ADCHistory_Push()
+   Description:
+    Appends an entry for nValue to the ring, dropping the oldest if it's
+    full, and returns a pointer to the entry so that the caller can fill
+    in the rest of it. The change is encoded against the value a reader
+    would reconstruct, so that saturation is made up in later entries
+    rather than accumulating.
+ */
+static uint8_t* ADCHistory_Push(ADCHistory_Ring_T* pRing, int32_t nValue, int32_t nQuantum)
+{
+  int32_t     nDelta = 0;
+  uint8_t*    pEntry;
+
+  if (pRing->nCount == 0)
+  {
+    pRing->nBase = nValue;
+    pRing->nLast = nValue;
+  }
+  else
+  {
+    nDelta        = ADCHistory_Quantise(nValue - pRing->nLast, nQuantum, INT8_MIN, INT8_MAX);
+    pRing->nLast += nDelta * nQuantum;
+  }
+
+  if (pRing->nCount == pRing->nEntries)
+  {
+    // The entry after the oldest becomes the oldest.
+    uint16_t    nNext = (pRing->nHead + 1) % pRing->nEntries;
+
+    pRing->nBase += (int8_t) pRing->pBuffer[nNext * pRing->nEntrySize] * nQuantum;
+  }
+  else
+  {
+    pRing->nCount++;
+  }
+
+  pEntry       = &pRing->pBuffer[pRing->nHead * pRing->nEntrySize];
+  pEntry[0]    = (uint8_t) (int8_t) nDelta;
+  pRing->nHead = (pRing->nHead + 1) % pRing->nEntries;
+
+  return pEntry;
+}
+
+/*
+   Function:  ADCHistory_Read()
+   Description:
+    Reads a single record (register) of a ring, as laid out in ADCHistory.h.
+ */
+static ModbusException_T ADCHistory_Read(const ADCHistory_Ring_T* pRing, int32_t nQuantum, uint16_t nRecord, uint16_t* pValue)
+{
+  ModbusException_T    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+  uint32_t             nBytes  = (uint32_t) pRing->nCount * pRing->nEntrySize;
+
+  if (nRecord == 0)
+  {
+    *pValue = pRing->nCount;
+    eReturn = MODBUS_EXCEPTION_OK;
+  }
+  else if (nRecord == 1)
+  {
+    *pValue = (uint16_t) pRing->nBase;
+    eReturn = MODBUS_EXCEPTION_OK;
+  }
+  else if (nRecord == 2)
+  {
+    *pValue = (uint16_t) nQuantum;
+    eReturn = MODBUS_EXCEPTION_OK;
+  }
+  else if ((uint32_t) (nRecord - 3) * 2 < nBytes)
+  {
+    uint8_t    aByte[2] = {0};
+
+    for (uint32_t nIndex = 0; nIndex < 2; nIndex++)
+    {
+      uint32_t    nByte  = (uint32_t) (nRecord - 3) * 2 + nIndex;
+      uint32_t    nEntry = nByte / pRing->nEntrySize;
+      uint32_t    nField = nByte % pRing->nEntrySize;
+      uint32_t    nSlot  = (pRing->nHead + pRing->nEntries - pRing->nCount + nEntry) % pRing->nEntries;
+
+      // The oldest entry's change is meaningless; its value is the base.
+      if (nByte < nBytes && !(nEntry == 0 && nField == 0))
+      {
+        aByte[nIndex] = pRing->pBuffer[nSlot * pRing->nEntrySize + nField];
+      }
+    }
+    *pValue = (aByte[0] << 8) | aByte[1];
+    eReturn = MODBUS_EXCEPTION_OK;
+  }
+
+  return eReturn;
+}
+
+/*
+   Function:  ADCHistory_Process()
+   Description:
+    Samples each channel once a second into its second ring, and
+    once a minute adds the aggregate of those samples to its minute ring.
+ */
+void ADCHistory_Process(void)
+{
+  if (!m_bADCHistoryInit)
+  {
+    for (int nChannel = 0; nChannel < ADCHISTORY_CHANNEL_COUNT; nChannel++)
+    {
+      m_aADCHistorySecondRing[nChannel] = (ADCHistory_Ring_T) {m_aADCHistorySeconds[nChannel], ADCHISTORY_SECOND_ENTRY_SIZE, ADCHISTORY_SECONDS, 0, 0, 0, 0};
+      m_aADCHistoryMinuteRing[nChannel] = (ADCHistory_Ring_T) {m_aADCHistoryMinutes[nChannel], ADCHISTORY_MINUTE_ENTRY_SIZE, ADCHISTORY_MINUTES, 0, 0, 0, 0};
+    }
+    m_nADCHistoryTimestamp = uwTick;
+    m_bADCHistoryInit      = true;
+  }
+
+  // Until the ADC has readings, there's nothing to sample;
+  // the first sample is taken a period after they arrive.
+  if (!ADC_StartupTasksComplete())
+  {
+    m_nADCHistoryTimestamp = uwTick;
+    return;
+  }
+
+  if (!Timebase_ElapsedMilliseconds(m_nADCHistoryTimestamp, ADCHISTORY_SAMPLE_PERIOD_MS))
+  {
+    return;
+  }
+
+  // Keep in step with the period, unless a whole period or more has been
+  // missed; then start again from now, rather than catching up with a
+  // burst of samples that were never really taken a second apart.
+  if (Timebase_ElapsedMilliseconds(m_nADCHistoryTimestamp, 2 * ADCHISTORY_SAMPLE_PERIOD_MS))
+  {
+    m_nADCHistoryTimestamp = uwTick;
+  }
+  else
+  {
+    m_nADCHistoryTimestamp += ADCHISTORY_SAMPLE_PERIOD_MS;
+  }
+
+  int32_t    aSample[ADCHISTORY_CHANNEL_COUNT] =
+  {
+    ADC_Get_Supply_Voltage(),
+    ADC_Get_3V3_Voltage(),
+    (int16_t) ADC_Get_Temperature(),
+  };
+
+  for (int nChannel = 0; nChannel < ADCHISTORY_CHANNEL_COUNT; nChannel++)
+  {
+    int32_t    nSample  = aSample[nChannel];
+    uint32_t   nPRIMASK = __get_PRIMASK();
+
+    // The rings are read from the Modbus interrupt.
+    __set_PRIMASK(1);
+    ADCHistory_Push(&m_aADCHistorySecondRing[nChannel], nSample, m_aADCHistoryQuantum[nChannel]);
+    __set_PRIMASK(nPRIMASK);
+
+    if (m_nADCHistorySamples == 0 || nSample < m_aADCHistoryMin[nChannel])
+    {
+      m_aADCHistoryMin[nChannel] = nSample;
+    }
+    if (m_nADCHistorySamples == 0 || nSample > m_aADCHistoryMax[nChannel])
+    {
+      m_aADCHistoryMax[nChannel] = nSample;
+    }
+    m_aADCHistorySum[nChannel] = (m_nADCHistorySamples == 0) ? nSample : m_aADCHistorySum[nChannel] + nSample;
+  }
+
+  if (++m_nADCHistorySamples == (60000 / ADCHISTORY_SAMPLE_PERIOD_MS))
+  {
+    for (int nChannel = 0; nChannel < ADCHISTORY_CHANNEL_COUNT; nChannel++)
+    {
+      ADCHistory_Ring_T*    pRing    = &m_aADCHistoryMinuteRing[nChannel];
+      int32_t               nQuantum = m_aADCHistoryQuantum[nChannel];
+      int32_t               nAverage = m_aADCHistorySum[nChannel] / m_nADCHistorySamples;
+      uint32_t              nPRIMASK = __get_PRIMASK();
+
+      __set_PRIMASK(1);
+      uint8_t*              pEntry   = ADCHistory_Push(pRing, nAverage, nQuantum);
+
+      // The spread is relative to the average as the reader sees it.
+      pEntry[1] = (uint8_t) ADCHistory_Quantise(pRing->nLast - m_aADCHistoryMin[nChannel], nQuantum, 0, UINT8_MAX);
+      pEntry[2] = (uint8_t) ADCHistory_Quantise(m_aADCHistoryMax[nChannel] - pRing->nLast, nQuantum, 0, UINT8_MAX);
+      __set_PRIMASK(nPRIMASK);
+    }
+    m_nADCHistorySamples = 0;
+  }
+}
+
+/*
+   Function:  ADCHistory_ReadSeconds24V()
+              ADCHistory_ReadSeconds3V3()
+              ADCHistory_ReadSecondsTemperature()
+              ADCHistory_ReadMinutes24V()
+              ADCHistory_ReadMinutes3V3()
+              ADCHistory_ReadMinutesTemperature()
+   Description:
+    Reads a single record (register) of the file of each ring.
+ */
+ModbusException_T ADCHistory_ReadSeconds24V(uint16_t nRecord, uint16_t* pValue)
+{
+  return ADCHistory_Read(&m_aADCHistorySecondRing[ADCHISTORY_CHANNEL_24V], ADCHISTORY_QUANTUM_24V, nRecord, pValue);
+}
+ModbusException_T ADCHistory_ReadSeconds3V3(uint16_t nRecord, uint16_t* pValue)
+{
+  return ADCHistory_Read(&m_aADCHistorySecondRing[ADCHISTORY_CHANNEL_3V3], ADCHISTORY_QUANTUM_3V3, nRecord, pValue);
+}
+ModbusException_T ADCHistory_ReadSecondsTemperature(uint16_t nRecord, uint16_t* pValue)
+{
+  return ADCHistory_Read(&m_aADCHistorySecondRing[ADCHISTORY_CHANNEL_TEMPERATURE], ADCHISTORY_QUANTUM_TEMPERATURE, nRecord, pValue);
+}
+ModbusException_T ADCHistory_ReadMinutes24V(uint16_t nRecord, uint16_t* pValue)
+{
+  return ADCHistory_Read(&m_aADCHistoryMinuteRing[ADCHISTORY_CHANNEL_24V], ADCHISTORY_QUANTUM_24V, nRecord, pValue);
+}
+ModbusException_T ADCHistory_ReadMinutes3V3(uint16_t nRecord, uint16_t* pValue)
+{
+  return ADCHistory_Read(&m_aADCHistoryMinuteRing[ADCHISTORY_CHANNEL_3V3], ADCHISTORY_QUANTUM_3V3, nRecord, pValue);
+}
+ModbusException_T ADCHistory_ReadMinutesTemperature(uint16_t nRecord, uint16_t* pValue)
+{
+  return ADCHistory_Read(&m_aADCHistoryMinuteRing[ADCHISTORY_CHANNEL_TEMPERATURE], ADCHISTORY_QUANTUM_TEMPERATURE, nRecord, pValue);
+}
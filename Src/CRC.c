@@ -15,6 +15,7 @@
    ------------------------------------------------------------------------------*/
 #include "CRC.h"
 #include "stdint.h"
+#include "main.h"
 
 // ------------------------------------------------------------------------------
 /* Table of CRC values for high-order byte */
@@ -69,7 +70,7 @@ const unsigned char    auchCRCLo[256] = {
    Description   : Computes 16bit CRC of an array if bytes
    Notes         :
    -------------------------------------------------------------------------------*/
-unsigned int CRC16(const unsigned char* puchMsg, unsigned int usDataLen)
+RAMFUNC unsigned int CRC16(const unsigned char* puchMsg, unsigned int usDataLen)
 {
   unsigned char    uchCRCHi;
   unsigned char    uchCRCLo;
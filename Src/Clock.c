@@ -0,0 +1,243 @@
+/*
+ * Clock.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *  	Core clock policy for the Heceta Relay Module.
+ *  	The core runs from HSI16 while there is nothing much to do, and is
+ *  	switched over to the 80 MHz PLL while a module has work under way
+ *  	that benefits from it: a Modbus request, a serial flash job, or a
+ *  	relay write. The PLL is started once at power up and left running,
+ *  	so a switch is only the flash wait states, prefetch, caches and SYSCLK mux, plus
+ *  	bringing everything that is timed off the core clock back in line:
+ *  		-	SysTick and the microsecond timebase
+ *  		-	The Modbus character timer (TIM2)
+ *  		-	The SPI1 prescaler
+ *  		-	The ADC trigger timer (TIM6)
+ *  	The UARTs are clocked from HSI16 regardless, so their baud rates
+ *  	don't change, and the ADC is clocked from PLLSAI1.
+ *  	Intervals measured in DWT cycles across a switch are converted at
+ *  	the clock at the end of the interval, so they are only approximate.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "Clock.h"
+#include "Timebase.h"
+#include "ModbusSlave.h"
+#include "SPIFlash.h"
+#include "ADC.h"
+#include "Diagnostics.h"
+
+static volatile uint32_t m_nClockDemand = 0;
+static Clock_Policy_T m_eClockPolicy = CLOCK_POLICY_DYNAMIC;
+
+static bool m_bClockHigh = false;
+static uint32_t m_nClockIdleTimestamp = 0;
+static uint16_t m_nClockSwitchCount = 0;
+
+//	Time spent at each clock, in microseconds, up to the last switch.
+static uint64_t m_nClockSwitchTimestamp = 0;
+static uint64_t m_nClockHighMicroseconds = 0;
+
+/*
+	Function:	Clock_Demand()
+	Description:
+		Raises or drops one or more kinds of demand for the high clock.
+		Safe to call from interrupt context. The clock itself is only
+		switched from Clock_Process(), in the main loop.
+*/
+void Clock_Demand(uint32_t nDemand, bool bActive)
+{
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	if (bActive)
+	{
+		m_nClockDemand |= nDemand;
+	}
+	else
+	{
+		m_nClockDemand &= ~nDemand;
+	}
+
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	Clock_Switch()
+	Description:
+		Switches SYSCLK between HSI16 and the PLL, with the flash wait states,
+		prefetch and caches changed on the safe side of the switch, and brings
+		everything timed off the core clock back in line.
+		Done with interrupts masked, so that nothing sees the clock and
+		its dependants disagree. Returns false, and is to be tried again
+		later, if the switch can't be made right now.
+*/
+static bool Clock_Switch(bool bHigh)
+{
+	//	The SPI can't have its prescaler changed mid-transfer,
+	//	and the PLL has to be up before it can be used.
+	if (SPIFlash_InTransfer() || (bHigh && !__HAL_RCC_GET_FLAG(RCC_FLAG_PLLRDY)))
+	{
+		return false;
+	}
+
+	uint32_t nPRIMASK = __get_PRIMASK();
+	uint32_t nOldClock = SystemCoreClock;
+	uint64_t nNow;
+
+	__set_PRIMASK(1);
+
+	nNow = Timebase_GetMicroseconds();
+
+	if (m_bClockHigh)
+	{
+		m_nClockHighMicroseconds += nNow - m_nClockSwitchTimestamp;
+	}
+	m_nClockSwitchTimestamp = nNow;
+
+	if (bHigh)
+	{
+		__HAL_FLASH_SET_LATENCY(CLOCK_HIGH_FLASH_LATENCY);
+		while (__HAL_FLASH_GET_LATENCY() != CLOCK_HIGH_FLASH_LATENCY)
+		{
+		}
+		__HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+		__HAL_FLASH_INSTRUCTION_CACHE_ENABLE();
+		__HAL_FLASH_DATA_CACHE_ENABLE();
+
+		__HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_PLLCLK);
+		while (__HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_PLLCLK)
+		{
+		}
+	}
+	else
+	{
+		__HAL_RCC_SYSCLK_CONFIG(RCC_SYSCLKSOURCE_HSI);
+		while (__HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_HSI)
+		{
+		}
+
+		__HAL_FLASH_SET_LATENCY(CLOCK_LOW_FLASH_LATENCY);
+		while (__HAL_FLASH_GET_LATENCY() != CLOCK_LOW_FLASH_LATENCY)
+		{
+		}
+		__HAL_FLASH_PREFETCH_BUFFER_DISABLE();
+		__HAL_FLASH_INSTRUCTION_CACHE_ENABLE();
+		__HAL_FLASH_DATA_CACHE_ENABLE();
+	}
+
+	SystemCoreClock = HAL_RCC_GetSysClockFreq();
+	Timebase_ClockChange();
+	HAL_InitTick(uwTickPrio);
+
+	ModbusSlave_UpdateClock(nOldClock);
+	SPIFlash_UpdateClock();
+	ADC_UpdateClock();
+
+	m_bClockHigh = bHigh;
+
+	if (m_nClockSwitchCount < UINT16_MAX)
+	{
+		m_nClockSwitchCount++;
+	}
+
+	__set_PRIMASK(nPRIMASK);
+
+	return true;
+}
+
+/*
+	Function:	Clock_Process()
+	Description:
+		Called at the top of every pass of the main loop, including the
+		one right after waking up, so that the clock is raised as soon as
+		work turns up. It's dropped again once there's been no demand for
+		CLOCK_IDLE_HOLD_MS.
+*/
+void Clock_Process(void)
+{
+	bool bHigh;
+
+	switch (m_eClockPolicy)
+	{
+		case CLOCK_POLICY_LOW:
+			bHigh = false;
+			break;
+		case CLOCK_POLICY_HIGH:
+			bHigh = true;
+			break;
+		default:
+			if (m_nClockDemand != 0)
+			{
+				m_nClockIdleTimestamp = uwTick;
+				bHigh = true;
+			}
+			else
+			{
+				bHigh = m_bClockHigh && !Timebase_ElapsedMilliseconds(m_nClockIdleTimestamp, CLOCK_IDLE_HOLD_MS);
+			}
+			break;
+	}
+
+	if (bHigh != m_bClockHigh)
+	{
+		Clock_Switch(bHigh);
+	}
+
+	//	Once at each clock, time the ART caches on and off.
+	Diagnostics_CacheBenchmark(m_bClockHigh);
+}
+
+/*
+	Function:	Clock_SetPolicy()
+				Clock_GetPolicy()
+	Description:
+		Sets or returns the clock policy (see Clock_Policy_T).
+		Takes effect on the next pass of the main loop.
+*/
+ModbusException_T Clock_SetPolicy(uint16_t nPolicy)
+{
+	if (nPolicy >= CLOCK_POLICY_COUNT)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	m_eClockPolicy = (Clock_Policy_T) nPolicy;
+
+	return MODBUS_EXCEPTION_OK;
+}
+uint16_t Clock_GetPolicy(void)
+{
+	return m_eClockPolicy;
+}
+
+/*
+	Function:	Clock_GetFrequency()
+				Clock_GetHighResidency()
+				Clock_GetSwitchCount()
+	Description:
+		Return the present core clock in MHz, the share of the time since
+		power up spent at the high clock in tenths of a percent, and the
+		number of switches made.
+*/
+uint16_t Clock_GetFrequency(void)
+{
+	return SystemCoreClock / 1000000;
+}
+uint16_t Clock_GetHighResidency(void)
+{
+	uint64_t nNow = Timebase_GetMicroseconds();
+	uint64_t nHigh = m_nClockHighMicroseconds + (m_bClockHigh ? nNow - m_nClockSwitchTimestamp : 0);
+
+	return (nNow == 0) ? 0 : (uint16_t) ((nHigh * 1000) / nNow);
+}
+uint16_t Clock_GetSwitchCount(void)
+{
+	return m_nClockSwitchCount;
+}
@@ -21,6 +21,7 @@
 #include "ByteFIFO.h"
 #include "string.h"
 #include "ModbusSlave.h"
+#include "Scheduler.h"
 
 #define	COMM_TIMEOUT_LIMIT	5000
 
@@ -40,6 +41,10 @@ static uint32_t m_nSerialInputBufferPos = 0;
 
 static bool m_bReadyToAcceptData = false;
 
+//	Bank of 16 relays addressed by the individual relay keys.
+//	Bank 0 is relays 1-16, bank 1 is relays 17-32, and so on.
+static uint8_t m_nRelayBank = 0;
+
 //	Output buffer
 //	For now, this is commented out since we aren't using it specifically for anything.
 //	static char m_aSerialOutputBuffer[SERIAL_OUTPUT_BUFFER_SIZE] = {0};
@@ -230,11 +235,27 @@ void Command_Process(void)
 					break;
 
 				case '[':
-					Relay_Request(0);
+					Relay_RequestMap(0);
 					break;
 
 				case ']':
-					Relay_Request(0xFFFF);
+					Relay_RequestMap(RELAY_MAP_ALL);
+					break;
+
+				case '<':
+				case '>':
+					//	Select the previous/next bank of 16 relays.
+					if (nIncomingChar == '<' && m_nRelayBank > 0)
+					{
+						m_nRelayBank--;
+					}
+					else if (nIncomingChar == '>' && m_nRelayBank + 1 < RELAY_MAP_WORDS)
+					{
+						m_nRelayBank++;
+					}
+					//	The last bank may be short of 16 relays.
+					printf("\n\rRelays %d-%d", (m_nRelayBank * 16) + 1,
+							((m_nRelayBank * 16) + 16 < RELAY_COUNT) ? (m_nRelayBank * 16) + 16 : RELAY_COUNT);
 					break;
 
 				case '1':
@@ -246,7 +267,7 @@ void Command_Process(void)
 				case '7':
 				case '8':
 				case '9':
-					Relay_Request(1 << (nIncomingChar - '1'));
+					Relay_RequestMap((RelayMap_T) 1 << ((m_nRelayBank * 16) + (nIncomingChar - '1')));
 					break;
 
 				case 'a':
@@ -256,7 +277,7 @@ void Command_Process(void)
 				case 'e':
 				case 'f':
 				case 'g':
-					Relay_Request(1 << (nIncomingChar - 'a' + 9));
+					Relay_RequestMap((RelayMap_T) 1 << ((m_nRelayBank * 16) + (nIncomingChar - 'a' + 9)));
 					break;
 				case '?':
 				default:
@@ -266,6 +287,7 @@ void Command_Process(void)
 					printf("[ - All off.\n\r");
 					printf("] - All on.\n\r");
 					printf("1-9, a-g - Individual Relay\n\r");
+					printf("<, > - Previous/next bank of 16 relays\n\r");
 					printf("? - Help\n\r");
 
 					break;
@@ -440,6 +462,7 @@ void Command_UART_RxISR_8BIT(UART_HandleTypeDef *huart)
 
 		//	Enqueues the result into the FIFO
 		bool bInserted = FIFO_Enqueue(&m_sCommandBufferFIFO, &res);
+		Scheduler_Post(SCHEDULER_EVENT_COMMAND);
 
 		//	Determine if we've overrun our FIFO. If so, we should disable
 		//	the USART RX line for the time being, since we can't really
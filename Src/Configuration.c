@@ -10,6 +10,9 @@
 #include "Version.h"
 #include "ModbusSlave.h"
 #include "EEPROM.h"
+#include "Relay.h"
+#include "Journal.h"
+#include "Timebase.h"
 #include "core_cm4.h"
 
 // The active Modbus configuration in use.
@@ -83,29 +86,30 @@ void Configuration_Init(void)
 void Configuration_Process(void)
 {
   // Parameter unlock code reset after CONFIGURATION_PARAMETER_UNLOCK_TIMEOUT_MS.
-  if (uwTick - m_sModbusConfiguration.nParameterUnlockTimeout > CONFIGURATION_PARAMETER_UNLOCK_TIMEOUT_MS)
+  if (Timebase_ElapsedMilliseconds(m_sModbusConfiguration.nParameterUnlockTimeout, CONFIGURATION_PARAMETER_UNLOCK_TIMEOUT_MS))
   {
     m_sModbusConfiguration.bParameterUnlocked = FALSE;
   }
 
   // Manual override timer
-  if (uwTick - m_sManualOutputConfiguration.nTimeout > CONFIGURATION_MANUAL_OUTPUT_TIMEOUT_MS)
+  if (Timebase_ElapsedMilliseconds(m_sManualOutputConfiguration.nTimeout, CONFIGURATION_MANUAL_OUTPUT_TIMEOUT_MS))
   {
     m_sManualOutputConfiguration.bOverrideEnabled = false;
   }
 
   // Restart timer
   if (m_sManualOutputConfiguration.bRebootRequest &&
-      (uwTick - m_sManualOutputConfiguration.nRebootRequestTimestamp > CONFIGURATION_RESTART_TIMEOUT_MS))
+      Timebase_ElapsedMilliseconds(m_sManualOutputConfiguration.nRebootRequestTimestamp, CONFIGURATION_RESTART_TIMEOUT_MS))
   {
     NVIC_SystemReset();
   }
 
   // Factory Reset timer
   if (m_sManualOutputConfiguration.bFactoryResetRequest &&
-      (uwTick - m_sManualOutputConfiguration.nFactoryResetRequestTimestamp > CONFIGURATION_FACTORY_RESTART_TIMEOUT_MS))
+      Timebase_ElapsedMilliseconds(m_sManualOutputConfiguration.nFactoryResetRequestTimestamp, CONFIGURATION_FACTORY_RESTART_TIMEOUT_MS))
   {
     EEPROM_SetDefaultEEPROMValues();
+    Journal_Log(JOURNAL_EVENT_CONFIG_WRITE, JOURNAL_CONFIG_DEFAULTS, 0);
     m_sManualOutputConfiguration.bFactoryResetRequest = false;
   }
 }
@@ -182,28 +186,74 @@ uint16_t Configuration_GetMessageLength(void)
         Configuration_SetFaultRelayMap()
    Description:
     Returns the relay map.
+    The map is held 16 relays to a register; the base functions cover
+    relays 1-16, and the _17_32 etc. variants the rest of a longer chain.
  */
-uint16_t Configuration_GetFaultRelayMap()
+static uint16_t Configuration_GetFaultRelayMapWord(uint8_t nWord)
 {
-  return EEPROM_GetFaultRegisterMap();
+  return (uint16_t) (EEPROM_GetFaultRegisterMap() >> (16 * nWord));
 }
-ModbusException_T Configuration_SetFaultRelayMap(uint16_t nFaultRelayMap)
+static ModbusException_T Configuration_SetFaultRelayMapWord(uint8_t nWord, uint16_t nFaultRelayMap)
 {
   // By default, we only allow setting this parameter if
   // the correct parameter unlock lock has been specified.
   ModbusException_T    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
 
-  if (m_sModbusConfiguration.bParameterUnlocked == TRUE)
+  if (m_sModbusConfiguration.bParameterUnlocked == TRUE && nWord < RELAY_MAP_WORDS)
   {
     // Reset the timer.
     m_sModbusConfiguration.nParameterUnlockTimeout = uwTick;
 
-    EEPROM_SetFaultRegisterMap(nFaultRelayMap);
-    eReturn = MODBUS_EXCEPTION_OK;
+    RelayMap_T    nMask = (RelayMap_T) 0xFFFF << (16 * nWord);
+    RelayMap_T    nMap  = (EEPROM_GetFaultRegisterMap() & ~nMask) | ((RelayMap_T) nFaultRelayMap << (16 * nWord));
+
+    if (nMap & ~RELAY_MAP_ALL)
+    {
+      // Relays that aren't fitted.
+      eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    }
+    else
+    {
+      EEPROM_SetFaultRegisterMap(nMap);
+      Journal_Log(JOURNAL_EVENT_CONFIG_WRITE, JOURNAL_CONFIG_FAULT_RELAY_MAP + nWord, nFaultRelayMap);
+      eReturn = MODBUS_EXCEPTION_OK;
+    }
   }
 
   return eReturn;
 }
+uint16_t Configuration_GetFaultRelayMap()
+{
+  return Configuration_GetFaultRelayMapWord(0);
+}
+ModbusException_T Configuration_SetFaultRelayMap(uint16_t nFaultRelayMap)
+{
+  return Configuration_SetFaultRelayMapWord(0, nFaultRelayMap);
+}
+uint16_t Configuration_GetFaultRelayMap_17_32(void)
+{
+  return Configuration_GetFaultRelayMapWord(1);
+}
+ModbusException_T Configuration_SetFaultRelayMap_17_32(uint16_t nFaultRelayMap)
+{
+  return Configuration_SetFaultRelayMapWord(1, nFaultRelayMap);
+}
+uint16_t Configuration_GetFaultRelayMap_33_48(void)
+{
+  return Configuration_GetFaultRelayMapWord(2);
+}
+ModbusException_T Configuration_SetFaultRelayMap_33_48(uint16_t nFaultRelayMap)
+{
+  return Configuration_SetFaultRelayMapWord(2, nFaultRelayMap);
+}
+uint16_t Configuration_GetFaultRelayMap_49_64(void)
+{
+  return Configuration_GetFaultRelayMapWord(3);
+}
+ModbusException_T Configuration_SetFaultRelayMap_49_64(uint16_t nFaultRelayMap)
+{
+  return Configuration_SetFaultRelayMapWord(3, nFaultRelayMap);
+}
 
 /*
    Function:  Configuration_GetFailsafeRelayEnable()
@@ -227,12 +277,74 @@ ModbusException_T Configuration_SetFailsafeRelayEnable(uint16_t nFailsafeRelayEn
     m_sModbusConfiguration.nParameterUnlockTimeout = uwTick;
 
     EEPROM_SetFailsafeRelayEnable(nFailsafeRelayEnable);
+    Journal_Log(JOURNAL_EVENT_CONFIG_WRITE, JOURNAL_CONFIG_FAILSAFE_RELAY_ENABLE, nFailsafeRelayEnable);
     eReturn = MODBUS_EXCEPTION_OK;
   }
 
   return eReturn;
 }
 
+/*
+   Function:  Configuration_GetRelayVerifyPeriod()
+        Configuration_SetRelayVerifyPeriod()
+   Description:
+    Returns the period at which the relay drivers are read back
+    and verified, in milliseconds.
+ */
+uint16_t Configuration_GetRelayVerifyPeriod(void)
+{
+  return Relay_GetVerifyPeriod();
+}
+ModbusException_T Configuration_SetRelayVerifyPeriod(uint16_t nPeriod)
+{
+  // By default, we only allow setting this parameter if
+  // the correct parameter unlock lock has been specified.
+  ModbusException_T    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+  if (m_sModbusConfiguration.bParameterUnlocked == TRUE)
+  {
+    // Reset the timer.
+    m_sModbusConfiguration.nParameterUnlockTimeout = uwTick;
+
+    eReturn = Relay_SetVerifyPeriod(nPeriod);
+
+    if (eReturn == MODBUS_EXCEPTION_OK)
+    {
+      Journal_Log(JOURNAL_EVENT_CONFIG_WRITE, JOURNAL_CONFIG_RELAY_VERIFY_PERIOD, nPeriod);
+    }
+  }
+
+  return eReturn;
+}
+
+/*
+   Function:  Configuration_GetEEPROMCoalesceWindow()
+        Configuration_SetEEPROMCoalesceWindow()
+   Description:
+    Returns how long, in milliseconds, configuration changes are
+    collected before they are written out to the serial flash.
+ */
+uint16_t Configuration_GetEEPROMCoalesceWindow(void)
+{
+  return EEPROM_GetCoalesceWindow();
+}
+ModbusException_T Configuration_SetEEPROMCoalesceWindow(uint16_t nWindow)
+{
+  // By default, we only allow setting this parameter if
+  // the correct parameter unlock lock has been specified.
+  ModbusException_T    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+  if (m_sModbusConfiguration.bParameterUnlocked == TRUE)
+  {
+    // Reset the timer.
+    m_sModbusConfiguration.nParameterUnlockTimeout = uwTick;
+
+    eReturn = EEPROM_SetCoalesceWindow(nWindow) ? MODBUS_EXCEPTION_OK : MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+  }
+
+  return eReturn;
+}
+
 /*
    Function:  Configuration_GetParameterUnlockCode()
         Configuration_SetParameterUnlockCode()
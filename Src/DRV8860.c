@@ -16,7 +16,7 @@
 		At the conclusion of its run, leaves the latch in the high position
 		and the clock in the low position.
 */
-void DRV8860_SpecialCommandPulse(uint8_t nPulsePart2, uint8_t nPulsePart3, uint8_t nPulsePart4)
+RAMFUNC void DRV8860_SpecialCommandPulse(uint8_t nPulsePart2, uint8_t nPulsePart3, uint8_t nPulsePart4)
 {
 	//	For this particular operation, we'll need to send a pattern of
 	//	latch and clock commands. This will cause the relay chips to go
@@ -98,7 +98,7 @@ void DRV8860_SpecialCommandPulse(uint8_t nPulsePart2, uint8_t nPulsePart3, uint8
 	Description:
 		Performs a Control Register Write operation.
 */
-void DRV8860_DataRegisterWrite(DRV8860_DataRegister_T * aWrite, uint8_t nDevCount)
+RAMFUNC void DRV8860_DataRegisterWrite(DRV8860_DataRegister_T * aWrite, uint8_t nDevCount)
 {
 	//	Latch down
 	DRV8860_PIN_LAT(0);
@@ -154,7 +154,7 @@ void DRV8860_DataRegisterWrite(DRV8860_DataRegister_T * aWrite, uint8_t nDevCoun
 	Description:
 		Performs a Control Register Write operation.
 */
-void DRV8860_ControlRegisterWrite(DRV8860_ControlRegister_T * aWrite, uint8_t nDevCount)
+RAMFUNC void DRV8860_ControlRegisterWrite(DRV8860_ControlRegister_T * aWrite, uint8_t nDevCount)
 {
 	//	For this particular operation, we'll need to send a pattern of
 	//	latch and clock commands. This will cause the relay chips to go
@@ -217,7 +217,7 @@ void DRV8860_ControlRegisterWrite(DRV8860_ControlRegister_T * aWrite, uint8_t nD
 	Description:
 		Performs a Control Register Read operation.
 */
-void DRV8860_ControlRegisterRead(DRV8860_ControlRegister_T * aRead, uint8_t nDevCount)
+RAMFUNC void DRV8860_ControlRegisterRead(DRV8860_ControlRegister_T * aRead, uint8_t nDevCount)
 {
 	//	For this particular operation, we'll need to send a pattern of
 	//	latch and clock commands. This will cause the relay chips to go
@@ -263,7 +263,7 @@ void DRV8860_ControlRegisterRead(DRV8860_ControlRegister_T * aRead, uint8_t nDev
 	Description:
 		Performs a Data Register Read operation.
 */
-void DRV8860_DataRegisterRead(DRV8860_DataRegister_T * aRead, uint8_t nDevCount)
+RAMFUNC void DRV8860_DataRegisterRead(DRV8860_DataRegister_T * aRead, uint8_t nDevCount)
 {
 	//	For this particular operation, we'll need to send a pattern of
 	//	latch and clock commands. This will cause the relay chips to go
@@ -306,3 +306,74 @@ void DRV8860_DataRegisterRead(DRV8860_DataRegister_T * aRead, uint8_t nDevCount)
 
 
 
+#ifdef DRV8860_READ_FAULT_REGISTERS
+/*
+	Function:	DRV8860_DataRegisterWriteFaultRead
+	Description:
+		Rewrites the Data Registers, reading the Fault Registers out
+		on the way. The falling edge of the latch loads each device's
+		fault register into its shift register, from where it is shifted
+		out on R_DIN while the new data is shifted in on R_DOUT; the
+		rising edge of the latch then takes in the data as usual.
+		Each device takes 16 clocks, with its data register in the
+		lower 8 bits.
+		Not yet checked on the bench; see DRV8860_READ_FAULT_REGISTERS.
+*/
+RAMFUNC void DRV8860_DataRegisterWriteFaultRead(DRV8860_DataRegister_T * aWrite, DRV8860_FaultRegister_T * aFault, uint8_t nDevCount)
+{
+	//	Latch down.
+	//	This loads the fault registers.
+	DRV8860_PIN_LAT(0);
+	delay_us(1);
+
+	DRV8860_PIN_CLK(0);
+	delay_us(2);
+
+	uint8_t nDevCntr = nDevCount;
+	while (nDevCntr > 0)
+	{
+		DRV8860_FaultRegister_T nWrite = aWrite[nDevCntr-1];
+
+		//	Begin to clock out data, and in the fault register.
+		//	Remember--data clocked out on RISING EDGE of the clock.
+		uint8_t nBitCount = (sizeof(DRV8860_FaultRegister_T) * 8);
+		while (nBitCount > 0)
+		{
+			//	Set the output pin
+			bool bValueOut = ((nWrite >> (nBitCount-1)) & 1);
+			DRV8860_PIN_DOUT(bValueOut);
+
+			//	Read the fault bit presently on the way out.
+			bool bIncomingBit = DRV8860_PIN_DIN();
+			aFault[nDevCntr-1] = (aFault[nDevCntr-1] << 1) | bIncomingBit;
+
+			//	Make up for the 1us missing in the clock down
+			//	from the previous iteration.
+			delay_us(1);
+
+			//	Clock Up
+			DRV8860_PIN_CLK(1);
+			delay_us(3);
+
+			//	Clock down
+			//	Note that the delay here is 2us, we'll
+			//	make up for the 1us in the loop back.
+			DRV8860_PIN_CLK(0);
+			delay_us(2);
+
+			//	Decrease the bit count
+			nBitCount--;
+		}
+
+		//	Decrease the dev count.
+		nDevCntr--;
+	}
+	//	Make up for the 1us missing in the clock down
+	//	from the previous iteration.
+	delay_us(1);
+
+	//	Latch up
+	DRV8860_PIN_LAT(1);
+	delay_us(1);
+}
+#endif
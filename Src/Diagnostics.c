@@ -0,0 +1,267 @@
+/*
+ * Diagnostics.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *  	Timing diagnostics for the Heceta Relay Module.
+ *  	Uses the DWT cycle counter to measure how long each pass of the
+ *  	main loop takes, so that the effect of changes to the individual
+ *  	modules can be observed over Modbus, along with the run times of
+ *  	the hot paths.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "Diagnostics.h"
+#include "CRC.h"
+
+//	Timestamp (in cycles) of the start of the current main loop pass.
+static uint32_t m_nLoopTimestamp = 0;
+static bool m_bLoopTimestampValid = false;
+
+//	Loop time statistics, in cycles.
+//	The average is stored scaled up by DIAGNOSTICS_LOOP_AVERAGE_SHIFT
+//	so that the moving average does not lose its fractional part.
+static uint32_t m_nLoopTimeLast = 0;
+static uint32_t m_nLoopTimeMax = 0;
+static uint32_t m_nLoopTimeAverageScaled = 0;
+
+/*
+	Structure:	Diagnostics_HotPathStats_T
+	Description:
+		Run time statistics of a hot path, in cycles.
+		Each hot path is only recorded from one context at a time.
+*/
+typedef struct
+{
+	uint32_t nCyclesMin;
+	uint32_t nCyclesMax;
+	uint16_t nRuns;
+}	Diagnostics_HotPathStats_T;
+
+static Diagnostics_HotPathStats_T m_aDiagnosticsHotPath[DIAGNOSTICS_HOTPATH_COUNT];
+
+//	Benchmark results, in cycles, per benchmark and then per clock
+//	(low, high) and cache setting (on, off); see Diagnostics.h.
+static uint32_t m_aDiagnosticsBenchmark[DIAGNOSTICS_BENCHMARK_COUNT][DIAGNOSTICS_BENCHMARK_REGISTERS];
+static bool m_aDiagnosticsBenchmarkDone[2] = {false, false};
+
+/*
+	Function:	Diagnostics_Init()
+	Description:
+		Enables the DWT cycle counter.
+		Must be called before any of the other diagnostics are used.
+*/
+void Diagnostics_Init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*
+	Function:	Diagnostics_CyclesToMicroseconds()
+	Description:
+		Converts a cycle count (as measured by DIAGNOSTICS_CYCLES())
+		into microseconds, based on the current core clock.
+*/
+uint32_t Diagnostics_CyclesToMicroseconds(uint32_t nCycles)
+{
+	return nCycles / (SystemCoreClock / 1000000);
+}
+
+/*
+	Function:	Diagnostics_LoopProcess()
+	Description:
+		Called once per pass of the main loop.
+		Measures the time since the previous call and folds it into
+		the loop time statistics.
+*/
+void Diagnostics_LoopProcess(void)
+{
+	uint32_t nNow = DIAGNOSTICS_CYCLES();
+
+	if (m_bLoopTimestampValid)
+	{
+		m_nLoopTimeLast = nNow - m_nLoopTimestamp;
+
+		if (m_nLoopTimeLast > m_nLoopTimeMax)
+		{
+			m_nLoopTimeMax = m_nLoopTimeLast;
+		}
+
+		//	Exponential moving average:
+		//	avg += (sample - avg) / 2^DIAGNOSTICS_LOOP_AVERAGE_SHIFT
+		m_nLoopTimeAverageScaled -= (m_nLoopTimeAverageScaled >> DIAGNOSTICS_LOOP_AVERAGE_SHIFT);
+		m_nLoopTimeAverageScaled += m_nLoopTimeLast;
+	}
+
+	m_nLoopTimestamp = nNow;
+	m_bLoopTimestampValid = true;
+}
+
+/*
+	Function:	Diagnostics_GetLoopTimeLast()
+				Diagnostics_GetLoopTimeMax()
+				Diagnostics_GetLoopTimeAverage()
+	Description:
+		Returns the requested main loop time statistic, in microseconds.
+		Values that do not fit in a register are saturated.
+*/
+static uint16_t Diagnostics_Saturate(uint32_t nValue)
+{
+	return (nValue > UINT16_MAX) ? UINT16_MAX : (uint16_t) nValue;
+}
+uint16_t Diagnostics_GetLoopTimeLast(void)
+{
+	return Diagnostics_Saturate(Diagnostics_CyclesToMicroseconds(m_nLoopTimeLast));
+}
+uint16_t Diagnostics_GetLoopTimeMax(void)
+{
+	return Diagnostics_Saturate(Diagnostics_CyclesToMicroseconds(m_nLoopTimeMax));
+}
+uint16_t Diagnostics_GetLoopTimeAverage(void)
+{
+	return Diagnostics_Saturate(Diagnostics_CyclesToMicroseconds(m_nLoopTimeAverageScaled >> DIAGNOSTICS_LOOP_AVERAGE_SHIFT));
+}
+
+/*
+	Function:	Diagnostics_HotPathRecord()
+	Description:
+		Folds a run of a hot path, which started at nStart (as read from
+		DIAGNOSTICS_CYCLES()), into its statistics.
+*/
+void Diagnostics_HotPathRecord(Diagnostics_HotPath_T eHotPath, uint32_t nStart)
+{
+	uint32_t nCycles = DIAGNOSTICS_CYCLES() - nStart;
+	Diagnostics_HotPathStats_T * pStats = &m_aDiagnosticsHotPath[eHotPath];
+
+	if (pStats->nRuns == 0 || nCycles < pStats->nCyclesMin)
+	{
+		pStats->nCyclesMin = nCycles;
+	}
+	if (nCycles > pStats->nCyclesMax)
+	{
+		pStats->nCyclesMax = nCycles;
+	}
+	if (pStats->nRuns < UINT16_MAX)
+	{
+		pStats->nRuns++;
+	}
+}
+
+/*
+	Function:	Diagnostics_BenchmarkRun()
+	Description:
+		Times one benchmark, returning the shortest of
+		DIAGNOSTICS_BENCHMARK_RUNS runs, in cycles.
+*/
+static uint32_t Diagnostics_BenchmarkRun(Diagnostics_Benchmark_T eBenchmark)
+{
+	uint32_t nBest = UINT32_MAX;
+
+	for (uint8_t nRun = 0; nRun < DIAGNOSTICS_BENCHMARK_RUNS; nRun++)
+	{
+		uint32_t nStart = DIAGNOSTICS_CYCLES();
+
+		if (eBenchmark == DIAGNOSTICS_BENCHMARK_CRC16)
+		{
+			CRC16((const unsigned char *) SRAM1_BASE, DIAGNOSTICS_BENCHMARK_BYTES);
+		}
+		else
+		{
+			CRC_Fast_CRC16(0, FLASH_BASE, DIAGNOSTICS_BENCHMARK_BYTES);
+		}
+
+		uint32_t nCycles = DIAGNOSTICS_CYCLES() - nStart;
+
+		if (nCycles < nBest)
+		{
+			nBest = nCycles;
+		}
+	}
+
+	return nBest;
+}
+
+/*
+	Function:	Diagnostics_CacheBenchmark()
+	Description:
+		Called by the clock module once it's running at a clock.
+		The first time at each clock, times the benchmarks with the ART
+		caches as they are, then with both turned off, and puts them
+		back (reset, as the reference manual asks before re-enabling).
+		Interrupts are left on; whatever they run from flash is slower
+		while the caches are off, which is a few milliseconds at most.
+*/
+void Diagnostics_CacheBenchmark(bool bHighClock)
+{
+	if (m_aDiagnosticsBenchmarkDone[bHighClock])
+	{
+		return;
+	}
+
+	uint8_t nColumn = bHighClock ? 2 : 0;
+
+	for (uint8_t nBenchmark = 0; nBenchmark < DIAGNOSTICS_BENCHMARK_COUNT; nBenchmark++)
+	{
+		m_aDiagnosticsBenchmark[nBenchmark][nColumn] = Diagnostics_BenchmarkRun((Diagnostics_Benchmark_T) nBenchmark);
+	}
+
+	__HAL_FLASH_INSTRUCTION_CACHE_DISABLE();
+	__HAL_FLASH_DATA_CACHE_DISABLE();
+
+	for (uint8_t nBenchmark = 0; nBenchmark < DIAGNOSTICS_BENCHMARK_COUNT; nBenchmark++)
+	{
+		m_aDiagnosticsBenchmark[nBenchmark][nColumn + 1] = Diagnostics_BenchmarkRun((Diagnostics_Benchmark_T) nBenchmark);
+	}
+
+	__HAL_FLASH_INSTRUCTION_CACHE_RESET();
+	__HAL_FLASH_DATA_CACHE_RESET();
+	__HAL_FLASH_INSTRUCTION_CACHE_ENABLE();
+	__HAL_FLASH_DATA_CACHE_ENABLE();
+
+	m_aDiagnosticsBenchmarkDone[bHighClock] = true;
+}
+
+/*
+	Function:	Diagnostics_ReadHotPathRecord()
+	Description:
+		Reads a single record (register) of the hot path file,
+		hot paths and then benchmarks, as laid out in Diagnostics.h.
+*/
+ModbusException_T Diagnostics_ReadHotPathRecord(uint16_t nRecord, uint16_t * pValue)
+{
+	uint16_t nHotPath = nRecord / DIAGNOSTICS_HOTPATH_REGISTERS;
+
+	if (nHotPath >= DIAGNOSTICS_HOTPATH_COUNT)
+	{
+		uint16_t nBenchmarkRecord = nRecord - DIAGNOSTICS_HOTPATH_COUNT * DIAGNOSTICS_HOTPATH_REGISTERS;
+		uint16_t nBenchmark = nBenchmarkRecord / DIAGNOSTICS_BENCHMARK_REGISTERS;
+
+		if (nBenchmark >= DIAGNOSTICS_BENCHMARK_COUNT)
+		{
+			return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+		}
+
+		*pValue = Diagnostics_Saturate(m_aDiagnosticsBenchmark[nBenchmark][nBenchmarkRecord % DIAGNOSTICS_BENCHMARK_REGISTERS]);
+
+		return MODBUS_EXCEPTION_OK;
+	}
+
+	const Diagnostics_HotPathStats_T * pStats = &m_aDiagnosticsHotPath[nHotPath];
+
+	switch (nRecord % DIAGNOSTICS_HOTPATH_REGISTERS)
+	{
+		case 0:	*pValue = (uint16_t) (pStats->nCyclesMin >> 16);	break;
+		case 1:	*pValue = (uint16_t) pStats->nCyclesMin;			break;
+		case 2:	*pValue = (uint16_t) (pStats->nCyclesMax >> 16);	break;
+		case 3:	*pValue = (uint16_t) pStats->nCyclesMax;			break;
+		default:	*pValue = pStats->nRuns;						break;
+	}
+
+	return MODBUS_EXCEPTION_OK;
+}
@@ -6,21 +6,108 @@
  */
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
+#include "main.h"
 #include "EEPROM.h"
 #include "SPIFlash.h"
 #include "CRC.h"
+#include "Timebase.h"
+#include "Relay.h"
+
+// Layout of a single record in the configuration log.
+// Each record is exactly one page, so that it is written by a single
+// page program operation, and holds the complete configuration.
+// The commit marker is the last thing in the page. It alternates between
+// A and B on each lap of the log, so that a record is only accepted if
+// its sequence number, its position in the log and its marker all agree.
+typedef struct
+{
+  uint32_t    nSequence;
+  uint16_t    nVersion;
+  uint16_t    nFailsafeRelayEnable;
+  uint64_t    nFaultRegisterMap;
+  uint16_t    nRelayVerifyPeriod;
+  uint8_t     aReserved[10];
+  uint16_t    nCRC;
+  uint16_t    nCommit;
+} EEPROM_Record_T;
+
+_Static_assert(sizeof(EEPROM_Record_T) == SPIFLASH_PAGE_SIZE, "EEPROM_Record_T must be exactly one page");
+
+#define EEPROM_RECORD_COMMIT_A       (0xA55A)
+#define EEPROM_RECORD_COMMIT_B       (0x5AA5)
+
+#define EEPROM_DIRTY_WORDS           ((SPIFLASH_PAGE_COUNT + 31) / 32)
 
 static EEPROM_Configuration_T    m_sEEPROMConfiguration;
-static EEPROM_Configuration_T    m_sEEPROMConfigurationVerify;
 static unsigned int              m_nEEPROMConfigurationFaultCntr = 0;
 static bool                      m_bEEPROMConfigurationDirty     = false;
+static SPIFlash_Request_T        m_sEEPROMRequest                = {0};
+
+// RAM mirror of the whole serial flash.
+// It is read in once at startup; from then on, all reads come from here,
+// and writes land here first. Each page that is changed is marked dirty,
+// and dirty pages are written out once the coalescing window has passed,
+// so that a burst of changes to the same page costs a single page write.
+static uint8_t                   m_aEEPROMMirror[SPIFLASH_CHIP_SIZE] DMA_BUFFER;
+static bool                      m_bEEPROMMirrorLoaded = false;
+static uint32_t                  m_aEEPROMDirty[EEPROM_DIRTY_WORDS] = {0};
+static uint32_t                  m_nEEPROMDirtyTimestamp  = 0;
+static uint32_t                  m_nEEPROMCoalesceWindow  = EEPROM_COALESCE_WINDOW_MS_DEFAULT;
+
+// The page presently being flushed, and the CRC of the snapshot of it
+// that was written. The snapshot is done with once the write is, before
+// the page is read back for verification, so the two share a buffer.
+// Both go through the SPI DMA.
+typedef union
+{
+  uint8_t    aFlush[SPIFLASH_PAGE_SIZE];
+  uint8_t    aVerify[SPIFLASH_PAGE_SIZE];
+} EEPROM_Page_T;
+
+static EEPROM_Page_T             m_uEEPROMPage DMA_BUFFER;
+static uint16_t                  m_nEEPROMFlushPage = 0;
+static uint16_t                  m_nEEPROMFlushCRC  = 0;
+
+// Statistics.
+static uint32_t                  m_nEEPROMPageWriteCount     = 0;
+static uint32_t                  m_nEEPROMPageFlushCount     = 0;
+static uint32_t                  m_nEEPROMVerifyFailureCount = 0;
+
+// Position of the log.
+// m_nEEPROMLogHead is the page holding the newest record, and
+// m_nEEPROMSequence that record's sequence number. While m_bEEPROMHeadPending
+// is set, the record has been placed in the mirror but not yet flushed.
+static uint16_t                  m_nEEPROMLogHead      = EEPROM_LOG_FIRST_PAGE;
+static uint32_t                  m_nEEPROMSequence     = 0;
+static bool                      m_bEEPROMHeadPending  = false;
+
+// Configuration left by older firmware, at the start of page 0.
+// A migrated log starts on the page after it, and the old configuration
+// is only erased once a record of the log has been written and verified,
+// so that a reset part way through loses neither.
+#define EEPROM_LEGACY_PAGE               (0)
+static bool                      m_bEEPROMLegacyPending = false;
+
+// Layout of the configuration as written by NVVER_V0 firmware,
+// which only supported a 16 relay fault map.
+// Kept so that existing units keep their configuration on upgrade.
+typedef struct
+{
+  EEPROM_Version_T    nVersion;
+  uint16_t            nFaultRegisterMap;
+  uint16_t            nFailsafeRelayEnable;
+  uint16_t            nCRC;
+} EEPROM_Configuration_V0_T;
+
+#define EEPROM_CRC_LEN(T)    (offsetof(T, nCRC))
 
 typedef enum
 {
   // The following states are "init" states
   EEPROM_STATE_STARTUP_READ,
-  EEPROM_STATE_STARTUP_VERIFY,
+  EEPROM_STATE_STARTUP_SCAN,
 
   // The following states are "ready" states
   EEPROM_STATE_IDLE,
@@ -31,12 +118,284 @@ typedef enum
 
 static EEPROM_State_T    m_eEEPROMState = EEPROM_STATE_STARTUP_READ;
 
+/*
+   Function:  EEPROM_PageDirty()
+              EEPROM_SetPageDirty()
+              EEPROM_ClearPageDirty()
+              EEPROM_AnyPageDirty()
+   Description:
+    Helpers for the per-page dirty bits of the mirror.
+ */
+static bool EEPROM_PageDirty(uint16_t nPage)
+{
+  return (m_aEEPROMDirty[nPage / 32] >> (nPage % 32)) & 1;
+}
+static bool EEPROM_AnyPageDirty(void)
+{
+  uint32_t    nAny = 0;
+
+  for (uint16_t nWord = 0; nWord < EEPROM_DIRTY_WORDS; nWord++)
+  {
+    nAny |= m_aEEPROMDirty[nWord];
+  }
+  return nAny != 0;
+}
+static void EEPROM_SetPageDirty(uint16_t nPage)
+{
+  // The coalescing window starts with the first change
+  // since everything was last clean.
+  if (!EEPROM_AnyPageDirty())
+  {
+    m_nEEPROMDirtyTimestamp = uwTick;
+  }
+  m_aEEPROMDirty[nPage / 32] |= (1UL << (nPage % 32));
+}
+static void EEPROM_ClearPageDirty(uint16_t nPage)
+{
+  m_aEEPROMDirty[nPage / 32] &= ~(1UL << (nPage % 32));
+}
+
+/*
+   Function:  EEPROM_MirrorRead()
+   Description:
+    Copies nSize bytes at nAddress out of the mirror.
+    Returns false if the mirror has not been loaded yet,
+    or the range is outside of the serial flash.
+ */
+bool EEPROM_MirrorRead(uint16_t nAddress, void* pBuffer, uint16_t nSize)
+{
+  bool    bReturn = false;
+
+  if (m_bEEPROMMirrorLoaded && (uint32_t) nAddress + nSize <= SPIFLASH_CHIP_SIZE)
+  {
+    // The Modbus interrupt reads the mirror while the main loop writes it,
+    // so copies in and out are made with interrupts masked.
+    uint32_t    nPRIMASK = __get_PRIMASK();
+    __set_PRIMASK(1);
+    memcpy(pBuffer, &m_aEEPROMMirror[nAddress], nSize);
+    __set_PRIMASK(nPRIMASK);
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+/*
+   Function:  EEPROM_MirrorWrite()
+   Description:
+    Copies nSize bytes to nAddress in the mirror, and marks the pages
+    that actually changed as dirty. They are written out to the serial
+    flash by EEPROM_Process() once the coalescing window has passed.
+    Returns false if the mirror has not been loaded yet,
+    or the range is outside of the serial flash.
+ */
+bool EEPROM_MirrorWrite(uint16_t nAddress, const void* pBuffer, uint16_t nSize)
+{
+  const uint8_t*    pData   = (const uint8_t*) pBuffer;
+  bool              bReturn = false;
+
+  if (m_bEEPROMMirrorLoaded && (uint32_t) nAddress + nSize <= SPIFLASH_CHIP_SIZE)
+  {
+    while (nSize)
+    {
+      uint16_t    nPage  = nAddress / SPIFLASH_PAGE_SIZE;
+      uint16_t    nChunk = SPIFLASH_PAGE_SIZE - (nAddress % SPIFLASH_PAGE_SIZE);
+
+      if (nChunk > nSize)
+      {
+        nChunk = nSize;
+      }
+
+      uint32_t    nPRIMASK = __get_PRIMASK();
+      __set_PRIMASK(1);
+
+      if (memcmp(&m_aEEPROMMirror[nAddress], pData, nChunk))
+      {
+        memcpy(&m_aEEPROMMirror[nAddress], pData, nChunk);
+        EEPROM_SetPageDirty(nPage);
+        m_nEEPROMPageWriteCount += 1;
+      }
+
+      __set_PRIMASK(nPRIMASK);
+
+      nAddress += nChunk;
+      pData    += nChunk;
+      nSize    -= nChunk;
+    }
+    bReturn = true;
+  }
+
+  return bReturn;
+}
+
+/*
+   Function:  EEPROM_RecordCommitMarker()
+   Description:
+    Returns the commit marker expected on a record with
+    the given sequence number.
+ */
+static uint16_t EEPROM_RecordCommitMarker(uint32_t nSequence)
+{
+  return ((nSequence / EEPROM_LOG_PAGE_COUNT) & 1) ? EEPROM_RECORD_COMMIT_B : EEPROM_RECORD_COMMIT_A;
+}
+
+/*
+   Function:  EEPROM_RecordValid()
+   Description:
+    Returns true if the record read from the given page of the log
+    is complete, intact, and belongs in that page.
+ */
+static bool EEPROM_RecordValid(const EEPROM_Record_T* pRecord, uint16_t nPage)
+{
+  return pRecord->nVersion == NVVER_V2
+         && (pRecord->nSequence % EEPROM_LOG_PAGE_COUNT) == (nPage - EEPROM_LOG_FIRST_PAGE)
+         && pRecord->nCommit == EEPROM_RecordCommitMarker(pRecord->nSequence)
+         && CRC16((uint8_t*) pRecord, EEPROM_CRC_LEN(EEPROM_Record_T)) == pRecord->nCRC;
+}
+
+/*
+   Function:  EEPROM_AppendRecord()
+   Description:
+    Places the present configuration in the log, as a record in the mirror.
+
+    If the newest record hasn't started being flushed yet, it is simply
+    replaced, so that a run of changes inside the coalescing window ends
+    up as a single record. Otherwise the record goes on the next page;
+    the one before is never touched, so there is always a committed copy
+    to fall back on if the write is interrupted.
+ */
+static void EEPROM_AppendRecord(void)
+{
+  EEPROM_Record_T    sRecord;
+
+  if (!(m_bEEPROMHeadPending && EEPROM_PageDirty(m_nEEPROMLogHead)))
+  {
+    m_nEEPROMSequence += 1;
+    m_nEEPROMLogHead   = EEPROM_LOG_FIRST_PAGE + (m_nEEPROMSequence % EEPROM_LOG_PAGE_COUNT);
+  }
+
+  memset(&sRecord, 0, sizeof(sRecord));
+  sRecord.nSequence            = m_nEEPROMSequence;
+  sRecord.nVersion             = NVVER_CURRENT;
+
+  // The configuration is changed from the Modbus interrupt. Take it, and
+  // clear the dirty bit, in one go so that no change is lost in between.
+  uint32_t    nPRIMASK = __get_PRIMASK();
+  __set_PRIMASK(1);
+  sRecord.nFailsafeRelayEnable = m_sEEPROMConfiguration.nFailsafeRelayEnable;
+  sRecord.nFaultRegisterMap    = m_sEEPROMConfiguration.nFaultRegisterMap;
+  sRecord.nRelayVerifyPeriod   = m_sEEPROMConfiguration.nRelayVerifyPeriod;
+  m_bEEPROMConfigurationDirty  = false;
+  __set_PRIMASK(nPRIMASK);
+
+  sRecord.nCRC                 = CRC16((uint8_t*) &sRecord, EEPROM_CRC_LEN(EEPROM_Record_T));
+  sRecord.nCommit              = EEPROM_RecordCommitMarker(m_nEEPROMSequence);
+
+  EEPROM_MirrorWrite(m_nEEPROMLogHead * SPIFLASH_PAGE_SIZE, &sRecord, sizeof(sRecord));
+  m_bEEPROMHeadPending        = true;
+}
+
+/*
+   Function:  EEPROM_LoadLog()
+   Description:
+    Scans the log in the mirror for the newest valid record, and loads
+    the configuration from it. This is a fixed number of pages, all
+    already in RAM, so it takes a bounded time.
+    Returns true if a record was found.
+ */
+static bool EEPROM_LoadLog(void)
+{
+  EEPROM_Record_T    sRecord;
+  bool               bFound = false;
+
+  for (uint16_t nPage = EEPROM_LOG_FIRST_PAGE; nPage < EEPROM_LOG_FIRST_PAGE + EEPROM_LOG_PAGE_COUNT; nPage++)
+  {
+    memcpy(&sRecord, &m_aEEPROMMirror[nPage * SPIFLASH_PAGE_SIZE], sizeof(sRecord));
+
+    if (EEPROM_RecordValid(&sRecord, nPage)
+        && (!bFound || (int32_t) (sRecord.nSequence - m_nEEPROMSequence) > 0))
+    {
+      memset(&m_sEEPROMConfiguration, 0, sizeof(m_sEEPROMConfiguration));
+      m_sEEPROMConfiguration.nVersion             = NVVER_CURRENT;
+      m_sEEPROMConfiguration.nFailsafeRelayEnable = sRecord.nFailsafeRelayEnable;
+      m_sEEPROMConfiguration.nFaultRegisterMap    = sRecord.nFaultRegisterMap;
+      m_sEEPROMConfiguration.nRelayVerifyPeriod   = sRecord.nRelayVerifyPeriod;
+      m_nEEPROMSequence                           = sRecord.nSequence;
+      m_nEEPROMLogHead                            = nPage;
+      bFound                                      = true;
+    }
+  }
+
+  return bFound;
+}
+
+/*
+   Function:  EEPROM_MigrateV0()
+   Description:
+    Checks whether the configuration just read from the flash is
+    an NVVER_V0 configuration, and if so, converts it in place.
+    Returns true if the configuration was migrated.
+ */
+static bool EEPROM_MigrateV0(void)
+{
+  EEPROM_Configuration_V0_T    sV0;
+  bool                         bMigrated = false;
+
+  // The V0 layout is smaller, so it's entirely contained in what was read.
+  memcpy(&sV0, &m_sEEPROMConfiguration, sizeof(sV0));
+
+  if (sV0.nVersion == NVVER_V0 && CRC16((uint8_t*) &sV0, EEPROM_CRC_LEN(EEPROM_Configuration_V0_T)) == sV0.nCRC)
+  {
+    memset(&m_sEEPROMConfiguration, 0, sizeof(m_sEEPROMConfiguration));
+    m_sEEPROMConfiguration.nVersion             = NVVER_CURRENT;
+    m_sEEPROMConfiguration.nFaultRegisterMap    = sV0.nFaultRegisterMap;
+    m_sEEPROMConfiguration.nFailsafeRelayEnable = sV0.nFailsafeRelayEnable;
+    EEPROM_MarkConfigurationAsDirty();
+    bMigrated = true;
+  }
+
+  return bMigrated;
+}
+
+/*
+   Function:  EEPROM_MigrateV1()
+   Description:
+    Checks whether the configuration just read from the flash is
+    an NVVER_V1 configuration, which is already in the in-RAM layout.
+    If so, it only needs writing out to the log.
+    Returns true if the configuration was migrated.
+ */
+static bool EEPROM_MigrateV1(void)
+{
+  bool    bMigrated = false;
+
+  if (m_sEEPROMConfiguration.nVersion == NVVER_V1 && CRC16((uint8_t*) &m_sEEPROMConfiguration, EEPROM_CRC_LEN(EEPROM_Configuration_T)) == m_sEEPROMConfiguration.nCRC)
+  {
+    m_sEEPROMConfiguration.nVersion = NVVER_CURRENT;
+    EEPROM_MarkConfigurationAsDirty();
+    bMigrated = true;
+  }
+
+  return bMigrated;
+}
+
 /*
    Function:  EEPROM_Process()
    Description:
     Handles all of the processing of the EEPROM--
     for example, when data changes and needs to be updated
     in flash.
+
+    The configuration is kept as a log of complete records, one per page,
+    appended round-robin over EEPROM_LOG_PAGE_COUNT pages, which spreads
+    the wear over the whole log. Since each record holds the whole
+    configuration, the newest record is all of the live data, and older
+    records need no compaction; they are simply overwritten as the log
+    wraps around.
+
+    The log lives in the RAM mirror; this function writes the dirty
+    pages of the mirror back out, one page at a time, and verifies each
+    by reading it back and comparing its CRC.
  */
 void EEPROM_Process(void)
 {
@@ -44,35 +403,62 @@ void EEPROM_Process(void)
   {
     case EEPROM_STATE_STARTUP_READ:
 
-      if (!SPIFlash_Read((uint8_t*) &m_sEEPROMConfiguration, 0, 0, sizeof(m_sEEPROMConfiguration)))
+      if (!SPIFlash_Read(&m_sEEPROMRequest, m_aEEPROMMirror, 0, 0, sizeof(m_aEEPROMMirror)))
       {
         // TODO:  SPI Fatal error.
       }
-      m_eEEPROMState = EEPROM_STATE_STARTUP_VERIFY;
+      m_eEEPROMState = EEPROM_STATE_STARTUP_SCAN;
       break;
 
-    case EEPROM_STATE_STARTUP_VERIFY:
+    case EEPROM_STATE_STARTUP_SCAN:
 
-      if (SPIFlash_IsFree())
+      if (!SPIFlash_RequestBusy(&m_sEEPROMRequest) && !m_sEEPROMRequest.bSuccess)
+      {
+        // The read failed. Nothing in the mirror can be trusted, and an
+        // empty looking log mustn't be taken for one; that would write
+        // the defaults over a good configuration. Read it all again.
+        m_nEEPROMConfigurationFaultCntr += 1;
+        m_eEEPROMState                   = EEPROM_STATE_STARTUP_READ;
+      }
+      else if (!SPIFlash_RequestBusy(&m_sEEPROMRequest))
       {
-        // Operation has completed.
-        // Verify that the CRC is correct.
-        uint16_t    nCalculatedCRC = CRC16((uint8_t*) &m_sEEPROMConfiguration, sizeof(m_sEEPROMConfiguration) - sizeof(uint16_t));
+        m_bEEPROMMirrorLoaded = true;
 
-        // Compare the calculated CRC against the actual CRC.
-        if (nCalculatedCRC != m_sEEPROMConfiguration.nCRC)
+        if (!EEPROM_LoadLog())
         {
-          // This is not a good configuration.
-          // Wipe the configuration to zero, and prepare for it to be written out.
-          EEPROM_SetDefaultEEPROMValues();
+          // No log yet. The flash may still hold a configuration
+          // from older firmware, at the start of page 0.
+          // If so, carry its settings over. Otherwise, fall back to the
+          // defaults. Either way, it's written out as the first record.
+          memcpy(&m_sEEPROMConfiguration, m_aEEPROMMirror, sizeof(m_sEEPROMConfiguration));
+
+          if (EEPROM_MigrateV1() || EEPROM_MigrateV0())
+          {
+            // Leave the old configuration where it is until the
+            // first record has made it out.
+            m_bEEPROMLegacyPending = true;
+          }
+          else
+          {
+            EEPROM_SetDefaultEEPROMValues();
+          }
+
+          // The first record (sequence 1) goes on the page
+          // after the old configuration.
+          m_nEEPROMSequence = EEPROM_LEGACY_PAGE - EEPROM_LOG_FIRST_PAGE;
         }
-        m_eEEPROMState = m_bEEPROMConfigurationDirty ? EEPROM_STATE_WRITE : EEPROM_STATE_IDLE;
+        m_eEEPROMState = EEPROM_STATE_IDLE;
       }
       break;
 
     case EEPROM_STATE_IDLE:
 
       if (m_bEEPROMConfigurationDirty)
+      {
+        EEPROM_AppendRecord();
+      }
+
+      if (EEPROM_AnyPageDirty() && Timebase_ElapsedMilliseconds(m_nEEPROMDirtyTimestamp, m_nEEPROMCoalesceWindow))
       {
         m_eEEPROMState = EEPROM_STATE_WRITE;
       }
@@ -80,11 +466,18 @@ void EEPROM_Process(void)
 
     case EEPROM_STATE_WRITE:
 
-      if (SPIFlash_IsFree())
+      if (!SPIFlash_RequestBusy(&m_sEEPROMRequest))
       {
-        m_sEEPROMConfiguration.nCRC = CRC16((uint8_t*) &m_sEEPROMConfiguration, sizeof(m_sEEPROMConfiguration) - sizeof(uint16_t));
+        // Take the lowest dirty page, and a snapshot of it.
+        // Anything that changes it from here on marks it dirty again.
+        for (m_nEEPROMFlushPage = 0; !EEPROM_PageDirty(m_nEEPROMFlushPage); m_nEEPROMFlushPage++)
+        {
+        }
+        memcpy(m_uEEPROMPage.aFlush, &m_aEEPROMMirror[m_nEEPROMFlushPage * SPIFLASH_PAGE_SIZE], SPIFLASH_PAGE_SIZE);
+        m_nEEPROMFlushCRC = CRC16(m_uEEPROMPage.aFlush, SPIFLASH_PAGE_SIZE);
+        EEPROM_ClearPageDirty(m_nEEPROMFlushPage);
 
-        if (!SPIFlash_Write((uint8_t*) &m_sEEPROMConfiguration, 0, 0, sizeof(m_sEEPROMConfiguration)))
+        if (!SPIFlash_Write(&m_sEEPROMRequest, m_uEEPROMPage.aFlush, m_nEEPROMFlushPage, 0, SPIFLASH_PAGE_SIZE))
         {
           // TODO:  SPI Fatal error.
         }
@@ -94,9 +487,9 @@ void EEPROM_Process(void)
 
     case EEPROM_STATE_READ:
 
-      if (SPIFlash_IsFree())
+      if (!SPIFlash_RequestBusy(&m_sEEPROMRequest))
       {
-        if (!SPIFlash_Read((uint8_t*) &m_sEEPROMConfigurationVerify, 0, 0, sizeof(m_sEEPROMConfiguration)))
+        if (!SPIFlash_Read(&m_sEEPROMRequest, m_uEEPROMPage.aVerify, m_nEEPROMFlushPage, 0, SPIFLASH_PAGE_SIZE))
         {
           // TODO:  SPI Fatal error.
         }
@@ -106,30 +499,42 @@ void EEPROM_Process(void)
 
     case EEPROM_STATE_VERIFY:
 
-      if (SPIFlash_IsFree())
+      if (!SPIFlash_RequestBusy(&m_sEEPROMRequest))
       {
-        // Do a memory compare against the expected configuration and the actual
-        // condiguration. If there's a discrepancy, attempt to rewrite
-
-        int    nCompare = memcmp(&m_sEEPROMConfigurationVerify, &m_sEEPROMConfiguration, sizeof(m_sEEPROMConfiguration));
-
-        if (!nCompare)
+        // Compare the CRC of the page as read back against the CRC
+        // of what was written.
+        if (m_sEEPROMRequest.bSuccess && CRC16(m_uEEPROMPage.aVerify, SPIFLASH_PAGE_SIZE) == m_nEEPROMFlushCRC)
         {
-          /// These are equal. No longer dirty.
-          m_bEEPROMConfigurationDirty = false;
-
           // Reset the fault counter, we were able to successfully write.
           m_nEEPROMConfigurationFaultCntr = 0;
-          m_eEEPROMState                  = EEPROM_STATE_IDLE;
+          m_nEEPROMPageFlushCount        += 1;
+
+          // Once a record of the log is committed, the old configuration
+          // is no longer needed; erase it, so it can't be migrated again.
+          if (m_bEEPROMLegacyPending
+              && m_nEEPROMFlushPage != EEPROM_LEGACY_PAGE
+              && m_nEEPROMFlushPage >= EEPROM_LOG_FIRST_PAGE
+              && m_nEEPROMFlushPage < EEPROM_LOG_FIRST_PAGE + EEPROM_LOG_PAGE_COUNT)
+          {
+            uint8_t    aErased[sizeof(EEPROM_Configuration_T)];
+
+            memset(aErased, 0xFF, sizeof(aErased));
+            EEPROM_MirrorWrite(EEPROM_LEGACY_PAGE * SPIFLASH_PAGE_SIZE, aErased, sizeof(aErased));
+            m_bEEPROMLegacyPending = false;
+          }
         }
         else
         {
-          // This didn't work--the configuration wasn't saved properly.
+          // This didn't work--the page wasn't saved properly.
+          // Mark it dirty again, and try again after another window.
           m_nEEPROMConfigurationFaultCntr += 1;
-
-          // Restore to the WRITE state and try again.
-          m_eEEPROMState = EEPROM_STATE_IDLE;
+          m_nEEPROMVerifyFailureCount     += 1;
+          EEPROM_SetPageDirty(m_nEEPROMFlushPage);
+          m_nEEPROMDirtyTimestamp = uwTick;
         }
+
+        // Carry on with the rest of the dirty pages, if any.
+        m_eEEPROMState = EEPROM_AnyPageDirty() && Timebase_ElapsedMilliseconds(m_nEEPROMDirtyTimestamp, m_nEEPROMCoalesceWindow) ? EEPROM_STATE_WRITE : EEPROM_STATE_IDLE;
       }
       break;
 
@@ -139,6 +544,60 @@ void EEPROM_Process(void)
   }
 }
 
+/*
+   Function:  EEPROM_SetCoalesceWindow()
+              EEPROM_GetCoalesceWindow()
+   Description:
+    Sets or returns how long, in milliseconds, changes are collected
+    in the mirror before the dirty pages are written out.
+    Returns false if the window is out of range.
+ */
+bool EEPROM_SetCoalesceWindow(uint16_t nWindow)
+{
+  bool    bReturn = false;
+
+  if (nWindow <= EEPROM_COALESCE_WINDOW_MS_MAX)
+  {
+    m_nEEPROMCoalesceWindow = nWindow;
+    bReturn                 = true;
+  }
+
+  return bReturn;
+}
+uint16_t EEPROM_GetCoalesceWindow(void)
+{
+  return (uint16_t) m_nEEPROMCoalesceWindow;
+}
+
+/*
+   Function:  EEPROM_GetPageWriteCount()
+              EEPROM_GetPageFlushCount()
+              EEPROM_GetCoalescingRatio()
+              EEPROM_GetVerifyFailureCount()
+   Description:
+    Returns the number of page changes made in the mirror, the number of
+    pages written out to the serial flash, the ratio of the two (x100),
+    and the number of pages that failed verification, since power up.
+ */
+uint16_t EEPROM_GetPageWriteCount(void)
+{
+  return (uint16_t) m_nEEPROMPageWriteCount;
+}
+uint16_t EEPROM_GetPageFlushCount(void)
+{
+  return (uint16_t) m_nEEPROMPageFlushCount;
+}
+uint16_t EEPROM_GetCoalescingRatio(void)
+{
+  uint32_t    nRatio = m_nEEPROMPageFlushCount ? (uint32_t) (((uint64_t) m_nEEPROMPageWriteCount * 100) / m_nEEPROMPageFlushCount) : 0;
+
+  return (nRatio > UINT16_MAX) ? UINT16_MAX : (uint16_t) nRatio;
+}
+uint16_t EEPROM_GetVerifyFailureCount(void)
+{
+  return (uint16_t) m_nEEPROMVerifyFailureCount;
+}
+
 /*
    Function:  EEPROM_MarkConfigurationAsDirty()
    Description:
@@ -165,9 +624,20 @@ bool EEPROM_Ready(void)
     Returns the present fault map, as we believe
     it is stored in the EEPROM.
  */
-uint16_t EEPROM_GetFaultRegisterMap(void)
+uint64_t EEPROM_GetFaultRegisterMap(void)
 {
-  return EEPROM_Ready() ? m_sEEPROMConfiguration.nFaultRegisterMap : 0;
+  uint64_t    nFaultRegisterMap = 0;
+
+  if (EEPROM_Ready())
+  {
+    // It can't be read in one go, and may be changed by the Modbus interrupt.
+    uint32_t    nPRIMASK = __get_PRIMASK();
+    __set_PRIMASK(1);
+    nFaultRegisterMap = m_sEEPROMConfiguration.nFaultRegisterMap;
+    __set_PRIMASK(nPRIMASK);
+  }
+
+  return nFaultRegisterMap;
 }
 
 /*
@@ -175,7 +645,7 @@ uint16_t EEPROM_GetFaultRegisterMap(void)
    Description:
     Sets the fault map, and the dirty bit.
  */
-void EEPROM_SetFaultRegisterMap(uint16_t nFaultRegisterMap)
+void EEPROM_SetFaultRegisterMap(uint64_t nFaultRegisterMap)
 {
   if (EEPROM_Ready())
   {
@@ -209,10 +679,49 @@ void EEPROM_SetFailsafeRelayEnable(uint16_t nFailsafeRelayEnable)
   }
 }
 
+/*
+   Function:  EEPROM_GetRelayVerifyPeriod()
+   Description:
+    Returns the present relay verify period, as we believe
+    it is stored in the EEPROM.
+ */
+uint16_t EEPROM_GetRelayVerifyPeriod(void)
+{
+  return EEPROM_Ready() ? m_sEEPROMConfiguration.nRelayVerifyPeriod : 0;
+}
+
+/*
+   Function:  EEPROM_SetRelayVerifyPeriod()
+   Description:
+    Sets the relay verify period, and the dirty bit.
+ */
+void EEPROM_SetRelayVerifyPeriod(uint16_t nRelayVerifyPeriod)
+{
+  if (EEPROM_Ready())
+  {
+    m_sEEPROMConfiguration.nRelayVerifyPeriod = nRelayVerifyPeriod;
+    EEPROM_MarkConfigurationAsDirty();
+  }
+}
+
+/*
+   Function:  EEPROM_SetDefaultEEPROMValues()
+   Description:
+    Restores the default configuration, and sets the dirty bit.
+    Unlike the setters, this also works during startup, before the
+    EEPROM is ready, since that's where a bad configuration is found.
+ */
 void EEPROM_SetDefaultEEPROMValues(void)
 {
-  EEPROM_SetFailsafeRelayEnable(EEPROM_DEFAULT_FAILSAFE_RELAY_ENABLE);
-  EEPROM_SetFaultRegisterMap(EEPROM_DEFAULT_FAULT_REGISTER_MAP);
+  uint32_t    nPRIMASK = __get_PRIMASK();
+  __set_PRIMASK(1);
+  memset(&m_sEEPROMConfiguration, 0, sizeof(m_sEEPROMConfiguration));
+  m_sEEPROMConfiguration.nVersion             = NVVER_CURRENT;
+  m_sEEPROMConfiguration.nFailsafeRelayEnable = EEPROM_DEFAULT_FAILSAFE_RELAY_ENABLE;
+  m_sEEPROMConfiguration.nFaultRegisterMap    = EEPROM_DEFAULT_FAULT_REGISTER_MAP;
+  m_sEEPROMConfiguration.nRelayVerifyPeriod   = RELAY_VERIFY_PERIOD_MS_DEFAULT;
+  EEPROM_MarkConfigurationAsDirty();
+  __set_PRIMASK(nPRIMASK);
 }
 
 /*************************** END OF FILE **************************************/
@@ -0,0 +1,162 @@
+/*
+ * EventQueue.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *  	Queue of change events (relays, fault bits, ADC thresholds) for the
+ *  	Modbus master, read with FC 0x18 (Read FIFO Queue). This lets the
+ *  	master see every transition, in order, without having to scan all
+ *  	of the registers fast enough to catch them.
+ *
+ *  	Reading doesn't remove anything, so a response lost on the bus loses
+ *  	no events. The master acknowledges what it has read by writing the
+ *  	sequence number of the first event it has yet to see to the Event
+ *  	Queue Acknowledge register; reading that register returns the
+ *  	sequence number of the oldest event still queued.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "ByteFIFO.h"
+#include "EventQueue.h"
+
+//	One more than the number of events, since the FIFO always keeps an entry free.
+//	Events are posted from interrupt context as well as the main loop,
+//	so the FIFO is only touched with interrupts disabled.
+DEFINE_STATIC_FIFO(m_sEventQueueFIFO, uint16_t, EVENTQUEUE_SIZE + 1);
+
+//	Set when an event has been lost, so that the next event to make it
+//	into the queue is preceded by an overflow marker.
+static bool m_bEventQueueOverflowed = false;
+static uint16_t m_nEventQueueOverflowCount = 0;
+
+//	Sequence number of the oldest event in the queue. Every event
+//	acknowledged moves it on by one, wrapping at 16 bits.
+static uint16_t m_nEventQueueSequence = 0;
+
+/*
+	Function:	EventQueue_Post()
+	Description:
+		Adds an event to the queue. Safe to call from interrupt context.
+		If the queue is full, the event is dropped, and an overflow
+		marker is queued in its place once there's room.
+*/
+void EventQueue_Post(EventQueue_Type_T eType, uint8_t nDetail, uint8_t nIndex)
+{
+	uint16_t nEvent = EVENTQUEUE_EVENT(eType, nDetail, nIndex);
+	uint16_t nOverflow = EVENTQUEUE_EVENT(EVENTQUEUE_TYPE_OVERFLOW, 0, 0);
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	if (m_bEventQueueOverflowed && FIFO_GetFree(&m_sEventQueueFIFO) >= 2)
+	{
+		FIFO_Enqueue(&m_sEventQueueFIFO, &nOverflow);
+		m_bEventQueueOverflowed = false;
+	}
+
+	if (m_bEventQueueOverflowed || !FIFO_Enqueue(&m_sEventQueueFIFO, &nEvent))
+	{
+		m_bEventQueueOverflowed = true;
+
+		if (m_nEventQueueOverflowCount < UINT16_MAX)
+		{
+			m_nEventQueueOverflowCount++;
+		}
+	}
+
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	EventQueue_Read()
+	Description:
+		Copies up to nMax of the oldest events from the queue into pEvents,
+		leaving them queued until they're acknowledged.
+		Returns the number of events copied.
+*/
+uint16_t EventQueue_Read(uint16_t * pEvents, uint16_t nMax)
+{
+	uint16_t nCount = 0;
+	uint16_t * pEvent = NULL;
+	uint32_t nIterator;
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	FIFO_GetIterator(&m_sEventQueueFIFO, &nIterator);
+
+	while (nCount < nMax && (pEvent = FIFO_Iterate(&m_sEventQueueFIFO, &nIterator)) != NULL)
+	{
+		pEvents[nCount++] = *pEvent;
+	}
+
+	__set_PRIMASK(nPRIMASK);
+
+	return nCount;
+}
+
+/*
+	Function:	EventQueue_Acknowledge()
+	Description:
+		Drops every event before the sequence number nSequence, which is
+		the sequence number of the first event the master has yet to see.
+		Writing the same value again has no further effect, so a write
+		that's retried is harmless. Returns an exception if nSequence is
+		past the newest event in the queue.
+*/
+ModbusException_T EventQueue_Acknowledge(uint16_t nSequence)
+{
+	ModbusException_T eException = MODBUS_EXCEPTION_OK;
+	uint16_t nEvent;
+	uint16_t nCount = nSequence - m_nEventQueueSequence;
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	if (nCount > FIFO_GetQueued(&m_sEventQueueFIFO))
+	{
+		eException = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+	else
+	{
+		while (nCount-- > 0 && FIFO_Dequeue(&m_sEventQueueFIFO, &nEvent))
+		{
+			m_nEventQueueSequence++;
+		}
+	}
+
+	__set_PRIMASK(nPRIMASK);
+
+	return eException;
+}
+
+/*
+	Function:	EventQueue_GetSequence()
+	Description:
+		Returns the sequence number of the oldest event in the queue,
+		or of the next event to be posted if the queue is empty.
+*/
+uint16_t EventQueue_GetSequence(void)
+{
+	return m_nEventQueueSequence;
+}
+
+/*
+	Function:	EventQueue_GetCount()
+				EventQueue_GetOverflowCount()
+	Description:
+		Returns the number of events waiting to be read, and the
+		number of events lost because the queue was full, since power up.
+*/
+uint16_t EventQueue_GetCount(void)
+{
+	return (uint16_t) FIFO_GetQueued(&m_sEventQueueFIFO);
+}
+uint16_t EventQueue_GetOverflowCount(void)
+{
+	return m_nEventQueueOverflowCount;
+}
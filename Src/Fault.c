@@ -14,8 +14,14 @@
 #include "Main.h"
 #include "Fault.h"
 #include "stm32l4xx_hal.h"
+#include "Relay.h"
+#include "Journal.h"
+#include "EventQueue.h"
+#include "Diagnostics.h"
+#include "Timebase.h"
 
-static uint16_t m_nFault = 0;
+//	Faults may be raised from interrupt context as well as the main loop.
+static volatile uint16_t m_nFault = 0;
 
 /*
 	Function:	Fault_Set
@@ -38,10 +44,26 @@ void Fault_Set(Fault_T eFault, bool bActive)
 	Function:	Fault_Activate
 	Description:
 		Activates a fault as specified.
+		If this is a new fault, the relay module is told right away
+		so that the fault relays are driven without waiting for the
+		main loop to come around.
 */
 void Fault_Activate(Fault_T eFault)
 {
+	uint32_t nPRIMASK = __get_PRIMASK();
+	uint16_t nPrevious;
+
+	__set_PRIMASK(1);
+	nPrevious = m_nFault;
 	m_nFault |= (1 << eFault);
+	__set_PRIMASK(nPRIMASK);
+
+	if (!(nPrevious & (1 << eFault)))
+	{
+		Relay_FaultEvent();
+		Journal_Log(JOURNAL_EVENT_FAULT_SET, eFault, nPrevious | (1 << eFault));
+		EventQueue_Post(EVENTQUEUE_TYPE_FAULT, 1, eFault);
+	}
 }
 /*
 	Function:	Fault_Clear
@@ -50,7 +72,19 @@ void Fault_Activate(Fault_T eFault)
 */
 void Fault_Clear(Fault_T eFault)
 {
+	uint32_t nPRIMASK = __get_PRIMASK();
+	uint16_t nPrevious;
+
+	__set_PRIMASK(1);
+	nPrevious = m_nFault;
 	m_nFault &= ~(1 << eFault);
+	__set_PRIMASK(nPRIMASK);
+
+	if (nPrevious & (1 << eFault))
+	{
+		Journal_Log(JOURNAL_EVENT_FAULT_CLEAR, eFault, nPrevious & ~(1 << eFault));
+		EventQueue_Post(EVENTQUEUE_TYPE_FAULT, 0, eFault);
+	}
 }
 
 bool Fault_Get(Fault_T eFault)
@@ -89,56 +123,73 @@ static FaultCRCState_T m_eFaultCRCState = FAULTCRCSTATE_IDLE;
 static bool m_bFaultCRCStartupPass = false;
 static uint32_t m_nLastSuccessfulCRCPassTimestamp = 0;
 
-//	Indicates which section of the flash we're currently reading.
-
-static uint16_t m_nFaultCRCSection = 0;
 static uint32_t m_nCalculatedCRC = 0;
 static uint32_t m_nStoredCRC = 0;
 
+//	Time spent inside Fault_CRC_Process(), in cycles.
+//	This is how long the integrity check holds up the main loop per pass.
+//	The average is scaled up by DIAGNOSTICS_LOOP_AVERAGE_SHIFT, as the loop time is.
+static uint32_t m_nFaultCRCStallMax = 0;
+static uint32_t m_nFaultCRCStallAverageScaled = 0;
+
+/*
+	Function:	Fault_CRC_Start()
+	Description:
+		Resets the CRC unit and starts the DMA feeding it the image.
+		The DMA copies every word of the flash except the last, which holds the
+		stored CRC, into the CRC data register, so the result is the same as
+		HAL_CRC_Calculate() over that range would give (and so matches the
+		CRC placed there by srec_cat -STM32).
+*/
+static bool Fault_CRC_Start(void)
+{
+	__HAL_CRC_DR_RESET(Main_Get_CRC_Handle());
+
+	return HAL_DMA_Start(Main_Get_CRC_DMA_Handle(),
+			FAULT_CRC_FLASH_ADDRESS,
+			(uint32_t) &(Main_Get_CRC_Handle()->Instance->DR),
+			FAULT_CRC_FLASH_SIZE_WORD - 1) == HAL_OK;
+}
 
 /*
 	Function:	Fault_CRC_Process
 	Description:
 		Calculates the CRC of the system code, and verifies that it is correct.
+		The calculation itself runs in the background on the DMA; this only
+		starts it and checks in on it, so it never stalls the main loop for
+		more than a few microseconds.
 */
 void Fault_CRC_Process(void)
 {
-	uint32_t (*pCRCFunc)(CRC_HandleTypeDef * hcrc, uint32_t pBuffer[], uint32_t BufferLength) = NULL;
-	uint32_t nAddress;
-	uint32_t nChunkSizeWord;
+	uint32_t nStart = DIAGNOSTICS_CYCLES();
+	uint32_t nStall;
+	DMA_HandleTypeDef * hdma = Main_Get_CRC_DMA_Handle();
 
 	switch(m_eFaultCRCState)
 	{
 		case FAULTCRCSTATE_CALCULATE:
-			//	Iteratively run through the CRC calculation.
-			//	Note that this typically is done in increments of, we'll say, 1/16th
-			//	of the flash at a time.
-			pCRCFunc = (m_nFaultCRCSection == 0) ?
-					HAL_CRC_Calculate : HAL_CRC_Accumulate;
-
-			//	Recall that this is an integer.
-			//	It'll explicitly be cast to an address when the time is right.
-			nAddress = 0x08000000 + (m_nFaultCRCSection * (FAULT_CRC_FLASH_SIZE_BYTES / FAULT_CRC_DIVISOR));
-
-			//	Calculate the chunk size, in words.
-			//	If it's the last chunk size, remove a word for the CRC.
-			nChunkSizeWord = (FAULT_CRC_FLASH_SIZE_WORD / FAULT_CRC_DIVISOR);
-			nChunkSizeWord -= (m_nFaultCRCSection == (FAULT_CRC_DIVISOR-1)) ? 1 : 0;
-
-			m_nCalculatedCRC = pCRCFunc(Main_Get_CRC_Handle(), (uint32_t *) nAddress, nChunkSizeWord);
-
-			//	Determine the next phase.
-			m_nFaultCRCSection += 1;
-
-			//	If this was the last step of the process, go ahead and transition to
-			//	the next phase.
-			m_eFaultCRCState = (m_nFaultCRCSection == FAULT_CRC_DIVISOR) ?
-					FAULTCRCSTATE_PROCESS : m_eFaultCRCState;
+			//	Wait for the DMA to finish the transfer.
+			//	A transfer error leaves the DMA idle, so it is simply started again.
+			if (__HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_TE_FLAG_INDEX(hdma)))
+			{
+				HAL_DMA_Abort(hdma);
+				__HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_GI_FLAG_INDEX(hdma));
+				Fault_CRC_Start();
+			}
+			else if (__HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma)))
+			{
+				//	Already complete, so this returns straight away and puts
+				//	the handle back in the ready state.
+				HAL_DMA_PollForTransfer(hdma, HAL_DMA_FULL_TRANSFER, 0);
+
+				m_nCalculatedCRC = Main_Get_CRC_Handle()->Instance->DR;
+				m_eFaultCRCState = FAULTCRCSTATE_PROCESS;
+			}
 			break;
 		case FAULTCRCSTATE_PROCESS:
 			//	Compare the calculated CRC with the actual CRC.
 			//	If they match, we've passed the test.
-			m_nStoredCRC = *(uint32_t*)0x0801FFFC;
+			m_nStoredCRC = *(uint32_t*)FAULT_CRC_STORED_ADDRESS;
 
 			//	Does the CRC match what it should be?
 			if (m_nStoredCRC == m_nCalculatedCRC)
@@ -160,14 +211,43 @@ void Fault_CRC_Process(void)
 			}
 			break;
 		case FAULTCRCSTATE_IDLE:
-			if (((uwTick - m_nLastSuccessfulCRCPassTimestamp) > 60000) || !m_bFaultCRCStartupPass)
+			if (Timebase_ElapsedMilliseconds(m_nLastSuccessfulCRCPassTimestamp, FAULT_CRC_CALCULATE_RATE_MS) || !m_bFaultCRCStartupPass)
 			{
 				//	Run a calculation.
-				m_eFaultCRCState = FAULTCRCSTATE_CALCULATE;
-				m_nFaultCRCSection = 0;
+				if (Fault_CRC_Start())
+				{
+					m_eFaultCRCState = FAULTCRCSTATE_CALCULATE;
+				}
 			}
 			break;
 	}
+
+	nStall = DIAGNOSTICS_CYCLES() - nStart;
+
+	if (nStall > m_nFaultCRCStallMax)
+	{
+		m_nFaultCRCStallMax = nStall;
+	}
+	m_nFaultCRCStallAverageScaled -= (m_nFaultCRCStallAverageScaled >> DIAGNOSTICS_LOOP_AVERAGE_SHIFT);
+	m_nFaultCRCStallAverageScaled += nStall;
+}
+
+/*
+	Function:	Fault_CRC_GetStallMax()
+				Fault_CRC_GetStallAverage()
+	Description:
+		Returns the longest and the average time the main loop has spent
+		in Fault_CRC_Process(), in microseconds.
+*/
+uint16_t Fault_CRC_GetStallMax(void)
+{
+	uint32_t nValue = Diagnostics_CyclesToMicroseconds(m_nFaultCRCStallMax);
+	return (nValue > UINT16_MAX) ? UINT16_MAX : (uint16_t) nValue;
+}
+uint16_t Fault_CRC_GetStallAverage(void)
+{
+	uint32_t nValue = Diagnostics_CyclesToMicroseconds(m_nFaultCRCStallAverageScaled >> DIAGNOSTICS_LOOP_AVERAGE_SHIFT);
+	return (nValue > UINT16_MAX) ? UINT16_MAX : (uint16_t) nValue;
 }
 
 /*
@@ -0,0 +1,269 @@
+/*
+ * Journal.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *  	Event journal for the Heceta Relay Module.
+ *  	Keeps a ring of fixed-size, timestamped entries in the serial flash
+ *  	(faults raised and cleared, relay changes, resets, configuration
+ *  	writes), so that transient events can be read back after the fact
+ *  	with Modbus FC 0x14 (Read File Record).
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "main.h"
+#include "Journal.h"
+#include "EEPROM.h"
+#include "SPIFlash.h"
+#include "CRC.h"
+
+/*
+	Structure:	Journal_Entry_T
+	Description:
+		A single entry, as stored in the serial flash.
+		The boot number is one more than that of the newest entry
+		found at startup, so that uptimes from different boots can
+		be told apart.
+*/
+typedef struct
+{
+	uint32_t nSequence;
+	uint32_t nUptime;
+	uint16_t nBoot;
+	uint8_t eEvent;
+	uint8_t nCode;
+	uint16_t nData;
+	uint16_t nCRC;
+}	Journal_Entry_T;
+
+_Static_assert(sizeof(Journal_Entry_T) == JOURNAL_ENTRY_SIZE, "Journal_Entry_T must be JOURNAL_ENTRY_SIZE bytes");
+_Static_assert(SPIFLASH_PAGE_SIZE % JOURNAL_ENTRY_SIZE == 0, "Journal entries must not straddle pages");
+
+//	Events waiting to be written.
+//	Journal_Log() may be called from interrupt context, so the queue is
+//	only touched with interrupts disabled.
+static Journal_Entry_T m_aJournalQueue[JOURNAL_QUEUE_SIZE];
+static uint8_t m_nJournalQueueHead = 0;
+static uint8_t m_nJournalQueueCount = 0;
+static uint16_t m_nJournalDropped = 0;
+
+//	Position of the journal.
+//	m_nJournalHead is the slot the next entry goes in, and m_nJournalCount
+//	the number of valid entries behind it.
+static bool m_bJournalLoaded = false;
+static uint16_t m_nJournalHead = 0;
+static uint16_t m_nJournalCount = 0;
+static uint32_t m_nJournalSequence = 0;
+static uint16_t m_nJournalBoot = 0;
+
+#define JOURNAL_SLOT_ADDRESS(nSlot)	((JOURNAL_FIRST_PAGE * SPIFLASH_PAGE_SIZE) + ((nSlot) * JOURNAL_ENTRY_SIZE))
+
+/*
+	Function:	Journal_Init()
+	Description:
+		Records the reset that got us here.
+		Must be called once at startup, before anything else is logged.
+*/
+void Journal_Init(void)
+{
+	uint16_t nResetFlags = (uint16_t) (RCC->CSR >> 24);
+
+	//	Clear the flags, so that the next reset is reported on its own.
+	__HAL_RCC_CLEAR_RESET_FLAGS();
+
+	Journal_Log(JOURNAL_EVENT_RESET, 0, nResetFlags);
+}
+
+/*
+	Function:	Journal_Log()
+	Description:
+		Queues an event for the journal, timestamped with the present uptime.
+		Safe to call from interrupt context. If the queue is full, the
+		event is dropped and counted.
+*/
+void Journal_Log(JournalEvent_T eEvent, uint8_t nCode, uint16_t nData)
+{
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	if (m_nJournalQueueCount < JOURNAL_QUEUE_SIZE)
+	{
+		Journal_Entry_T * pEntry = &m_aJournalQueue[(m_nJournalQueueHead + m_nJournalQueueCount) % JOURNAL_QUEUE_SIZE];
+
+		pEntry->nUptime = uwTick;
+		pEntry->eEvent = (uint8_t) eEvent;
+		pEntry->nCode = nCode;
+		pEntry->nData = nData;
+		m_nJournalQueueCount++;
+	}
+	else if (m_nJournalDropped < UINT16_MAX)
+	{
+		m_nJournalDropped++;
+	}
+
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	Journal_EntryValid()
+	Description:
+		Returns true if the entry holds an intact event.
+*/
+static bool Journal_EntryValid(const Journal_Entry_T * pEntry)
+{
+	return pEntry->eEvent != JOURNAL_EVENT_NONE
+			&& CRC16((uint8_t *) pEntry, offsetof(Journal_Entry_T, nCRC)) == pEntry->nCRC;
+}
+
+/*
+	Function:	Journal_Load()
+	Description:
+		Finds the newest entry in the journal, so that new entries
+		carry on from there.
+*/
+static void Journal_Load(void)
+{
+	Journal_Entry_T sEntry;
+	bool bFound = false;
+
+	for (uint16_t nSlot = 0; nSlot < JOURNAL_ENTRY_COUNT; nSlot++)
+	{
+		EEPROM_MirrorRead(JOURNAL_SLOT_ADDRESS(nSlot), &sEntry, sizeof(sEntry));
+
+		if (Journal_EntryValid(&sEntry))
+		{
+			m_nJournalCount++;
+
+			if (!bFound || (int32_t) (sEntry.nSequence - m_nJournalSequence) > 0)
+			{
+				m_nJournalSequence = sEntry.nSequence;
+				m_nJournalBoot = sEntry.nBoot;
+				m_nJournalHead = nSlot;
+				bFound = true;
+			}
+		}
+	}
+
+	if (bFound)
+	{
+		m_nJournalSequence += 1;
+		m_nJournalBoot += 1;
+		m_nJournalHead = (m_nJournalHead + 1) % JOURNAL_ENTRY_COUNT;
+	}
+}
+
+/*
+	Function:	Journal_Process()
+	Description:
+		Once the serial flash has been read in, moves queued events into
+		the journal. They are written into the RAM mirror, which batches
+		them up into page writes.
+*/
+void Journal_Process(void)
+{
+	Journal_Entry_T sEntry;
+	bool bPending = true;
+
+	if (!m_bJournalLoaded)
+	{
+		if (!EEPROM_Ready())
+		{
+			return;
+		}
+		Journal_Load();
+		m_bJournalLoaded = true;
+	}
+
+	while (bPending)
+	{
+		uint32_t nPRIMASK = __get_PRIMASK();
+
+		__set_PRIMASK(1);
+		bPending = (m_nJournalQueueCount > 0);
+
+		if (bPending)
+		{
+			sEntry = m_aJournalQueue[m_nJournalQueueHead];
+			m_nJournalQueueHead = (m_nJournalQueueHead + 1) % JOURNAL_QUEUE_SIZE;
+			m_nJournalQueueCount--;
+		}
+		__set_PRIMASK(nPRIMASK);
+
+		if (bPending)
+		{
+			sEntry.nSequence = m_nJournalSequence++;
+			sEntry.nBoot = m_nJournalBoot;
+			sEntry.nCRC = CRC16((uint8_t *) &sEntry, offsetof(Journal_Entry_T, nCRC));
+
+			//	The journal is read from the Modbus interrupt, which must see
+			//	the entry and the head move together.
+			__set_PRIMASK(1);
+			EEPROM_MirrorWrite(JOURNAL_SLOT_ADDRESS(m_nJournalHead), &sEntry, sizeof(sEntry));
+			m_nJournalHead = (m_nJournalHead + 1) % JOURNAL_ENTRY_COUNT;
+
+			if (m_nJournalCount < JOURNAL_ENTRY_COUNT)
+			{
+				m_nJournalCount++;
+			}
+			__set_PRIMASK(nPRIMASK);
+		}
+	}
+}
+
+/*
+	Function:	Journal_ReadFileRecord()
+	Description:
+		Reads a single record (register) of the journal file,
+		as laid out in Journal.h.
+*/
+ModbusException_T Journal_ReadFileRecord(uint16_t nRecord, uint16_t * pValue)
+{
+	ModbusException_T eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+	uint16_t nIndex = nRecord / JOURNAL_ENTRY_REGISTERS;
+	Journal_Entry_T sEntry;
+
+	if (m_bJournalLoaded && nIndex < m_nJournalCount)
+	{
+		//	Index 0 is the oldest entry.
+		uint16_t nSlot = (m_nJournalHead + JOURNAL_ENTRY_COUNT - m_nJournalCount + nIndex) % JOURNAL_ENTRY_COUNT;
+
+		EEPROM_MirrorRead(JOURNAL_SLOT_ADDRESS(nSlot), &sEntry, sizeof(sEntry));
+
+		switch (nRecord % JOURNAL_ENTRY_REGISTERS)
+		{
+			case 0:	*pValue = (uint16_t) (sEntry.nSequence >> 16);				break;
+			case 1:	*pValue = (uint16_t) (sEntry.nSequence);					break;
+			case 2:	*pValue = sEntry.nBoot;										break;
+			case 3:	*pValue = (uint16_t) (sEntry.nUptime >> 16);				break;
+			case 4:	*pValue = (uint16_t) (sEntry.nUptime);						break;
+			case 5:	*pValue = (uint16_t) ((sEntry.eEvent << 8) | sEntry.nCode);	break;
+			case 6:	*pValue = sEntry.nData;										break;
+			default:	*pValue = sEntry.nCRC;									break;
+		}
+		eReturn = MODBUS_EXCEPTION_OK;
+	}
+
+	return eReturn;
+}
+
+/*
+	Function:	Journal_GetEntryCount()
+				Journal_GetDroppedCount()
+	Description:
+		Returns the number of entries in the journal, and the number
+		of events lost because the queue was full, since power up.
+*/
+uint16_t Journal_GetEntryCount(void)
+{
+	return m_nJournalCount;
+}
+uint16_t Journal_GetDroppedCount(void)
+{
+	return m_nJournalDropped;
+}
@@ -20,6 +20,7 @@
 #include "Command.h"
 #include "Configuration.h"
 #include "Fault.h"
+#include "Timebase.h"
 
 
 #define LED_COMM_MZ_TIMEOUT	5000
@@ -80,7 +81,7 @@ void LED_Process(void)
 		//	Amber LED
 		//	Toggles every LED_TICK_INCREMENT milliseconds to indicate
 		//	that the system code is still running.
-		if (uwTick - nAmberHeartbeatTimestamp > LED_TICK_INCREMENT)
+		if (Timebase_ElapsedMilliseconds(nAmberHeartbeatTimestamp, LED_TICK_INCREMENT))
 		{
 			nAmberHeartbeatTimestamp = uwTick;
 			HAL_GPIO_TogglePin(LED_AMBER_GPIO_Port, LED_AMBER_Pin);
@@ -89,11 +90,11 @@ void LED_Process(void)
 		//	Green LED
 		//	If communication has happened within the last second, flashes
 		//	at a toggle rate of LED_COMM_FLASH.
-		if (uwTick - m_nCommunicationTimestamp < LED_COMM_TIME)
+		if (!Timebase_ElapsedMilliseconds(m_nCommunicationTimestamp, LED_COMM_TIME))
 		{
 			//	There has been communication in the last 1000 milliseconds.
 			//	Flash the LED at a constant rate.
-			if (uwTick - nGreenToggleTimestamp > LED_COMM_FLASH)
+			if (Timebase_ElapsedMilliseconds(nGreenToggleTimestamp, LED_COMM_FLASH))
 			{
 				nGreenToggleTimestamp = uwTick;
 				HAL_GPIO_TogglePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin);
@@ -104,7 +105,7 @@ void LED_Process(void)
 			//	No communication.
 			//	If there's a pending toggle of the LED to the "ON" state, let that complete
 			//  so that we're naturally left "ON".
-			if (uwTick - nGreenToggleTimestamp > LED_COMM_FLASH)
+			if (Timebase_ElapsedMilliseconds(nGreenToggleTimestamp, LED_COMM_FLASH))
 			{
 				HAL_GPIO_WritePin(LED_GREEN_GPIO_Port, LED_GREEN_Pin, GPIO_PIN_SET);
 			}
@@ -149,7 +150,7 @@ void LED_Startup_Process(void)
 		case LED_STARTUP_TEST_COMPLETE:
 		case LED_STARTUP_TEST_GREEN:
 			bGreen = GPIO_PIN_SET;
-			if ((uwTick - nTimer) > LED_STARTUP_TEST_GAPTIME)
+			if (Timebase_ElapsedMilliseconds(nTimer, LED_STARTUP_TEST_GAPTIME))
 			{
 				nTimer = uwTick;
 				m_eStartupTestState = LED_STARTUP_TEST_AMBER;
@@ -157,7 +158,7 @@ void LED_Startup_Process(void)
 			break;
 		case LED_STARTUP_TEST_AMBER:
 			bAmber = GPIO_PIN_SET;
-			if ((uwTick - nTimer) > LED_STARTUP_TEST_GAPTIME)
+			if (Timebase_ElapsedMilliseconds(nTimer, LED_STARTUP_TEST_GAPTIME))
 			{
 				nTimer = uwTick;
 				m_eStartupTestState = LED_STARTUP_TEST_RED;
@@ -165,7 +166,7 @@ void LED_Startup_Process(void)
 			break;
 		case LED_STARTUP_TEST_RED:
 			bRed = GPIO_PIN_SET;
-			if ((uwTick - nTimer) > LED_STARTUP_TEST_GAPTIME)
+			if (Timebase_ElapsedMilliseconds(nTimer, LED_STARTUP_TEST_GAPTIME))
 			{
 				nTimer = uwTick;
 				m_eStartupTestState = LED_STARTUP_TEST_COMPLETE;
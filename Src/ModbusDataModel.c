@@ -29,6 +29,15 @@
 #include "Relay.h"
 #include "ADC.h"
 #include "Fault.h"
+#include "Diagnostics.h"
+#include "EEPROM.h"
+#include "Journal.h"
+#include "EventQueue.h"
+#include "ADCHistory.h"
+#include "RAMIntegrity.h"
+#include "ADCCapture.h"
+#include "Scheduler.h"
+#include "Clock.h"
 
 /*
 	Function:	ModbusDataModel_ReturnResetState()
@@ -68,6 +77,11 @@ bool ModbusDataModel_ReadCoil(uint16_t nAddress, bool * bReturn)
 	void * pWriteFunction = NULL;
 	(void) pWriteFunction;
 
+	bool (*pRangeReadFunction)(uint16_t nOffset) = NULL;
+	void * pRangeWriteFunction = NULL;
+	uint16_t nRangeOffset = 0;
+	(void) pRangeWriteFunction;
+
 	bool bSuccess = false;
 
 	//	Using the header file, determine where we can read the coil
@@ -76,17 +90,18 @@ bool ModbusDataModel_ReadCoil(uint16_t nAddress, bool * bReturn)
 	{
 		FOREACH_COIL(COIL);
 		default:
+			FOREACH_COIL_RANGE(COIL_RANGE);
 			break;
 	}
 
 	//	Determine if there's a valid response for this particular address.
-	if (pReadFunction != NULL)
+	if (pReadFunction != NULL || pRangeReadFunction != NULL)
 	{
 		//	There is.
 		//	Figure out what the appropriate response is.
 		if (bReturn != NULL)
 		{
-			(*bReturn) = pReadFunction();
+			(*bReturn) = (pReadFunction != NULL) ? pReadFunction() : pRangeReadFunction(nRangeOffset);
 		}
 
 		//	Set the success variable to true.
@@ -103,6 +118,64 @@ bool ModbusDataModel_ReadCoil(uint16_t nAddress, bool * bReturn)
 	return bSuccess;
 }
 
+/*
+	Function:	ModbusDataModel_WriteCoil()
+	Description:
+		Attempts to write a specific coil, as defined by the
+		ModbusDataModel.h file. If the specific coil does not exist,
+		this function will return an exception.
+
+		If the bool * bValue pointer is NULL, this function will simply
+		check to ensure that the coil exists and is writeable, returning
+		MODBUS_EXCEPTION_OK if that is the case, and MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS
+		if not.
+*/
+ModbusException_T ModbusDataModel_WriteCoil(uint16_t nAddress, bool * bValue)
+{
+	//	The ModbusException_T to return.
+	ModbusException_T eReturn = MODBUS_EXCEPTION_OK;
+
+	//	Holding values, to store the read/write functions.
+	//	These define the format of the functions.
+	void * pReadFunction = NULL;
+	ModbusException_T (*pWriteFunction)(bool bValue) = NULL;
+	(void) pReadFunction;
+
+	void * pRangeReadFunction = NULL;
+	ModbusException_T (*pRangeWriteFunction)(uint16_t nOffset, bool bValue) = NULL;
+	uint16_t nRangeOffset = 0;
+	(void) pRangeReadFunction;
+
+	//	Using the header file, determine where we can write the coil
+	//	requested. If it's not defined, the function will remain NULL.
+	switch(nAddress)
+	{
+		FOREACH_COIL(COIL);
+		default:
+			FOREACH_COIL_RANGE(COIL_RANGE);
+			break;
+	}
+
+	//	Determine if there's a valid response for this particular address.
+	if (pWriteFunction != NULL || pRangeWriteFunction != NULL)
+	{
+		//	There is.
+		//	If there's a value that was requested to be written, go ahead
+		//	and attempt to write it.
+		if (bValue != NULL)
+		{
+			eReturn = (pWriteFunction != NULL) ? pWriteFunction((*bValue)) : pRangeWriteFunction(nRangeOffset, (*bValue));
+		}
+	}
+	else
+	{
+		//	There's no valid response for this particular address.
+		eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+	}
+
+	return eReturn;
+}
+
 /*
 	Function:	ModbusDataModel_ReadHoldingRegister()
 	Description:
@@ -269,6 +342,66 @@ ModbusException_T ModbusDataModel_ReadInputRegister(uint16_t nAddress, uint16_t
 	return eReturn;
 }
 
+/*
+	Function:	ModbusDataModel_ReadFileRecord()
+	Description:
+		Attempts to read a single record (register) of a file, as defined
+		by the ModbusDataModel.h file. If the file does not exist,
+		this function will return an exception.
+*/
+ModbusException_T ModbusDataModel_ReadFileRecord(uint16_t nFile, uint16_t nRecord, uint16_t * nReturn)
+{
+	//	Holding value, to store the read function.
+	ModbusException_T (*pFileReadFunction)(uint16_t nRecord, uint16_t * pValue) = NULL;
+	uint16_t nValue;
+
+	switch(nFile)
+	{
+		FOREACH_FILE_RECORD(FILE_RECORD);
+		default:
+			break;
+	}
+
+	//	There's no such file.
+	if (pFileReadFunction == NULL)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+	}
+
+	return pFileReadFunction(nRecord, (nReturn != NULL) ? nReturn : &nValue);
+}
+
+
+/*
+	Function:	ModbusDataModel_ReadFIFOQueue()
+	Description:
+		Attempts to read up to nMax values from the FIFO queue at the
+		address specified, as defined by the ModbusDataModel.h file.
+		The number of values actually read is returned in pCount.
+		If the queue does not exist, this function will return an exception.
+*/
+ModbusException_T ModbusDataModel_ReadFIFOQueue(uint16_t nAddress, uint16_t * pValues, uint16_t nMax, uint16_t * pCount)
+{
+	//	Holding value, to store the read function.
+	uint16_t (*pFIFOReadFunction)(uint16_t * pValues, uint16_t nMax) = NULL;
+
+	switch(nAddress)
+	{
+		FOREACH_FIFO_QUEUE(FIFO_QUEUE);
+		default:
+			break;
+	}
+
+	//	There's no such queue.
+	if (pFIFOReadFunction == NULL)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+	}
+
+	(*pCount) = pFIFOReadFunction(pValues, nMax);
+
+	return MODBUS_EXCEPTION_OK;
+}
 
 /*
 	Function:	ModbusDataModel_ReadObjectIDHelper_Str
@@ -25,6 +25,11 @@
 #include "Configuration.h"
 #include "LED.h"
 #include "Fault.h"
+#include "Relay.h"
+#include "Scheduler.h"
+#include "Diagnostics.h"
+#include "Timebase.h"
+#include "Clock.h"
 
 //	Modbus will use its own FIFO structure.
 //	This is necessary to store whether or not it meets the appropriate
@@ -52,7 +57,7 @@ static uint32_t m_n35CharTicks;
 //	When we're ready to take in this information for the Modbus Slave,
 //	we'll use special access handlers that place this data into logical
 //	input/output buffers.
-DEFINE_STATIC_FIFO(m_sModbusSlaveBufferFIFO, ModbusByte_T, 128);
+DEFINE_STATIC_FIFO(m_sModbusSlaveBufferFIFO, ModbusByte_T, 160);
 
 #define MODBUS_SLAVE_INPUT_BUFFER_SIZE 128
 #define MODBUS_SLAVE_OUTPUT_BUFFER_SIZE 256
@@ -71,6 +76,26 @@ static bool m_bSendingData = false;
 //	Communication process status
 static uint32_t m_nModbusCommunicationTimestamp;
 
+//	While the startup self-tests are still running, requests that would
+//	change anything are turned away with a SLAVE_DEVICE_BUSY exception.
+static bool m_bModbusSlaveWritesBusy = true;
+
+//	Time from reset to the first request we answered, in milliseconds.
+static bool m_bModbusSlaveFirstResponse = false;
+static uint32_t m_nModbusSlaveFirstResponseTimestamp = 0;
+
+//	Modbus interrupt.
+//	The main loop holds m_bModbusSlaveBusy while it is working with the
+//	USART, in which case the interrupt defers itself and is re-pended
+//	as soon as the main loop lets go.
+static volatile bool m_bModbusSlaveBusy = false;
+static volatile bool m_bModbusSlaveDeferred = false;
+
+//	Time from the end of a request to its response being handed to the USART.
+//	Kept in microseconds, since the clock may change from one request to the next.
+static volatile uint32_t m_nModbusSlaveFrameCycles = 0;
+static uint32_t m_nModbusSlaveResponseTimeMax = 0;
+
 /*
 	Function:	ModbusSlave_GrabFIFO()
 	Description:
@@ -82,13 +107,12 @@ const FIFOControl_T * ModbusSlave_GetFIFO(void)
 }
 
 /*
-	Function:	ModbusSlave_Init
+	Function:	ModbusSlave_SetupCharTicks()
 	Description:
-		Initialization for the ModbusSlave.
-		The primary motivation for this initialization function is to calculate the
-		necessary character timeouts in respect to the ModbusSlave timer's configuration.
+		Calculates the 1.5 and 3.5 character timeouts in terms of ticks of
+		the ModbusSlave timer, at the current clock rate.
 */
-void ModbusSlave_Init(void)
+static void ModbusSlave_SetupCharTicks(void)
 {
 	//	Determine the system clock rate.
 	uint32_t nSystemClockRate = HAL_RCC_GetSysClockFreq();
@@ -98,16 +122,8 @@ void ModbusSlave_Init(void)
 	uint32_t nPrescaler = phtim->Instance->PSC;
 
 	//	How fast is our clock running (e.g. how fast is our timer ticking?)
-	//	Note that this is approximate, since I'm not using any form of
-	//	floating point number calculation.
 	uint32_t nTimerTicksPerSec = nSystemClockRate / (nPrescaler + 1);
 
-	//	How long is each tick (in terms of nanoseconds)
-	uint32_t nNanosecondsPerTimerTick = (1000000000 / nTimerTicksPerSec);
-
-	//	Optional addition of one second to make this stricter
-	//	nNanosecondsPerTimerTick += 1;
-
 	//	Based on our baud rate, which is a variable, determine how fast a
 	//	character time is.
 	uint32_t nBaudRate = Configuration_GetBaudRate();
@@ -115,10 +131,85 @@ void ModbusSlave_Init(void)
 	//	Nanoseconds per char
 	uint32_t nNanosecondsPerChar = (1000000000 / (nBaudRate / Configuration_GetMessageLength()));
 
-	//	Update the number of ticks required for 1.5 and 3.5
-	m_n15CharTicks = (nNanosecondsPerChar * 1.5) / nNanosecondsPerTimerTick;
-	m_n35CharTicks = (nNanosecondsPerChar * 3.5) / nNanosecondsPerTimerTick;
+	//	Update the number of ticks required for 1.5 and 3.5.
+	//	Worked out in 64 bits rather than through the length of a tick, which
+	//	is not a whole number of nanoseconds at every clock rate.
+	m_n15CharTicks = (uint32_t) (((uint64_t) nNanosecondsPerChar * 3 * nTimerTicksPerSec) / 2000000000);
+	m_n35CharTicks = (uint32_t) (((uint64_t) nNanosecondsPerChar * 7 * nTimerTicksPerSec) / 2000000000);
+}
+
+/*
+	Function:	ModbusSlave_Init
+	Description:
+		Initialization for the ModbusSlave.
+		The primary motivation for this initialization function is to calculate the
+		necessary character timeouts in respect to the ModbusSlave timer's configuration.
+*/
+void ModbusSlave_Init(void)
+{
+	ModbusSlave_SetupCharTicks();
+
+	//	The end of a frame is signalled by the timer as well, so that
+	//	the request can be answered straight away.
+	HAL_NVIC_SetPriority(MODBUS_SLAVE_TIMER_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(MODBUS_SLAVE_TIMER_IRQn);
 
+	HAL_NVIC_SetPriority(MODBUS_SLAVE_IRQn, MODBUS_SLAVE_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(MODBUS_SLAVE_IRQn);
+}
+
+/*
+	Function:	ModbusSlave_UpdateClock()
+	Description:
+		Called, with interrupts masked, after the core clock changes from
+		nOldClock. The character timeouts are worked out again, and a
+		gap that is being timed is carried over at the new rate, so a
+		switch in the middle of a request does not break up its framing.
+*/
+void ModbusSlave_UpdateClock(uint32_t nOldClock)
+{
+	TIM_HandleTypeDef * phtim = Main_Get_Modbus_Slave_Timer_Handle();
+
+	ModbusSlave_SetupCharTicks();
+
+	//	The timer is one-pulse, so it is only running while a gap is being timed.
+	if (phtim->Instance->CR1 & TIM_CR1_CEN)
+	{
+		uint32_t nCount = (uint32_t) (((uint64_t) phtim->Instance->CNT * SystemCoreClock) / nOldClock);
+
+		phtim->Instance->CNT = (nCount < m_n35CharTicks) ? nCount : m_n35CharTicks - 1;
+	}
+
+	phtim->Instance->CCR1 = m_n15CharTicks;
+	phtim->Instance->ARR = m_n35CharTicks;
+}
+
+/*
+	Function:	ModbusSlave_TimerIRQHandler()
+	Description:
+		Body of the timer interrupt, taken 1.5 and 3.5 character times after
+		the last byte came in. The flags are left alone, since the receive
+		path reads them to frame the request; only the interrupts are masked,
+		until ModbusSlave_SetupTimerValues() unmasks them with the next byte.
+		At 3.5 character times the request is complete, so the Modbus
+		interrupt is pended to answer it.
+*/
+RAMFUNC void ModbusSlave_TimerIRQHandler(void)
+{
+	TIM_HandleTypeDef * phtim = Main_Get_Modbus_Slave_Timer_Handle();
+	uint32_t nSR = phtim->Instance->SR;
+
+	if (nSR & TIM_SR_CC1IF)
+	{
+		phtim->Instance->DIER &= ~TIM_DIER_CC1IE;
+	}
+
+	if (nSR & TIM_SR_UIF)
+	{
+		phtim->Instance->DIER &= ~TIM_DIER_UIE;
+		m_nModbusSlaveFrameCycles = DIAGNOSTICS_CYCLES();
+		NVIC_SetPendingIRQ(MODBUS_SLAVE_IRQn);
+	}
 }
 
 /*
@@ -127,7 +218,7 @@ void ModbusSlave_Init(void)
 		Starts the ModbusSlave timer, used for determining if the incoming
 		characters meet the proper criteria for incoming character times.
 */
-void ModbusSlave_Debug_StartTimer()
+RAMFUNC void ModbusSlave_Debug_StartTimer()
 {
 	TIM_HandleTypeDef * phtim = Main_Get_Modbus_Slave_Timer_Handle();
 
@@ -182,7 +273,7 @@ bool ModbusByte_ContiguousDataTimeoutFlag()
 		structure, and determine based on the TIM whether or not this incoming character
 		exceeded the CHAR_TIMEOUT or COMMAND_TIMEOUT
 */
-void ModbusSlave_ConvertToModbusByte(ModbusByte_T * pModbusByte, uint8_t nByte, uint32_t nSR)
+RAMFUNC void ModbusSlave_ConvertToModbusByte(ModbusByte_T * pModbusByte, uint8_t nByte, uint32_t nSR)
 {
 	//	Ensure that pModbusByte is not null.
 	if (pModbusByte != NULL)
@@ -205,8 +296,9 @@ void ModbusSlave_ConvertToModbusByte(ModbusByte_T * pModbusByte, uint8_t nByte,
 		Modified version of the UART_RxISR_8BIT function that
 		more appropriately handles the Modbus slave input.
 */
-void ModbusSlave_UART_RxISR_8BIT(UART_HandleTypeDef *huart)
+RAMFUNC void ModbusSlave_UART_RxISR_8BIT(UART_HandleTypeDef *huart)
 {
+	uint32_t nStart = DIAGNOSTICS_CYCLES();
 	uint16_t uhMask = huart->Mask;
 	uint16_t  uhdata;
 
@@ -233,6 +325,10 @@ void ModbusSlave_UART_RxISR_8BIT(UART_HandleTypeDef *huart)
 
 		//	Enqueues the result into the FIFO
 		bool bInserted = FIFO_Enqueue(&m_sModbusSlaveBufferFIFO, &sModbusByte);
+		NVIC_SetPendingIRQ(MODBUS_SLAVE_IRQn);
+
+		//	Have the clock raised for the rest of the request and its response.
+		Clock_Demand(CLOCK_DEMAND_MODBUS, true);
 
 		//	Determine if we've overrun our FIFO. If so, we should disable
 		//	the USART RX line for the time being, since we can't really
@@ -250,6 +346,8 @@ void ModbusSlave_UART_RxISR_8BIT(UART_HandleTypeDef *huart)
 		/* Clear RXNE interrupt flag */
 		__HAL_UART_SEND_REQ(huart, UART_RXDATA_FLUSH_REQUEST);
 	}
+
+	Diagnostics_HotPathRecord(DIAGNOSTICS_HOTPATH_MODBUS_RX, nStart);
 }
 
 
@@ -259,7 +357,7 @@ void ModbusSlave_UART_RxISR_8BIT(UART_HandleTypeDef *huart)
 		Assigns the appropriate values to the period (ARR), CCR1 registers
 		for the purposes of determining when timeouts have occurred.
 */
-void ModbusSlave_SetupTimerValues(TIM_HandleTypeDef * htim)
+RAMFUNC void ModbusSlave_SetupTimerValues(TIM_HandleTypeDef * htim)
 {
 	//	Setup the timer values.
 	htim->Instance->CCR1 = m_n15CharTicks;
@@ -418,6 +516,7 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 	if (huart == Main_Get_Modbus_UART_Handle())
 	{
 		m_bSendingData = false;
+		NVIC_SetPendingIRQ(MODBUS_SLAVE_IRQn);
 	}
 }
 
@@ -433,7 +532,7 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 		Takes in a pBuffer of nLength, and calculates the CRC.
 		Assumes the CRC to verify against is stored in the last two bytes.
 */
-bool ModbusSlave_CheckCRC(const uint8_t * pBuffer, uint32_t nBufferLen)
+RAMFUNC bool ModbusSlave_CheckCRC(const uint8_t * pBuffer, uint32_t nBufferLen)
 {
 	//	Placeholder for our calculated CRCs
 	uint16_t nCRCSent;
@@ -476,7 +575,7 @@ bool ModbusSlave_CheckCRC(const uint8_t * pBuffer, uint32_t nBufferLen)
 
         If this function returns true, the buffer contains a valid Modbus command.
 */
-bool ModbusSlave_CollectInput(uint8_t * pBuff, uint32_t nBufferLen, uint32_t * pBufferPos)
+RAMFUNC bool ModbusSlave_CollectInput(uint8_t * pBuff, uint32_t nBufferLen, uint32_t * pBufferPos)
 {
 	//	Grab this timer right away.
 	//	We don't want to allow the timer to go off in the middle of
@@ -551,7 +650,9 @@ bool ModbusSlave_CollectInput(uint8_t * pBuff, uint32_t nBufferLen, uint32_t * p
 		bool bCRCPass = false;
 
 		//	Do the CRC check and determine if that is the case.
+		uint32_t nStart = DIAGNOSTICS_CYCLES();
 		bCRCPass = ModbusSlave_CheckCRC( (const uint8_t *) pBuff, (*pBufferPos));
+		Diagnostics_HotPathRecord(DIAGNOSTICS_HOTPATH_MODBUS_CRC, nStart);
 
 		//	Did the CRC check pass?
 		if (bCRCPass)
@@ -830,6 +931,332 @@ ModbusException_T ModbusFunction_ReadRegisters(	uint8_t * pMbReqPDU, uint32_t nM
 	return MODBUS_EXCEPTION_OK;
 }
 
+/*
+	Function:	ModbusFunction_ReadCoils()
+	Description:
+		Given the MODBUS Request PDU, generate a MODBUS Response PDU.
+		Returns zero (no exception) upon success. Returns a
+		non-zero value representing the error code upon failure.
+*/
+ModbusException_T ModbusFunction_ReadCoils(	uint8_t * pMbReqPDU, uint32_t nMbReqPDULen,
+											uint8_t * pMbRspPDU, uint32_t nMbRspPDULen,
+											uint32_t * pMbRspPDUUsed)
+{
+	//	Check #1:	Request Length == OK
+	if (nMbReqPDULen < 5)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Check #2:	0x0001 <= Quantity of Outputs <= 0x07D0
+	uint32_t nNumberOfCoils = (pMbReqPDU[3] << 8) | (pMbReqPDU[4]);
+	if (nNumberOfCoils < 1 || nNumberOfCoils > 0x07D0)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Clear pMbRspPDU
+	memset(pMbRspPDU, 0, nMbRspPDULen);
+
+	//	Function Field
+	pMbRspPDU[0] = pMbReqPDU[0];
+
+	//	Byte Count
+	//	Eight coils to a byte, with the last byte padded with zeros.
+	pMbRspPDU[1] = (nNumberOfCoils + 7) / 8;
+
+	//	Check #3:	Starting Address == OK
+	//				Starting Address + Quantity of Outputs == OK
+	//	Check #4:	ReadDiscreteOutputs == OK
+	uint32_t nStartAddress = (pMbReqPDU[1] << 8) | (pMbReqPDU[2]);
+	uint16_t nRelativeCoilCounter = 0;
+
+	while (nRelativeCoilCounter < nNumberOfCoils)
+	{
+		bool bValue = false;
+
+		if (!ModbusDataModel_ReadCoil(nStartAddress + nRelativeCoilCounter, &bValue))
+		{
+			return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+		}
+
+		//	The first coil goes in the LSB of the first data byte.
+		if (bValue)
+		{
+			pMbRspPDU[2 + (nRelativeCoilCounter / 8)] |= (1 << (nRelativeCoilCounter % 8));
+		}
+		nRelativeCoilCounter++;
+	}
+
+	(*pMbRspPDUUsed) = 1 + 1 + (pMbRspPDU[1]);
+
+	return MODBUS_EXCEPTION_OK;
+}
+
+/*
+	Function:	ModbusFunction_WriteCoil()
+	Description:
+		Given the MODBUS Request PDU, generate a MODBUS Response PDU.
+		Returns zero (no exception) upon success. Returns a
+		non-zero value representing the error code upon failure.
+*/
+ModbusException_T ModbusFunction_WriteCoil(	uint8_t * pMbReqPDU, uint32_t nMbReqPDULen,
+											uint8_t * pMbRspPDU, uint32_t nMbRspPDULen,
+											uint32_t * pMbRspPDUUsed)
+{
+	//	Check #1:	Request Length == OK
+	if (nMbReqPDULen < 5)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Check #2:	Output Value == 0x0000 OR 0xFF00
+	uint16_t nOutputValue = (pMbReqPDU[3] << 8) | (pMbReqPDU[4]);
+	if (nOutputValue != 0x0000 && nOutputValue != 0xFF00)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Check #3:	Output Address == OK
+	//	Check #4:	WriteSingleOutput == OK
+	uint16_t nOutputAddress = (pMbReqPDU[1] << 8) | (pMbReqPDU[2]);
+	bool bValue = (nOutputValue == 0xFF00);
+
+	ModbusException_T eResult = ModbusDataModel_WriteCoil(nOutputAddress, &bValue);
+
+	if (eResult != MODBUS_EXCEPTION_OK)
+	{
+		return eResult;
+	}
+
+	//	The normal response is an echo of the request.
+	memset(pMbRspPDU, 0, nMbRspPDULen);
+	memcpy(pMbRspPDU, pMbReqPDU, 5);
+	(*pMbRspPDUUsed) = 5;
+
+	//	All good.
+	return MODBUS_EXCEPTION_OK;
+}
+
+/*
+	Function:	ModbusFunction_WriteCoils()
+	Description:
+		Given the MODBUS Request PDU, generate a MODBUS Response PDU.
+		Returns zero (no exception) upon success. Returns a
+		non-zero value representing the error code upon failure.
+
+		Every coil is checked before any of them are written, so a request
+		that runs off the end of the coils doesn't change anything.
+*/
+ModbusException_T ModbusFunction_WriteCoils(	uint8_t * pMbReqPDU, uint32_t nMbReqPDULen,
+												uint8_t * pMbRspPDU, uint32_t nMbRspPDULen,
+												uint32_t * pMbRspPDUUsed)
+{
+	//	Check #1:	Request Length == OK, up to the byte count
+	if (nMbReqPDULen < 6)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Check #2:	0x0001 <= Quantity of Outputs <= 0x07B0
+	//								AND
+	//	Check #3:	Byte Count == ceil(Quantity of Outputs / 8),
+	//				all of which were actually received
+	uint32_t nNumberOfCoils = (pMbReqPDU[3] << 8) | (pMbReqPDU[4]);
+	uint32_t nNumberOfBytes = (pMbReqPDU[5]);
+	if (nNumberOfCoils < 1 || nNumberOfCoils > 0x07B0
+			|| ((nNumberOfCoils + 7) / 8) != nNumberOfBytes
+			|| (6 + nNumberOfBytes) > nMbReqPDULen)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Check #4:	Starting Address == OK
+	//						AND
+	//	Check #5:	Starting Address + Quantity of Outputs == OK
+	uint32_t nStartAddress = (pMbReqPDU[1] << 8) | (pMbReqPDU[2]);
+	uint16_t nRelativeCoilCounter;
+
+	for (nRelativeCoilCounter = 0; nRelativeCoilCounter < nNumberOfCoils; nRelativeCoilCounter++)
+	{
+		if (ModbusDataModel_WriteCoil(nStartAddress + nRelativeCoilCounter, NULL) != MODBUS_EXCEPTION_OK)
+		{
+			return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+		}
+	}
+
+	//	Check #6:	WriteMultipleOutputs == OK
+	for (nRelativeCoilCounter = 0; nRelativeCoilCounter < nNumberOfCoils; nRelativeCoilCounter++)
+	{
+		bool bValue = (pMbReqPDU[6 + (nRelativeCoilCounter / 8)] >> (nRelativeCoilCounter % 8)) & 1;
+
+		ModbusException_T eException = ModbusDataModel_WriteCoil(nStartAddress + nRelativeCoilCounter, &bValue);
+
+		if (eException != MODBUS_EXCEPTION_OK)
+		{
+			return eException;
+		}
+	}
+
+	//	Build the response.
+	memset(pMbRspPDU, 0, nMbRspPDULen);
+
+	//	Function code
+	pMbRspPDU[0] = pMbReqPDU[0];
+
+	//	Starting address
+	pMbRspPDU[1] = (nStartAddress >> 8) & 0xFF;
+	pMbRspPDU[2] = (nStartAddress) 		& 0xFF;
+
+	//	Quantity of outputs
+	pMbRspPDU[3] = (nNumberOfCoils >> 8)	& 0xFF;
+	pMbRspPDU[4] = (nNumberOfCoils) 		& 0xFF;
+
+	(*pMbRspPDUUsed) = 5;
+
+	//	All good.
+	return MODBUS_EXCEPTION_OK;
+}
+
+/*
+	Function:	ModbusFunction_ReadFileRecord()
+	Description:
+		Given the MODBUS Request PDU, generate a MODBUS Response PDU.
+		Returns zero (no exception) upon success. Returns a
+		non-zero value representing the error code upon failure.
+
+		The request holds one or more sub-requests of seven bytes each
+		(reference type, file number, record number, record length),
+		and the response one group of records for each of them.
+*/
+ModbusException_T ModbusFunction_ReadFileRecord(	uint8_t * pMbReqPDU, uint32_t nMbReqPDULen,
+													uint8_t * pMbRspPDU, uint32_t nMbRspPDULen,
+													uint32_t * pMbRspPDUUsed)
+{
+	//	Check #1:	0x07 <= Byte Count <= 0xF5, a whole number of sub-requests,
+	//				all of which were actually received.
+	uint32_t nByteCount = pMbReqPDU[1];
+	if (nByteCount < 0x07 || nByteCount > 0xF5 || (nByteCount % 7) != 0
+			|| (2 + nByteCount) > nMbReqPDULen)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	//	Clear pMbRspPDU
+	memset(pMbRspPDU, 0, nMbRspPDULen);
+
+	//	Function Field
+	pMbRspPDU[0] = pMbReqPDU[0];
+
+	uint32_t nRspPos = 2;
+	uint32_t nSubRequest;
+
+	for (nSubRequest = 0; nSubRequest < (nByteCount / 7); nSubRequest++)
+	{
+		uint8_t * pSubRequest = &pMbReqPDU[2 + (nSubRequest * 7)];
+		uint16_t nFile = (pSubRequest[1] << 8) | (pSubRequest[2]);
+		uint16_t nRecord = (pSubRequest[3] << 8) | (pSubRequest[4]);
+		uint16_t nLength = (pSubRequest[5] << 8) | (pSubRequest[6]);
+
+		//	Check #2:	Reference Type == 6, and the record number in range.
+		if (pSubRequest[0] != 0x06 || nRecord > 0x270F)
+		{
+			return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+		}
+
+		//	Check #3:	The response still fits.
+		if (nLength < 1 || ((nRspPos - 2) + 2 + (2 * nLength)) > 0xF5)
+		{
+			return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+		}
+
+		//	File response length and reference type
+		pMbRspPDU[nRspPos++] = 1 + (2 * nLength);
+		pMbRspPDU[nRspPos++] = 0x06;
+
+		//	Check #4:	ReadGeneralReference == OK
+		for (uint16_t nRelativeRecord = 0; nRelativeRecord < nLength; nRelativeRecord++)
+		{
+			uint16_t nValue;
+			ModbusException_T eException = ModbusDataModel_ReadFileRecord(nFile, nRecord + nRelativeRecord, &nValue);
+
+			if (eException != MODBUS_EXCEPTION_OK)
+			{
+				return eException;
+			}
+
+			pMbRspPDU[nRspPos++] = (nValue >> 8) & 0xFF;
+			pMbRspPDU[nRspPos++] = (nValue) & 0xFF;
+		}
+	}
+
+	//	Response Data Length
+	pMbRspPDU[1] = nRspPos - 2;
+
+	(*pMbRspPDUUsed) = nRspPos;
+
+	return MODBUS_EXCEPTION_OK;
+}
+
+/*
+	Function:	ModbusFunction_ReadFIFOQueue()
+	Description:
+		Given the MODBUS Request PDU, generate a MODBUS Response PDU.
+		Returns zero (no exception) upon success. Returns a
+		non-zero value representing the error code upon failure.
+
+		Up to 31 of the oldest values are returned. Reading doesn't
+		remove them; that's left to the queue's own acknowledgement,
+		so a response lost on the bus costs nothing.
+*/
+ModbusException_T ModbusFunction_ReadFIFOQueue(	uint8_t * pMbReqPDU, uint32_t nMbReqPDULen,
+												uint8_t * pMbRspPDU, uint32_t nMbRspPDULen,
+												uint32_t * pMbRspPDUUsed)
+{
+	uint16_t aValues[31];
+	uint16_t nCount = 0;
+
+	//	Check #1:	Request Length == OK
+	//	Check #2:	FIFO Pointer Address == OK
+	//	Check #3:	ReadFIFOQueue == OK
+	if (nMbReqPDULen < 3)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+	}
+
+	uint16_t nAddress = (pMbReqPDU[1] << 8) | (pMbReqPDU[2]);
+	ModbusException_T eException = ModbusDataModel_ReadFIFOQueue(nAddress, aValues, 31, &nCount);
+
+	if (eException != MODBUS_EXCEPTION_OK)
+	{
+		return eException;
+	}
+
+	//	Clear pMbRspPDU
+	memset(pMbRspPDU, 0, nMbRspPDULen);
+
+	//	Function Field
+	pMbRspPDU[0] = pMbReqPDU[0];
+
+	//	Byte Count, covering the FIFO Count and the values.
+	pMbRspPDU[1] = ((2 + (2 * nCount)) >> 8) & 0xFF;
+	pMbRspPDU[2] = (2 + (2 * nCount)) & 0xFF;
+
+	//	FIFO Count
+	pMbRspPDU[3] = (nCount >> 8) & 0xFF;
+	pMbRspPDU[4] = (nCount) & 0xFF;
+
+	for (uint16_t nValue = 0; nValue < nCount; nValue++)
+	{
+		pMbRspPDU[5 + (nValue * 2)] = (aValues[nValue] >> 8) & 0xFF;
+		pMbRspPDU[5 + (nValue * 2) + 1] = (aValues[nValue]) & 0xFF;
+	}
+
+	(*pMbRspPDUUsed) = 5 + (2 * nCount);
+
+	return MODBUS_EXCEPTION_OK;
+}
+
 /*
 	Function:	ModbusFunction_AppendObject()
 	Description:
@@ -1060,6 +1487,8 @@ ModbusException_T ModbusFunction_ReadDeviceIdentification(	uint8_t * pMbReqPDU,
 	Description:
 		Build a complete, valid Modbus frame that can be sent out.
 		Returns the number of bytes used in the final buffer.
+		The PDU may already be in place in the output buffer, just
+		after the slave address, as ModbusSlave_BuildResponse() leaves it.
 */
 uint32_t ModbusSlave_BuildFrame(uint8_t * pPDU, uint32_t nPDUSize,
 								uint8_t * pOutputBuffer, uint32_t nOutputBufferSize)
@@ -1075,19 +1504,20 @@ uint32_t ModbusSlave_BuildFrame(uint8_t * pPDU, uint32_t nPDUSize,
 			(nPDUSize > 0) &&
 			((1 + nPDUSize + 2) <= nOutputBufferSize))
 	{
-		//	Memset the entirety of the output buffer to zero.
-		memset(pOutputBuffer, 0, nOutputBufferSize);
-
 		//	Grab the slave address, and store it in the output buffer.
 		uint8_t * pOutputBufferSlaveAddr = &pOutputBuffer[0];
 		(*pOutputBufferSlaveAddr) = Configuration_GetModbusAddress();
 		nOutputBufferBytesUsed += 1;
 
 		//	Grab the pPDU, and store it in the output buffer.
+		//	This does nothing when it was built in place.
 		uint8_t * pOutputBufferPDU = &pOutputBuffer[1];
-		memcpy(pOutputBufferPDU, pPDU, nPDUSize);
+		memmove(pOutputBufferPDU, pPDU, nPDUSize);
 		nOutputBufferBytesUsed += nPDUSize;
 
+		//	Zero whatever is left of the output buffer past the frame.
+		memset(&pOutputBuffer[1 + nPDUSize + 2], 0, nOutputBufferSize - (1 + nPDUSize + 2));
+
 		//	Calculate the CRC on the remaining bytes, and store it
 		//	in the outgoing buffer.
 		//	Note that the number of bytes to process is
@@ -1116,6 +1546,17 @@ uint32_t ModbusSlave_BuildFrame(uint8_t * pPDU, uint32_t nPDUSize,
 
 
 
+/*
+	Function:	ModbusSlave_IsWriteFunction()
+	Description:
+		Returns true if the function code is one that writes to the data model.
+*/
+static bool ModbusSlave_IsWriteFunction(uint8_t nFunctionCode)
+{
+	return nFunctionCode == 0x05 || nFunctionCode == 0x06
+			|| nFunctionCode == 0x0F || nFunctionCode == 0x10;
+}
+
 /*
 	Function:	ModbusSlave_BuildRespond()
 	Description:
@@ -1129,7 +1570,6 @@ void ModbusSlave_BuildResponse(uint8_t * pInputBuffer, uint32_t nInputBufferLen,
 							   uint8_t * pOutputBuffer, uint32_t nOutputBufferLen,
 							   uint32_t * pOutputBufferLenUsed)
 {
-#define MODBUS_PDU_LEN 256
 	//	Recall that Modbus commands are variable length.
 	//	To determine what we've got to work with, we need to determine
 	//	the type of command that's being requested of us.
@@ -1146,30 +1586,28 @@ void ModbusSlave_BuildResponse(uint8_t * pInputBuffer, uint32_t nInputBufferLen,
 	uint8_t * pMbReqPDU = &pInputBuffer[1];
 	uint32_t nMbReqPDULen = nInputBufferLen-1;
 
-	uint8_t aMbRspPDU[MODBUS_PDU_LEN];
-	uint8_t * pMbRspPDU = aMbRspPDU;
-	uint32_t nMbRspPDULen = MODBUS_PDU_LEN;
+	//	The response PDU is built in place in the output buffer, after the
+	//	slave address, leaving room for the CRC; there's no need for a
+	//	separate PDU buffer on the stack.
+	uint8_t * pMbRspPDU = &pOutputBuffer[1];
+	uint32_t nMbRspPDULen = nOutputBufferLen - 3;
 	uint32_t nMbRspPDUUsed = 0;
 
 	//	Build the exception handler
 	//	Upon success, this value should remain zero.
 	ModbusException_T eMbException = 0;
 
-	switch(nFunctionCode)
+	//	Until startup is complete, only reads are served.
+	if (m_bModbusSlaveWritesBusy && ModbusSlave_IsWriteFunction(nFunctionCode))
+	{
+		eMbException = MODBUS_EXCEPTION_SLAVE_DEVICE_BUSY;
+	}
+	else switch(nFunctionCode)
 	{
 		case 0x01:
-			//	Read Coil Status
-			//
-			//		QUERY:
-			//		0	NODE
-			//		1	FUNCTION
-			//		2	START ADDRESS (HI)
-			//		3	START ADDRESS (LO)
-			//		4	#	POINTS HI
-			//		5	#	POINTS LO
-
-
-
+			eMbException = ModbusFunction_ReadCoils(			pMbReqPDU, nMbReqPDULen,
+																pMbRspPDU, nMbRspPDULen,
+																&nMbRspPDUUsed);
 			break;
 		case 0x03:
 			eMbException = ModbusFunction_ReadRegisters(		pMbReqPDU, nMbReqPDULen,
@@ -1189,12 +1627,32 @@ void ModbusSlave_BuildResponse(uint8_t * pInputBuffer, uint32_t nInputBufferLen,
 																&nMbRspPDUUsed,
 																ModbusDataModel_WriteHoldingRegister);
 			break;
+		case 0x05:
+			eMbException = ModbusFunction_WriteCoil(			pMbReqPDU,	nMbReqPDULen,
+																pMbRspPDU,	nMbRspPDULen,
+																&nMbRspPDUUsed);
+			break;
+		case 0x0F:
+			eMbException = ModbusFunction_WriteCoils(			pMbReqPDU,	nMbReqPDULen,
+																pMbRspPDU,	nMbRspPDULen,
+																&nMbRspPDUUsed);
+			break;
 		case 0x10:
 			eMbException = ModbusFunction_WriteRegisters(		pMbReqPDU,	nMbReqPDULen,
 																pMbRspPDU,	nMbRspPDULen,
 																&nMbRspPDUUsed,
 																ModbusDataModel_WriteHoldingRegister);
 			break;
+		case 0x14:
+			eMbException = ModbusFunction_ReadFileRecord(		pMbReqPDU,	nMbReqPDULen,
+																pMbRspPDU,	nMbRspPDULen,
+																&nMbRspPDUUsed);
+			break;
+		case 0x18:
+			eMbException = ModbusFunction_ReadFIFOQueue(		pMbReqPDU,	nMbReqPDULen,
+																pMbRspPDU,	nMbRspPDULen,
+																&nMbRspPDUUsed);
+			break;
 		case 0x2B:
 			eMbException = ModbusFunction_ReadDeviceIdentification(	pMbReqPDU,	nMbReqPDULen,
 																	pMbRspPDU,	nMbRspPDULen,
@@ -1231,7 +1689,7 @@ void ModbusSlave_CommunicationFaultProcess()
 {
 	bool bFaulted = false;
 
-	if (uwTick - m_nModbusCommunicationTimestamp > MODBUS_SLAVE_COMMUNICATION_TIMEOUT_FAULT_MS)
+	if (Timebase_ElapsedMilliseconds(m_nModbusCommunicationTimestamp, MODBUS_SLAVE_COMMUNICATION_TIMEOUT_FAULT_MS))
 	{
 		//	To prevent rollover fault.
 		m_nModbusCommunicationTimestamp = uwTick - MODBUS_SLAVE_COMMUNICATION_TIMEOUT_FAULT_MS - 1;
@@ -1293,35 +1751,90 @@ void ModbusSlave_VerifyUSARTReady()
 
 
 /*
-	Function:	ModbusSlave_Process()
+	Function:	ModbusSlave_SetWritesBusy()
 	Description:
-		Main process function for the ModbusSlave.
+		Sets whether write requests are refused with SLAVE_DEVICE_BUSY.
+		They are from power up, until the startup self-tests have completed.
 */
-void ModbusSlave_Process(void)
+void ModbusSlave_SetWritesBusy(bool bBusy)
 {
-	//	Storage for whether or not a Modbus command is ready.
-	bool bValidModbusCommand = false;
+	m_bModbusSlaveWritesBusy = bBusy;
+}
 
-	//	Process our communication status
-	//	If we haven't received any valid Modbus communication without our
-	//	timeout, trigger the fault.
-	ModbusSlave_CommunicationFaultProcess();
+/*
+	Function:	ModbusSlave_GetBootToFirstResponse()
+	Description:
+		Returns the time from reset to the first request we answered,
+		in milliseconds, or 0 if nothing has been answered yet.
+*/
+uint16_t ModbusSlave_GetBootToFirstResponse(void)
+{
+	return (m_nModbusSlaveFirstResponseTimestamp > UINT16_MAX) ?
+			UINT16_MAX : (uint16_t) m_nModbusSlaveFirstResponseTimestamp;
+}
 
-	//	Verify that the USART is truly ready. If it isn't, this will do the
-	//	magic of setting the m_bReadyToAcceptData variable to false.
-	ModbusSlave_VerifyUSARTReady();
+/*
+	Function:	ModbusSlave_GetResponseTimeMax()
+	Description:
+		Returns the longest time from the end of a request addressed to us
+		to its response being handed to the USART, in microseconds.
+*/
+uint16_t ModbusSlave_GetResponseTimeMax(void)
+{
+	return (m_nModbusSlaveResponseTimeMax > UINT16_MAX) ?
+			UINT16_MAX : (uint16_t) m_nModbusSlaveResponseTimeMax;
+}
 
-	//	If incoming data hasn't been initialized yet, go ahead and do that.
-	//	Note that this flag could become "unset" if for whatever reason, initializing
-	//	does not pass.
-	if (!m_bReadyToAcceptData)
+/*
+	Function:	ModbusSlave_Acquire()
+				ModbusSlave_Release()
+	Description:
+		Brackets main loop access to the USART.
+		If the Modbus interrupt was deferred while it was held, it is
+		re-pended on release and runs immediately afterwards.
+*/
+static void ModbusSlave_Acquire(void)
+{
+	m_bModbusSlaveBusy = true;
+}
+static void ModbusSlave_Release(void)
+{
+	m_bModbusSlaveBusy = false;
+
+	if (m_bModbusSlaveDeferred)
 	{
-		if (FIFO_GetFree(&m_sModbusSlaveBufferFIFO))
-		{
-			m_bReadyToAcceptData = ModbusSlave_PrepareForInput();
-		}
+		NVIC_SetPendingIRQ(MODBUS_SLAVE_IRQn);
+	}
+}
+
+/*
+	Function:	ModbusSlave_IRQHandler()
+	Description:
+		Body of the Modbus interrupt, pended by every byte in, the end of
+		every frame, and the end of every response.
+		Collects the request, and if it is complete and addressed to us,
+		builds the response and starts it on its way. This runs at a
+		priority above the main loop, so the time to respond depends on
+		the request alone, not on which task happened to be running.
+		Anything the request touches that is also used by the main loop
+		is guarded by the modules that own it.
+*/
+RAMFUNC void ModbusSlave_IRQHandler(void)
+{
+	uint32_t nStart = DIAGNOSTICS_CYCLES();
+
+	//	Storage for whether or not a Modbus command is ready.
+	bool bValidModbusCommand = false;
+
+	if (m_bModbusSlaveBusy)
+	{
+		//	Deferred; ModbusSlave_Release() will pend us again.
+		m_bModbusSlaveDeferred = true;
+		return;
 	}
 
+	m_bModbusSlaveDeferred = false;
+
 	switch(m_eModbusSlaveState)
 	{
 		case MODBUS_SLAVE_INIT:
@@ -1352,17 +1865,40 @@ void ModbusSlave_Process(void)
 					//	Update our own internal communication timer.
 					m_nModbusCommunicationTimestamp = uwTick;
 
+					//	uwTick has run since reset, so this is the boot-to-first-response time.
+					if (!m_bModbusSlaveFirstResponse)
+					{
+						m_nModbusSlaveFirstResponseTimestamp = uwTick;
+						m_bModbusSlaveFirstResponse = true;
+					}
+
 					//	Flip this to set so that we can transmit data.
 					HAL_GPIO_WritePin(GPIOA, GPIO_PIN_8, GPIO_PIN_SET);
 
 					//	Build up the response.
-					ModbusSlave_BuildResponse(m_aModbusSlaveInputBuffer, MODBUS_SLAVE_INPUT_BUFFER_SIZE,
+					//	Only the bytes received count as the command, less the CRC.
+					ModbusSlave_BuildResponse(m_aModbusSlaveInputBuffer, m_nModbusSlaveInputBufferPos - 2,
 											  m_aModbusSlaveOutputBuffer, MODBUS_SLAVE_OUTPUT_BUFFER_SIZE,
 											  &m_nModbusSlaveOutputBufferPos);
 
 					//	Attempt to send.
 					ModbusSlave_PrepareForOutput(m_aModbusSlaveOutputBuffer, m_nModbusSlaveOutputBufferPos);
 					m_eModbusSlaveState = MODBUS_SLAVE_SEND_WAIT;
+
+					uint32_t nResponseTime = Diagnostics_CyclesToMicroseconds(DIAGNOSTICS_CYCLES() - m_nModbusSlaveFrameCycles);
+
+					if (nResponseTime > m_nModbusSlaveResponseTimeMax)
+					{
+						m_nModbusSlaveResponseTimeMax = nResponseTime;
+					}
+
+					//	The response is now going out under interrupts.
+					//	If the request changed the relays, latch the new pattern
+					//	now rather than waiting for the relay state machine.
+					Relay_FastPath();
+
+					//	Have the main loop look over the USART once we're done.
+					Scheduler_Post(SCHEDULER_EVENT_MODBUS);
 				}
 				else
 				{
@@ -1385,10 +1921,62 @@ void ModbusSlave_Process(void)
 				memset(m_aModbusSlaveOutputBuffer, 0, MODBUS_SLAVE_OUTPUT_BUFFER_SIZE);
 				m_nModbusSlaveOutputBufferPos = 0;
 				m_eModbusSlaveState = MODBUS_SLAVE_RECEIVE;
+
+				//	Anything that came in while we were sending is picked up next.
+				if (FIFO_GetQueued(&m_sModbusSlaveBufferFIFO))
+				{
+					NVIC_SetPendingIRQ(MODBUS_SLAVE_IRQn);
+				}
 			}
 			break;
 
 	}
+
+	//	The clock may drop again once there is nothing part way through.
+	Clock_Demand(CLOCK_DEMAND_MODBUS,
+			m_eModbusSlaveState != MODBUS_SLAVE_RECEIVE
+			|| m_nModbusSlaveInputBufferPos != 0
+			|| FIFO_GetQueued(&m_sModbusSlaveBufferFIFO));
+
+	Diagnostics_HotPathRecord(DIAGNOSTICS_HOTPATH_MODBUS_IRQ, nStart);
+}
+
+/*
+	Function:	ModbusSlave_Process()
+	Description:
+		Main process function for the ModbusSlave.
+		Requests themselves are answered by ModbusSlave_IRQHandler();
+		this looks after the communication fault and the USART.
+*/
+void ModbusSlave_Process(void)
+{
+	//	Process our communication status
+	//	If we haven't received any valid Modbus communication without our
+	//	timeout, trigger the fault.
+	ModbusSlave_CommunicationFaultProcess();
+
+	//	The Modbus interrupt transmits on the same USART, so hold it off.
+	ModbusSlave_Acquire();
+
+	//	Verify that the USART is truly ready. If it isn't, this will do the
+	//	magic of setting the m_bReadyToAcceptData variable to false.
+	ModbusSlave_VerifyUSARTReady();
+
+	//	If incoming data hasn't been initialized yet, go ahead and do that.
+	//	Note that this flag could become "unset" if for whatever reason, initializing
+	//	does not pass.
+	if (!m_bReadyToAcceptData)
+	{
+		if (FIFO_GetFree(&m_sModbusSlaveBufferFIFO))
+		{
+			m_bReadyToAcceptData = ModbusSlave_PrepareForInput();
+		}
+	}
+
+	ModbusSlave_Release();
+
+	//	Should a pend ever go astray, the next request still gets through.
+	NVIC_SetPendingIRQ(MODBUS_SLAVE_IRQn);
 }
 
 
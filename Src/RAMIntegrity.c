@@ -9,7 +9,10 @@
 #include <stddef.h>
 #include "RAMIntegrity.h"
 #include "cmsis_gcc.h"
+#include "main.h"
 #include "Fault.h"
+#include "Configuration.h"
+#include "Diagnostics.h"
 
 typedef enum
 {
@@ -19,28 +22,60 @@ typedef enum
 
 static RAMIntegrity_State_T m_eRAMIntegrityState = RAMINTEGRITY_STARTUP;
 
-//	Determine which chunk of RAM we're currently working with.
-//	Aka, split up the RAM into nicely sized paged chunks.
-static uint32_t m_nRAMChunk = 0;
+//	Offset (in bytes, from the start of RAM) of the next chunk to be tested.
+static uint32_t m_nRAMOffset = 0;
+
+//	Size of the chunk tested with interrupts disabled, in words.
+//	Adjusted after every chunk so that the lockout stays within budget.
+static uint32_t m_nRAMChunkWords = RAMINTEGRITY_CHUNK_MIN_WORDS;
+
+//	Statistics.
+static uint32_t m_nRAMLockoutMax = 0;
+static uint16_t m_nRAMSweeps = 0;
+
+//	Backup of the chunk under test.
+//	Two slots are kept, far enough apart that no chunk can touch both,
+//	so that the buffer itself can be tested from the other slot.
+#define RAM_BACKUP_SLOT_WORDS (RAMINTEGRITY_CHUNK_MAX_WORDS + 2)
+static uint32_t m_aRAMBackup[3 * RAM_BACKUP_SLOT_WORDS];
 
 //	Start of the RAM region.
-extern uint32_t _sdata;
+//	The functions run from RAM come first, so they are tested as well.
+extern uint32_t _sramfunc;
 
 //	Represents the end of the RAM region.
 extern uint32_t _estack;
 
+//	The DMA buffers (see DMA_BUFFER in main.h), which are left out.
+//	DMA carries on with interrupts disabled, so it would trip the test,
+//	and the restore would then put stale data over what it had written.
+extern uint32_t _sdma;
+extern uint32_t _edma;
+
 //	Size of RAM
-#define RAM_SIZE_BYTES ((((uint32_t)&_estack) - ((uint32_t)&_sdata)))
-#define RAM_PAGE_SIZE_BYTES (32)
-#define RAM_PAGE_SIZE_WORDS (RAM_PAGE_SIZE_BYTES/4)
-#define RAM_PAGE_COUNT (RAM_SIZE_BYTES/RAM_PAGE_SIZE_BYTES)
+#define RAM_START ((uint32_t)&_sramfunc)
+#define RAM_END ((uint32_t)&_estack)
+#define RAM_SIZE_BYTES (RAM_END - RAM_START)
+#define RAM_DMA_START ((uint32_t)&_sdma)
+#define RAM_DMA_END ((uint32_t)&_edma)
+
+//	Background pattern of the March test, and its inverse.
+//	Alternating bits also catch shorts between neighbouring bits of a word.
+#define RAM_PATTERN_0 (0x55555555)
+#define RAM_PATTERN_1 (0xAAAAAAAA)
 
 /*
 	Function:	RAMIntegrity_Run()
 	Description:
-		Runs a RAM integrity check on a given set of RAM boundaries.
+		Runs a transparent March C- test over a given set of RAM boundaries,
+		with interrupts disabled:
+			save, up(w0), up(r0,w1), up(r1,w0), down(r0,w1), down(r1,w0), down(r0), restore
+		This finds stuck-at, transition, address decoder and coupling faults
+		between the words of the range.
+		The original contents are held in pBackup (which must not lie within
+		the range) and are always put back, pass or fail.
 */
-bool RAMIntegrity_Run(uint32_t * pStart, uint32_t * pEnd)
+bool RAMIntegrity_Run(uint32_t * pStart, uint32_t * pEnd, uint32_t * pBackup)
 {
 	/*
 		WARNING:	This function requires careful attention as to how
@@ -53,116 +88,201 @@ bool RAMIntegrity_Run(uint32_t * pStart, uint32_t * pEnd)
 					tool to ensure that this function completes as intended.
 	*/
 
-	//	pAddress is responsible for storing the present address of which
-	//	will be checked for integrity. It serves two purposes:
-	//		-	will store the address currently being checked.
-	//		-	upon function completion, will equal the pEnd value
-	//			to indicate SUCCESS, or NULL to indicate FAILURE.
-	//		-	this behavior allows me to eliminate a boolean register.
-
 	//	These are cast as uint32_t. This is because these are purely
 	//	addresses in memory, and we want to make it explicitly clear
 	//	when we're trying to access where these things point to in memory.
-	register uint32_t pAddress = (uint32_t) pStart;
+	register uint32_t pAddress;
+	register uint32_t pAddressStart = (uint32_t) pStart;
 	register uint32_t pAddressEnd = (uint32_t) pEnd;
-
-	register uint32_t nTemporaryWord;
-	register uint32_t nBASEPRI = __get_PRIMASK();
-
-
+	register uint32_t pAddressBackup = (uint32_t) pBackup;
+	register uint32_t bPass = true;
+	register uint32_t nPRIMASK = __get_PRIMASK();
 
 	//	Disable interrupts, using the PRIMASK.
 	__set_PRIMASK(1);
 
-	//	Iterate through each byte:
-	while (pAddress < pAddressEnd)
-	{
-		//	Within this loop--	we can ONLY modify REGISTERS.
+	//	Within this section--	we can ONLY modify REGISTERS,
+	//	as the stack may well be part of the range under test.
 
-		//	Save the contents of each byte into a temporary value on the stack.
-		nTemporaryWord = VOLATILE_DEREF(uint32_t, pAddress);
+	//	Save the contents of the range.
+	for (pAddress = pAddressStart; pAddress < pAddressEnd; pAddress += sizeof(uint32_t))
+	{
+		VOLATILE_DEREF(uint32_t, pAddressBackup + (pAddress - pAddressStart)) = VOLATILE_DEREF(uint32_t, pAddress);
+	}
 
-		//	Write the value 0x55, or 0b01010101 to the address under test.
-		VOLATILE_DEREF(uint32_t, pAddress) = 0x55555555;
+	//	M0:	up(w0)
+	for (pAddress = pAddressStart; pAddress < pAddressEnd; pAddress += sizeof(uint32_t))
+	{
+		VOLATILE_DEREF(uint32_t, pAddress) = RAM_PATTERN_0;
+	}
 
-		//	Read the address under test, and verify that its value is 0x55.
-		//		If this does not match, the integrity test fails.
-		if (VOLATILE_DEREF(uint32_t, pAddress) != 0x55555555)
-		{
-			VOLATILE_DEREF(uint32_t, pAddress) = nTemporaryWord;
-			pAddress = (uint32_t) NULL;
-			break;
-		}
+	//	M1:	up(r0,w1)
+	for (pAddress = pAddressStart; bPass && pAddress < pAddressEnd; pAddress += sizeof(uint32_t))
+	{
+		bPass = (VOLATILE_DEREF(uint32_t, pAddress) == RAM_PATTERN_0);
+		VOLATILE_DEREF(uint32_t, pAddress) = RAM_PATTERN_1;
+	}
 
-		//	Write the value 0xAA, or 0b01010101 to the address under test.
-		VOLATILE_DEREF(uint32_t, pAddress) = 0xAAAAAAAA;
+	//	M2:	up(r1,w0)
+	for (pAddress = pAddressStart; bPass && pAddress < pAddressEnd; pAddress += sizeof(uint32_t))
+	{
+		bPass = (VOLATILE_DEREF(uint32_t, pAddress) == RAM_PATTERN_1);
+		VOLATILE_DEREF(uint32_t, pAddress) = RAM_PATTERN_0;
+	}
 
-		//	Read the address under test, and verify that its value is 0xAA.
-		//		If this does not match, the integrity test fails.
-		if (VOLATILE_DEREF(uint32_t, pAddress) != 0xAAAAAAAA)
-		{
-			VOLATILE_DEREF(uint32_t, pAddress) = nTemporaryWord;
-			pAddress = (uint32_t) NULL;
-			break;
-		}
+	//	M3:	down(r0,w1)
+	for (pAddress = pAddressEnd; bPass && pAddress > pAddressStart; )
+	{
+		pAddress -= sizeof(uint32_t);
+		bPass = (VOLATILE_DEREF(uint32_t, pAddress) == RAM_PATTERN_0);
+		VOLATILE_DEREF(uint32_t, pAddress) = RAM_PATTERN_1;
+	}
 
-		//	Write the temporary value back to the address under test.
-		VOLATILE_DEREF(uint32_t, pAddress) = nTemporaryWord;
+	//	M4:	down(r1,w0)
+	for (pAddress = pAddressEnd; bPass && pAddress > pAddressStart; )
+	{
+		pAddress -= sizeof(uint32_t);
+		bPass = (VOLATILE_DEREF(uint32_t, pAddress) == RAM_PATTERN_1);
+		VOLATILE_DEREF(uint32_t, pAddress) = RAM_PATTERN_0;
+	}
 
-		//	Read the address under test, and verify that its value matches the original value.
-		//		If this does not match, the integrity test fails.
-		if (VOLATILE_DEREF(uint32_t, pAddress) != nTemporaryWord)
-		{
-			VOLATILE_DEREF(uint32_t, pAddress) = nTemporaryWord;
-			pAddress = (uint32_t) NULL;
-			break;
-		}
+	//	M5:	down(r0)
+	for (pAddress = pAddressEnd; bPass && pAddress > pAddressStart; )
+	{
+		pAddress -= sizeof(uint32_t);
+		bPass = (VOLATILE_DEREF(uint32_t, pAddress) == RAM_PATTERN_0);
+	}
 
-		//	Increase the counter.
-		pAddress += sizeof(void *);
+	//	Put the original contents back, and make sure they stuck.
+	for (pAddress = pAddressStart; pAddress < pAddressEnd; pAddress += sizeof(uint32_t))
+	{
+		VOLATILE_DEREF(uint32_t, pAddress) = VOLATILE_DEREF(uint32_t, pAddressBackup + (pAddress - pAddressStart));
+		bPass = bPass && (VOLATILE_DEREF(uint32_t, pAddress) == VOLATILE_DEREF(uint32_t, pAddressBackup + (pAddress - pAddressStart)));
 	}
 
 	//	Enable interrupts, using the PRIMASK.
-	__set_PRIMASK(nBASEPRI);
+	__set_PRIMASK(nPRIMASK);
 
-	return (pAddress == pAddressEnd);
+	return bPass;
 }
 
+/*
+	Function:	RAMIntegrity_GetLockoutBudget()
+	Description:
+		Returns how long (in cycles) interrupts may be held off for a single chunk.
+		This is half a character time at the configured baud rate, so the UART
+		cannot overrun, capped at RAMINTEGRITY_LOCKOUT_MAX_US for the sake
+		of the other interrupts.
+*/
+static uint32_t RAMIntegrity_GetLockoutBudget(void)
+{
+	uint32_t nCyclesPerCharacter = (SystemCoreClock / Configuration_GetBaudRate()) * Configuration_GetMessageLength();
+	uint32_t nCyclesMax = (SystemCoreClock / 1000000) * RAMINTEGRITY_LOCKOUT_MAX_US;
+
+	return (nCyclesPerCharacter / 2 < nCyclesMax) ? (nCyclesPerCharacter / 2) : nCyclesMax;
+}
+
+/*
+	Function:	RAMIntegrity_Chunk()
+	Description:
+		Tests the next chunk of RAM, then sizes the following chunk so that
+		the time spent with interrupts disabled stays within the budget.
+		Each chunk overlaps its neighbours by one word, so that coupling
+		between the last word of a chunk and the first of the next is covered.
+		The DMA buffers are stepped over; no chunk reaches into them.
+		Returns false if the test failed.
+*/
+static bool RAMIntegrity_Chunk(void)
+{
+	uint32_t nBudget = RAMIntegrity_GetLockoutBudget();
+	uint32_t nRemainingWords;
+	uint32_t nWords;
+	uint32_t pStart;
+	uint32_t pEnd;
+	uint32_t * pBackup = &m_aRAMBackup[0];
+	uint32_t nCycles;
+	bool bPass;
+
+	//	Skip the DMA buffers, and stop short of them.
+	if (RAM_START + m_nRAMOffset >= RAM_DMA_START && RAM_START + m_nRAMOffset < RAM_DMA_END)
+	{
+		m_nRAMOffset = RAM_DMA_END - RAM_START;
+	}
+	pStart = RAM_START + m_nRAMOffset;
+	nRemainingWords = (((pStart < RAM_DMA_START) ? RAM_DMA_START : RAM_END) - pStart) / sizeof(uint32_t);
+	nWords = (m_nRAMChunkWords < nRemainingWords) ? m_nRAMChunkWords : nRemainingWords;
+	pEnd = pStart + (nWords * sizeof(uint32_t));
+
+	//	Overlap the neighbouring chunks, but not the DMA buffers.
+	pStart -= (pStart > RAM_START && pStart != RAM_DMA_END) ? sizeof(uint32_t) : 0;
+	pEnd += (pEnd < RAM_END && pEnd != RAM_DMA_START) ? sizeof(uint32_t) : 0;
+
+	//	Use the backup slot that the chunk doesn't touch.
+	if (pStart < (uint32_t) &pBackup[RAM_BACKUP_SLOT_WORDS] && (uint32_t) pBackup < pEnd)
+	{
+		pBackup = &m_aRAMBackup[2 * RAM_BACKUP_SLOT_WORDS];
+	}
+
+	nCycles = DIAGNOSTICS_CYCLES();
+	bPass = RAMIntegrity_Run((uint32_t *) pStart, (uint32_t *) pEnd, pBackup);
+	nCycles = DIAGNOSTICS_CYCLES() - nCycles;
+
+	if (nCycles > m_nRAMLockoutMax)
+	{
+		m_nRAMLockoutMax = nCycles;
+	}
+
+	//	Resize: scale straight down if over budget, creep back up if well under.
+	if (nCycles > nBudget)
+	{
+		m_nRAMChunkWords = (m_nRAMChunkWords * nBudget) / nCycles;
+	}
+	else if (nCycles < (nBudget - (nBudget / 4)))
+	{
+		m_nRAMChunkWords += 1;
+	}
+	m_nRAMChunkWords = (m_nRAMChunkWords < RAMINTEGRITY_CHUNK_MIN_WORDS) ? RAMINTEGRITY_CHUNK_MIN_WORDS : m_nRAMChunkWords;
+	m_nRAMChunkWords = (m_nRAMChunkWords > RAMINTEGRITY_CHUNK_MAX_WORDS) ? RAMINTEGRITY_CHUNK_MAX_WORDS : m_nRAMChunkWords;
+
+	//	Move on, wrapping around once the whole of RAM has been covered.
+	m_nRAMOffset += nWords * sizeof(uint32_t);
+	if (m_nRAMOffset >= RAM_SIZE_BYTES)
+	{
+		m_nRAMOffset = 0;
+		m_nRAMSweeps += 1;
+		m_eRAMIntegrityState = RAMINTEGRITY_IDLE;
+	}
+
+	return bPass;
+}
 
 /*
 	Function:	RAMIntegrity_Process()
 	Description:
 		Primary processing function for the RAMIntegrity module.
+		Tests chunks of RAM until RAMINTEGRITY_PASS_BUDGET_US has been used
+		up (always at least one). Upon startup, this is called until the
+		whole of RAM (bar the DMA buffers) has been checked once.
 */
 void RAMIntegrity_Process(void)
 {
-	//	I've decided to intentionally use these pointers as uint8_t *,
-	//	so that pointer arithmetic doesn't attempt to outsmart me.
-	uint8_t * pStart;
-	uint8_t * pEnd;
-	bool bSuccess = false;
-
-	switch(m_eRAMIntegrityState)
-	{
-		case RAMINTEGRITY_STARTUP:
-			//	Upon startup, the entirety of the RAM must be checked.
-			pStart = (uint8_t *) &_sdata;
-			pEnd = (uint8_t *) &_estack;
-			bSuccess = RAMIntegrity_Run( (uint32_t *) pStart, (uint32_t *) pEnd);
-			m_eRAMIntegrityState = RAMINTEGRITY_IDLE;
-			break;
-		case RAMINTEGRITY_IDLE:
-			//	In the IDLE state, whenever we're called, we'll check one page of
-			//	RAM at a time.
-			//	This is less time consuming than checking everything.
-			pStart = ((uint8_t *) &_sdata) + (m_nRAMChunk * RAM_PAGE_SIZE_BYTES);
-			pEnd = pStart + RAM_PAGE_SIZE_BYTES;
-			bSuccess = RAMIntegrity_Run( (uint32_t *) pStart, (uint32_t *) pEnd);
-
-			//	Increment the m_nRAMChunk or overflow back to zero if we've exceeded the limits.
-			m_nRAMChunk = ((m_nRAMChunk == RAM_PAGE_COUNT-1) ? 0 : m_nRAMChunk+1);
-			break;
+	uint32_t nStart = DIAGNOSTICS_CYCLES();
+	uint32_t nPassBudget = (SystemCoreClock / 1000000) * RAMINTEGRITY_PASS_BUDGET_US;
+	uint32_t nElapsed = 0;
+	uint32_t nChunk = 0;
+	bool bSuccess = true;
+
+	//	Keep going for as long as another chunk the size of the last one still fits.
+	do
+	{
+		uint32_t nChunkStart = DIAGNOSTICS_CYCLES();
+
+		bSuccess = RAMIntegrity_Chunk() && bSuccess;
+
+		nChunk = DIAGNOSTICS_CYCLES() - nChunkStart;
+		nElapsed = DIAGNOSTICS_CYCLES() - nStart;
 	}
+	while (bSuccess && (nElapsed + nChunk) <= nPassBudget);
 
 	if (!bSuccess)
 	{
@@ -170,6 +290,29 @@ void RAMIntegrity_Process(void)
 	}
 }
 
+/*
+	Function:	RAMIntegrity_GetLockoutMax()
+				RAMIntegrity_GetChunkWords()
+				RAMIntegrity_GetSweepCount()
+	Description:
+		Returns the longest time interrupts have been held off by the test
+		(in microseconds), the present chunk size (in words), and the number
+		of complete passes over RAM since power up.
+*/
+uint16_t RAMIntegrity_GetLockoutMax(void)
+{
+	uint32_t nValue = Diagnostics_CyclesToMicroseconds(m_nRAMLockoutMax);
+	return (nValue > UINT16_MAX) ? UINT16_MAX : (uint16_t) nValue;
+}
+uint16_t RAMIntegrity_GetChunkWords(void)
+{
+	return (uint16_t) m_nRAMChunkWords;
+}
+uint16_t RAMIntegrity_GetSweepCount(void)
+{
+	return m_nRAMSweeps;
+}
+
 /*
 	Function:	RAMIntegrity_StartupTasksComplete()
 	Description:
@@ -21,6 +21,13 @@
 #include "Fault.h"
 #include "EEPROM.h"
 #include "Configuration.h"
+#include "Diagnostics.h"
+#include "Journal.h"
+#include "EventQueue.h"
+#include "ADCCapture.h"
+#include "Scheduler.h"
+#include "Timebase.h"
+#include "Clock.h"
 
 //
 
@@ -35,6 +42,7 @@ typedef enum
   RELAY_INIT,
   RELAY_CR_WRITE,
   RELAY_CR_VERIFY,
+  RELAY_IDLE,
   RELAY_DR_WRITE,
   RELAY_DR_VERIFY,
 } RelayState_T;
@@ -42,19 +50,178 @@ typedef enum
 static RelayState_T    m_eRelayState = RELAY_INIT;
 
 // Requested relays from the user/MZ.
-static uint16_t    m_nRelayRequestMap;
+// Wider than a single word, so it is only ever updated with interrupts
+// masked; the fault reaction interrupt reads it too.
+static RelayMap_T    m_nRelayRequestMap;
 
 // Storage for the DR and CR of the DRV8860 to write out.
-static DRV8860_DataRegister_T       m_aDR[DRV8860_CNT] = {0};
-static DRV8860_ControlRegister_T    m_aCR[DRV8860_CNT] = {0};
+// m_aDR is the logical relay pattern (request | fault map),
+// m_aDRWrite is the same pattern as it appears on the wire (after the
+// failsafe inversion), and m_aDRWritten is the last pattern that was
+// actually clocked into the DRV8860s.
+static DRV8860_DataRegister_T       m_aDR[DRV8860_CNT]        = {0};
+static DRV8860_DataRegister_T       m_aDRWrite[DRV8860_CNT]   = {0};
+static bool                         m_bDRWriteFailsafe        = false;
+static DRV8860_DataRegister_T       m_aDRWritten[DRV8860_CNT] = {0};
+static bool                         m_bDRWritten              = false;
+static bool                         m_bDRWrittenFailsafe      = false;
+static DRV8860_ControlRegister_T    m_aCR[DRV8860_CNT]        = {0};
+
+// The relay states as last recorded in the journal and event queue.
+static RelayMap_T                   m_nRelayJournalMap        = 0;
 
 // Verify registers.
 // This is where we'll restore the actual state of things.
-DRV8860_ControlRegister_T    m_aCRVerify[DRV8860_CNT] = {0};
 DRV8860_DataRegister_T       m_aDRVerify[DRV8860_CNT] = {0};
 
 static uint8_t    m_nFaultCounter = 0;
 
+// Per-relay diagnostics, from the DRV8860 fault registers.
+// These are read back along with the DR during verification,
+// when DRV8860_READ_FAULT_REGISTERS is defined (see DRV8860.h);
+// without it, there's nothing to fill them, so they aren't offered.
+#ifdef DRV8860_READ_FAULT_REGISTERS
+static DRV8860_FaultRegister_T    m_aFR[DRV8860_CNT]     = {0};
+static RelayMap_T                 m_nRelayOpenLoadMap    = 0;
+static RelayMap_T                 m_nRelayOverCurrentMap = 0;
+#endif
+
+// Background verification timing.
+// The DRV8860s are only written when the effective pattern changes;
+// otherwise, the CR and DR are read back once every verify period,
+// which is kept with the rest of the configuration in the EEPROM.
+static uint32_t    m_nRelayVerifyTimestamp = 0;
+
+// Statistics.
+static uint16_t    m_nRelayWriteCount         = 0;
+static uint16_t    m_nRelayVerifyFailureCount = 0;
+
+// Command-to-actuation latency.
+// A request is timestamped (in cycles) when it arrives, and the time until
+// the new pattern is latched into the DRV8860s is recorded in a small ring
+// of samples, from which the percentiles are computed on demand.
+static bool        m_bRelayRequestPending = false;
+static uint32_t    m_nRelayRequestCycles  = 0;
+static uint16_t    m_aRelayLatency[RELAY_LATENCY_SAMPLES] = {0};
+static uint16_t    m_nRelayLatencyIndex   = 0;
+static uint16_t    m_nRelayLatencyCount   = 0;
+static uint16_t    m_nRelayLatencyMax     = 0;
+
+// Fault reaction.
+// Fault_Activate() pends a software interrupt that forces the fault pattern
+// out to the DRV8860s. The thread-level code holds m_bRelayBusy while it is
+// working with the DRV8860s or the DR buffers, in which case the interrupt
+// defers itself and is re-pended as soon as the thread lets go.
+static volatile bool        m_bRelayBusy                  = false;
+static volatile bool        m_bRelayFaultReactionPending  = false;
+static volatile bool        m_bRelayFaultEventTiming      = false;
+static volatile uint32_t    m_nRelayFaultEventCycles      = 0;
+static uint16_t             m_nRelayFaultReactionLast     = 0;
+static uint16_t             m_nRelayFaultReactionMax      = 0;
+
+// Fault line (R_FLT).
+// The DRV8860s pull it low as soon as any of them sees an open load or
+// over current. The edge raises FAULT_RELAY straight away, and queues a
+// verification, which clears it again once the line has been released.
+static volatile bool        m_bRelayFaultLinePending      = false;
+static volatile uint32_t    m_nRelayFaultLineCycles       = 0;
+static volatile uint32_t    m_nRelayFaultLineTimestamp    = 0;
+static uint16_t             m_nRelayFaultLineCount        = 0;
+static uint16_t             m_nRelayFaultLineReadback     = 0;
+
+/*
+   Function:  Relay_Init()
+   Description:
+    Configures the software interrupt used for the fault reaction.
+    It sits below the communication interrupts, so that no incoming
+    bytes are lost, but above everything running in the main loop.
+ */
+void Relay_Init(void)
+{
+  HAL_NVIC_SetPriority(RELAY_FAULT_REACTION_IRQn, RELAY_FAULT_REACTION_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(RELAY_FAULT_REACTION_IRQn);
+}
+
+/*
+   Function:  Relay_Acquire()
+              Relay_Release()
+   Description:
+    Brackets thread-level access to the DRV8860s and the DR buffers.
+    If a fault reaction was deferred while the bus was held, it is
+    re-pended on release and runs immediately afterwards.
+ */
+static void Relay_Acquire(void)
+{
+  m_bRelayBusy = true;
+}
+static void Relay_Release(void)
+{
+  m_bRelayBusy = false;
+
+  if (m_bRelayFaultReactionPending)
+  {
+    NVIC_SetPendingIRQ(RELAY_FAULT_REACTION_IRQn);
+  }
+}
+
+/*
+   Function:  Relay_RequestMap()
+   Description:
+    Requests the full relay map, one bit per relay (relay 1 in bit 0).
+    Bits beyond the relays present on this chain are rejected with
+    an ILLEGAL_DATA_VALUE exception.
+ */
+ModbusException_T Relay_RequestMap(RelayMap_T nMap)
+{
+  if (nMap & ~RELAY_MAP_ALL)
+  {
+    return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+  }
+
+  uint32_t    nPRIMASK = __get_PRIMASK();
+  __set_PRIMASK(1);
+  m_nRelayRequestMap = nMap;
+  __set_PRIMASK(nPRIMASK);
+
+  // Start the command-to-actuation clock.
+  m_nRelayRequestCycles  = DIAGNOSTICS_CYCLES();
+  m_bRelayRequestPending = true;
+  Clock_Demand(CLOCK_DEMAND_RELAY, true);
+  Scheduler_Post(SCHEDULER_EVENT_RELAY);
+
+  return MODBUS_EXCEPTION_OK;
+}
+
+/*
+   Function:  Relay_RequestWord()
+   Description:
+    Requests 16 relays at a time, leaving the others as they are.
+    nWord 0 covers relays 1-16, nWord 1 relays 17-32, and so on.
+    Words beyond the end of the chain do not exist.
+ */
+static ModbusException_T Relay_RequestWord(uint8_t nWord, uint16_t nPattern)
+{
+  if (nWord >= RELAY_MAP_WORDS)
+  {
+    return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+  }
+
+  RelayMap_T    nMask = (RelayMap_T) 0xFFFF << (16 * nWord);
+  RelayMap_T    nMap  = (m_nRelayRequestMap & ~nMask) | ((RelayMap_T) nPattern << (16 * nWord));
+
+  return Relay_RequestMap(nMap);
+}
+
+/*
+   Function:  Relay_GetWord()
+   Description:
+    Extracts 16 relays from a relay map, as above.
+ */
+static uint16_t Relay_GetWord(RelayMap_T nMap, uint8_t nWord)
+{
+  return (uint16_t) (nMap >> (16 * nWord));
+}
+
 /*
    Function:  Relay_Request()
    Description:
@@ -65,46 +232,73 @@ static uint8_t    m_nFaultCounter = 0;
     activated and what not.
     If the Heceta Relay Module is disabled, this will result in
     an ILLEGAL_DATA_ADDRESS exception.
+    Relay_Request() covers relays 1-16, and the _17_32 etc. variants
+    the following words of relays on longer chains.
  */
 ModbusException_T Relay_Request(uint16_t nPattern)
 {
-	m_nRelayRequestMap = nPattern;
-    return MODBUS_EXCEPTION_OK;
+  return Relay_RequestWord(0, nPattern);
+}
+ModbusException_T Relay_Request_17_32(uint16_t nPattern)
+{
+  return Relay_RequestWord(1, nPattern);
+}
+ModbusException_T Relay_Request_33_48(uint16_t nPattern)
+{
+  return Relay_RequestWord(2, nPattern);
+}
+ModbusException_T Relay_Request_49_64(uint16_t nPattern)
+{
+  return Relay_RequestWord(3, nPattern);
 }
 
 /*
    Function:  Relay_Set()
    Description:
-    Sets the relay values, given a 16-bit pattern.
+    Sets the relay values, given a relay map.
     Note that this occurs at the driver level, meaning the pattern
     requested here is the pattern that will be written.
  */
-static bool Relay_Set(uint16_t nPattern)
+static bool Relay_Set(RelayMap_T nPattern)
 {
-  // This code will take the a 16-bit pattern, and place it in the correct
-  // order within the DR registers.
-
-  // "A" registers
-  m_aDR[DRV8860_A] = (nPattern >> 0) & 0xFF;
-
-  // "B" registers
-  m_aDR[DRV8860_B] = (nPattern >> 8) & 0xFF;
+  // Each DRV8860 takes the next 8 relays, starting with the "A"
+  // device (relays 1-8), then "B" (relays 9-16), and so on down the chain.
+  for (int i = 0; i < DRV8860_CNT; i++)
+  {
+    m_aDR[i] = (nPattern >> (8 * i)) & 0xFF;
+  }
 
   return true;
 }
 
 /*
-   Function:  Relay_Process()
+   Function:  Relay_MapFromDR()
    Description:
-    Runs through the state machine, ensuring that the
-    values stored within the DRV8860s are expected.
+    The inverse of Relay_Set(); collects a set of DRs into a relay map.
  */
-void Relay_Process(void)
+static RelayMap_T Relay_MapFromDR(const DRV8860_DataRegister_T * aDR)
 {
-  DRV8860_DataRegister_T    m_aDR_temp[DRV8860_CNT] = {0};
+  RelayMap_T    nMap = 0;
 
-  // Component #1:  DR Contents Building
-  // Handles the generation of the DR contents.
+  for (int i = 0; i < DRV8860_CNT; i++)
+  {
+    nMap |= (RelayMap_T) aDR[i] << (8 * i);
+  }
+
+  return nMap;
+}
+
+/*
+   Function:  Relay_BuildDR()
+   Description:
+    Builds the DR contents from the requested relays and the fault
+    state of the system, followed by the on-the-wire version of the
+    DR with the failsafe inversion applied.
+    Returns true if the on-the-wire pattern differs from what was last
+    written to the DRV8860s, meaning a write is required.
+ */
+static bool Relay_BuildDR(void)
+{
   // The DR is generated based on the fault state of the system--
   // If the system is under fault, the fault relays are unconditionally
   // programmed to activate:
@@ -114,15 +308,299 @@ void Relay_Process(void)
 
   // Are in a fault state?
   // If we are, pull the Fault Register map from the EEPROM.
-  bool        bFaulted       = !Fault_OK();
-  uint16_t    nRelayFaultMap = bFaulted ? EEPROM_GetFaultRegisterMap() : 0;
+  bool          bFaulted       = !Fault_OK();
+  RelayMap_T    nRelayFaultMap = bFaulted ? EEPROM_GetFaultRegisterMap() : 0;
+
+  // The request can change under us from the Modbus interrupt,
+  // and a 64-bit map can't be read in one go.
+  uint32_t      nPRIMASK = __get_PRIMASK();
+  __set_PRIMASK(1);
+  RelayMap_T    nRequestMap = m_nRelayRequestMap;
+  __set_PRIMASK(nPRIMASK);
 
   // Build the result.
-  uint16_t    nResult = m_nRelayRequestMap | nRelayFaultMap;
+  RelayMap_T    nResult = (nRequestMap | nRelayFaultMap) & RELAY_MAP_ALL;
 
   // Set the relays.
   Relay_Set(nResult);
 
+  // invert sense of relays if failsafe mode is enabled
+  m_bDRWriteFailsafe = EEPROM_GetFailsafeRelayEnable();
+
+  for (int i = 0; i < DRV8860_CNT; i++)
+  {
+    m_aDRWrite[i] = m_bDRWriteFailsafe ? ~m_aDR[i] : m_aDR[i];
+  }
+
+  return !m_bDRWritten || memcmp(m_aDRWrite, m_aDRWritten, sizeof(m_aDRWritten));
+}
+
+/*
+   Function:  Relay_WriteDR()
+   Description:
+    Clocks the on-the-wire DR pattern out to the DRV8860s and
+    records it as the last written pattern.
+ */
+static void Relay_WriteDR(void)
+{
+  uint32_t    nStart = DIAGNOSTICS_CYCLES();
+
+  DRV8860_DataRegisterWrite(m_aDRWrite, DRV8860_CNT);
+  Diagnostics_HotPathRecord(DIAGNOSTICS_HOTPATH_DRV8860_WRITE, nStart);
+
+  memcpy(m_aDRWritten, m_aDRWrite, sizeof(m_aDRWritten));
+  m_bDRWrittenFailsafe = m_bDRWriteFailsafe;
+  m_bDRWritten         = true;
+  m_nRelayWriteCount++;
+
+  // Record the relays that changed, 16 to an entry in the journal,
+  // and one to an event in the event queue.
+  RelayMap_T    nMap     = Relay_MapFromDR(m_aDR);
+  RelayMap_T    nChanged = nMap ^ m_nRelayJournalMap;
+
+  for (uint8_t nWord = 0; nWord < RELAY_MAP_WORDS; nWord++)
+  {
+    if (Relay_GetWord(nChanged, nWord))
+    {
+      Journal_Log(JOURNAL_EVENT_RELAY_CHANGE, nWord, Relay_GetWord(nMap, nWord));
+    }
+  }
+
+  for (uint8_t nRelay = 0; nChanged; nRelay++, nChanged >>= 1)
+  {
+    if (nChanged & 1)
+    {
+      EventQueue_Post(EVENTQUEUE_TYPE_RELAY, (nMap >> nRelay) & 1, nRelay);
+    }
+  }
+  m_nRelayJournalMap = nMap;
+
+  // If this write is servicing a request, record how long it took.
+  if (m_bRelayRequestPending)
+  {
+    uint32_t    nLatency = Diagnostics_CyclesToMicroseconds(DIAGNOSTICS_CYCLES() - m_nRelayRequestCycles);
+    uint16_t    nSample  = (nLatency > UINT16_MAX) ? UINT16_MAX : (uint16_t) nLatency;
+
+    m_aRelayLatency[m_nRelayLatencyIndex] = nSample;
+    m_nRelayLatencyIndex                  = (m_nRelayLatencyIndex + 1) % RELAY_LATENCY_SAMPLES;
+
+    if (m_nRelayLatencyCount < UINT16_MAX)
+    {
+      m_nRelayLatencyCount++;
+    }
+
+    if (nSample > m_nRelayLatencyMax)
+    {
+      m_nRelayLatencyMax = nSample;
+    }
+
+    m_bRelayRequestPending = false;
+  }
+
+  // Likewise if it's the reaction to a fault being raised.
+  if (m_bRelayFaultEventTiming)
+  {
+    uint32_t    nLatency = Diagnostics_CyclesToMicroseconds(DIAGNOSTICS_CYCLES() - m_nRelayFaultEventCycles);
+
+    m_nRelayFaultReactionLast = (nLatency > UINT16_MAX) ? UINT16_MAX : (uint16_t) nLatency;
+
+    if (m_nRelayFaultReactionLast > m_nRelayFaultReactionMax)
+    {
+      m_nRelayFaultReactionMax = m_nRelayFaultReactionLast;
+    }
+
+    m_bRelayFaultEventTiming = false;
+  }
+}
+
+/*
+   Function:  Relay_FastPath()
+   Description:
+    Latches a newly requested pattern into the DRV8860s right away,
+    rather than waiting for the state machine to come back around to
+    RELAY_DR_WRITE. Called by the Modbus slave as soon as the response
+    to a request has been handed to the UART, so that the (interrupt
+    driven) response goes out on the wire while the DR is clocked out.
+    The write is followed by the usual readback verification.
+    This runs in the Modbus interrupt; if it has caught the main loop
+    in the middle of talking to the DRV8860s, the request is left to
+    Relay_Process(), which it has already been posted to.
+    The same goes for any state other than RELAY_IDLE: until the CR
+    has been written and verified, nothing is latched from here.
+ */
+void Relay_FastPath(void)
+{
+  // An armed transient capture is left to Relay_Process() to set up.
+  if (m_bRelayRequestPending && !m_bRelayBusy && m_eRelayState == RELAY_IDLE && !ADCCapture_Armed())
+  {
+    Relay_Acquire();
+
+    if (Relay_BuildDR())
+    {
+      Relay_WriteDR();
+      m_eRelayState = RELAY_DR_VERIFY;
+    }
+
+    // Either serviced, or nothing actually changed.
+    m_bRelayRequestPending = false;
+
+    Relay_Release();
+  }
+}
+
+/*
+   Function:  Relay_FaultEvent()
+   Description:
+    Called by the fault module whenever a new fault is raised.
+    Starts the fault-to-output clock and pends the fault reaction
+    interrupt. Safe to call from any context.
+ */
+void Relay_FaultEvent(void)
+{
+  if (!m_bRelayFaultEventTiming)
+  {
+    m_nRelayFaultEventCycles = DIAGNOSTICS_CYCLES();
+    m_bRelayFaultEventTiming = true;
+  }
+
+  m_bRelayFaultReactionPending = true;
+  NVIC_SetPendingIRQ(RELAY_FAULT_REACTION_IRQn);
+}
+
+/*
+   Function:  Relay_FaultReactionProcess()
+   Description:
+    Body of the fault reaction interrupt.
+    Rebuilds the DR with the fault relays applied and latches it
+    immediately, unless the main loop is in the middle of talking to the
+    DRV8860s, in which case this runs again as soon as it's done.
+    Until the CR has been written and verified (RELAY_IDLE), and the
+    configuration with the fault relay map and failsafe setting has been
+    loaded, nothing is latched from here; the fault pattern is left to
+    Relay_Process(), which writes it out as soon as it gets to the DR.
+ */
+void Relay_FaultReactionProcess(void)
+{
+  if (m_bRelayBusy)
+  {
+    // Deferred; Relay_Release() will pend us again.
+    return;
+  }
+
+  m_bRelayFaultReactionPending = false;
+
+  if (m_eRelayState != RELAY_IDLE || !EEPROM_Ready())
+  {
+    Scheduler_Post(SCHEDULER_EVENT_RELAY);
+    return;
+  }
+
+  if (Relay_BuildDR())
+  {
+    Relay_WriteDR();
+    m_eRelayState = RELAY_DR_VERIFY;
+    Scheduler_Post(SCHEDULER_EVENT_RELAY);
+  }
+  else
+  {
+    // Nothing to drive (e.g. an empty fault relay map,
+    // or the fault relays were already active).
+    m_bRelayFaultEventTiming = false;
+  }
+}
+
+/*
+   Function:  HAL_GPIO_EXTI_Callback()
+   Description:
+    Falling edge of the DRV8860 fault line.
+    Timestamps the event, raises FAULT_RELAY (which drives the fault
+    relays through the fault reaction), and has Relay_Process() read the
+    fault registers back at its next pass.
+ */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if (GPIO_Pin == R_FLT_Pin)
+  {
+    m_nRelayFaultLineCycles    = DIAGNOSTICS_CYCLES();
+    m_nRelayFaultLineTimestamp = uwTick;
+    m_bRelayFaultLinePending   = true;
+
+    if (m_nRelayFaultLineCount < UINT16_MAX)
+    {
+      m_nRelayFaultLineCount++;
+    }
+
+    Fault_Activate(FAULT_RELAY);
+    Scheduler_Post(SCHEDULER_EVENT_RELAY);
+  }
+}
+
+/*
+   Function:  Relay_UpdateDiagnostics()
+   Description:
+    Reads the fault registers back, rewriting the DR with what was last
+    written, and sorts them into open load and over current maps (one
+    bit per relay). FAULT_RELAY is raised while any relay reports either,
+    or while the DR read back doesn't match (bMismatch).
+    Without DRV8860_READ_FAULT_REGISTERS (see DRV8860.h), the fault line
+    stands in for the fault registers; the DRV8860s hold it low while
+    any of them sees a fault.
+ */
+static void Relay_UpdateDiagnostics(bool bMismatch)
+{
+#ifdef DRV8860_READ_FAULT_REGISTERS
+  RelayMap_T    nOpenLoad    = 0;
+  RelayMap_T    nOverCurrent = 0;
+
+  DRV8860_DataRegisterWriteFaultRead(m_aDRWritten, m_aFR, DRV8860_CNT);
+
+  for (int i = 0; i < DRV8860_CNT; i++)
+  {
+    nOpenLoad    |= (RelayMap_T) (m_aFR[i] & DRV8860_FR_OL_MASK) << (8 * i);
+    nOverCurrent |= (RelayMap_T) ((m_aFR[i] >> DRV8860_FR_OCP_SHIFT) & 0xFF) << (8 * i);
+  }
+
+  m_nRelayOpenLoadMap    = nOpenLoad;
+  m_nRelayOverCurrentMap = nOverCurrent;
+
+  Fault_Set(FAULT_RELAY, bMismatch || (nOpenLoad | nOverCurrent) != 0);
+#else
+  bool    bFaultLine = DRV8860_PIN_FLT();
+
+  Fault_Set(FAULT_RELAY, bMismatch || !bFaultLine);
+#endif
+}
+
+/*
+   Function:  Relay_Process()
+   Description:
+    Runs through the state machine, ensuring that the
+    values stored within the DRV8860s are expected.
+    The DR is only written out when the effective pattern changes.
+    The CR and DR are otherwise read back and verified once every
+    verify period, and any mismatch forces an immediate rewrite.
+ */
+void Relay_Process(void)
+{
+  DRV8860_DataRegister_T    m_aDR_temp[DRV8860_CNT] = {0};
+  DRV8860_ControlRegister_T aCRVerify[DRV8860_CNT]  = {0};
+  bool                      bFaultLine              = false;
+  bool                      bMismatch               = false;
+  uint32_t                  nStart;
+
+  Relay_Acquire();
+
+  // Component #1:  DR Contents Building
+  // Handles the generation of the DR contents, and determines
+  // whether or not they need to be written out.
+  bool    bDirty = Relay_BuildDR();
+
+  // A request that doesn't change the outputs needs no actuation.
+  if (!bDirty)
+  {
+    m_bRelayRequestPending = false;
+  }
+
   // Component #2:  State Machine Processing
   // Handles the actual verification/write process
   // of the state machines.
@@ -144,66 +622,100 @@ void Relay_Process(void)
     case RELAY_CR_VERIFY:
       // Read in the present control register,
       // and verify that it matches what we expect.
-      DRV8860_ControlRegisterRead(m_aCRVerify, DRV8860_CNT);
+      DRV8860_ControlRegisterRead(aCRVerify, DRV8860_CNT);
 
-      if (!memcmp(m_aCRVerify, m_aCR, sizeof(DRV8860_ControlRegister_T) * DRV8860_CNT))
+      if (!memcmp(aCRVerify, m_aCR, sizeof(DRV8860_ControlRegister_T) * DRV8860_CNT))
       {
         // Clear.
+        // If the DR has never been written, or it's out of date,
+        // write it now. Otherwise, continue on to verify it.
         m_nFaultCounter = 0;
-        m_eRelayState   = RELAY_DR_WRITE;
+        m_eRelayState   = bDirty ? RELAY_DR_WRITE : RELAY_DR_VERIFY;
       }
       else
       {
         m_nFaultCounter++;
+        m_nRelayVerifyFailureCount++;
         m_eRelayState = RELAY_CR_WRITE;
       }
       break;
 
+    case RELAY_IDLE:
+      // Nothing to do unless the pattern has changed,
+      // or it's time for the background verification.
+      if (bDirty)
+      {
+        m_eRelayState = RELAY_DR_WRITE;
+      }
+      else if (m_bRelayFaultLinePending)
+      {
+        m_eRelayState = RELAY_DR_VERIFY;
+      }
+      else if (Timebase_ElapsedMilliseconds(m_nRelayVerifyTimestamp, Relay_GetVerifyPeriod()))
+      {
+        m_eRelayState = RELAY_CR_VERIFY;
+      }
+      break;
+
     case RELAY_DR_WRITE:
       // As defined in the nDR, write out
       // the data register configuration.
-
-      // invert sense of relays if failsafe mode is abled
-	  if (EEPROM_GetFailsafeRelayEnable())
+      // If a transient capture is armed, it's started first,
+      // so that it sees the supply on both sides of the write.
+      if (ADCCapture_Start())
       {
-        m_aDR_temp[DRV8860_A] = ~m_aDR[DRV8860_A];
-        m_aDR_temp[DRV8860_B] = ~m_aDR[DRV8860_B];
+        Relay_WriteDR();
+        ADCCapture_Trigger();
       }
       else
       {
-        m_aDR_temp[DRV8860_A] = m_aDR[DRV8860_A];
-        m_aDR_temp[DRV8860_B] = m_aDR[DRV8860_B];
+        Relay_WriteDR();
       }
-
-      DRV8860_DataRegisterWrite(m_aDR_temp, DRV8860_CNT);
       m_eRelayState = RELAY_DR_VERIFY;
       break;
 
     case RELAY_DR_VERIFY:
+      // The fault state is checked along with the DR.
+      // This also serves any edge on the fault line seen up to now.
+      bFaultLine               = m_bRelayFaultLinePending;
+      m_bRelayFaultLinePending = false;
+
+      nStart = DIAGNOSTICS_CYCLES();
       DRV8860_DataRegisterRead(m_aDR_temp, DRV8860_CNT);
+      Diagnostics_HotPathRecord(DIAGNOSTICS_HOTPATH_DRV8860_READ, nStart);
+
+      // Compare what's on the wire with what was last written.
+      bMismatch = memcmp(m_aDR_temp, m_aDRWritten, sizeof(DRV8860_DataRegister_T) * DRV8860_CNT) != 0;
+      Relay_UpdateDiagnostics(bMismatch);
 
-      // invert sense of relays if failsafe mode is abled
-      if (EEPROM_GetFailsafeRelayEnable())
+      if (bFaultLine)
       {
-        m_aDRVerify[DRV8860_A] = ~m_aDR_temp[DRV8860_A];
-        m_aDRVerify[DRV8860_B] = ~m_aDR_temp[DRV8860_B];
+        uint32_t    nLatency = Diagnostics_CyclesToMicroseconds(DIAGNOSTICS_CYCLES() - m_nRelayFaultLineCycles);
+
+        m_nRelayFaultLineReadback = (nLatency > UINT16_MAX) ? UINT16_MAX : (uint16_t) nLatency;
       }
-      else
+
+      // Report the relay state with the failsafe inversion removed.
+      for (int i = 0; i < DRV8860_CNT; i++)
       {
-        m_aDRVerify[DRV8860_A] = m_aDR_temp[DRV8860_A];
-        m_aDRVerify[DRV8860_B] = m_aDR_temp[DRV8860_B];
+        m_aDRVerify[i] = m_bDRWrittenFailsafe ? ~m_aDR_temp[i] : m_aDR_temp[i];
       }
 
-      if (!memcmp(m_aDRVerify, m_aDR, sizeof(DRV8860_DataRegister_T) * DRV8860_CNT))
+      if (!bMismatch)
       {
         // Clear.
-        m_nFaultCounter = 0;
-        m_eRelayState   = RELAY_CR_VERIFY;
+        m_nFaultCounter         = 0;
+        m_nRelayVerifyTimestamp = uwTick;
+        m_eRelayState           = RELAY_IDLE;
       }
       else
       {
+        // The DRV8860s don't hold what we think they do.
+        // Rewrite them immediately, then check again.
         m_nFaultCounter++;
-        m_eRelayState = RELAY_DR_WRITE;
+        m_nRelayVerifyFailureCount++;
+        Relay_BuildDR();
+        Relay_WriteDR();
       }
       break;
 
@@ -211,6 +723,173 @@ void Relay_Process(void)
       m_eRelayState = RELAY_INIT;
       break;
   }
+
+  // Keep stepping through the state machine until it's back to idle.
+  if (m_eRelayState != RELAY_IDLE)
+  {
+    Scheduler_Post(SCHEDULER_EVENT_RELAY);
+  }
+
+  // Run at the high clock until the new pattern is out and verified.
+  Clock_Demand(CLOCK_DEMAND_RELAY, m_eRelayState != RELAY_IDLE || m_bRelayRequestPending);
+
+  Relay_Release();
+}
+
+/*
+   Function:  Relay_SetVerifyPeriod()
+              Relay_GetVerifyPeriod()
+   Description:
+    Sets or returns the period, in milliseconds, at which the
+    CR and DR are read back and verified while idle.
+    A stored period that is out of range (or zero, as written by older
+    firmware, or before the EEPROM is ready) reads as the default.
+ */
+ModbusException_T Relay_SetVerifyPeriod(uint16_t nPeriod)
+{
+  ModbusException_T    eReturn = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+
+  if (nPeriod >= RELAY_VERIFY_PERIOD_MS_MIN && nPeriod <= RELAY_VERIFY_PERIOD_MS_MAX)
+  {
+    EEPROM_SetRelayVerifyPeriod(nPeriod);
+    eReturn = MODBUS_EXCEPTION_OK;
+  }
+
+  return eReturn;
+}
+uint16_t Relay_GetVerifyPeriod(void)
+{
+  uint16_t    nPeriod = EEPROM_GetRelayVerifyPeriod();
+
+  if (nPeriod < RELAY_VERIFY_PERIOD_MS_MIN || nPeriod > RELAY_VERIFY_PERIOD_MS_MAX)
+  {
+    nPeriod = RELAY_VERIFY_PERIOD_MS_DEFAULT;
+  }
+
+  return nPeriod;
+}
+
+/*
+   Function:  Relay_GetWriteCount()
+              Relay_GetVerifyFailureCount()
+   Description:
+    Returns the number of DR writes issued to the DRV8860s, and the
+    number of CR/DR readbacks that did not match, since power up.
+ */
+uint16_t Relay_GetWriteCount(void)
+{
+  return m_nRelayWriteCount;
+}
+uint16_t Relay_GetVerifyFailureCount(void)
+{
+  return m_nRelayVerifyFailureCount;
+}
+
+/*
+   Function:  Relay_GetLatencyPercentile()
+   Description:
+    Returns the requested percentile (0-100) of the most recent
+    command-to-actuation latency samples, in microseconds.
+ */
+static uint16_t Relay_GetLatencyPercentile(uint8_t nPercentile)
+{
+  uint16_t    aSorted[RELAY_LATENCY_SAMPLES];
+  uint16_t    nSamples = (m_nRelayLatencyCount < RELAY_LATENCY_SAMPLES) ? m_nRelayLatencyCount : RELAY_LATENCY_SAMPLES;
+
+  if (nSamples == 0)
+  {
+    return 0;
+  }
+
+  // Insertion sort; the sample ring is small.
+  for (int i = 0; i < nSamples; i++)
+  {
+    uint16_t    nValue = m_aRelayLatency[i];
+    int         j      = i;
+
+    while (j > 0 && aSorted[j - 1] > nValue)
+    {
+      aSorted[j] = aSorted[j - 1];
+      j--;
+    }
+    aSorted[j] = nValue;
+  }
+
+  // Nearest-rank method.
+  uint16_t    nRank = (nPercentile * nSamples + 99) / 100;
+
+  return aSorted[(nRank > 0) ? (nRank - 1) : 0];
+}
+
+/*
+   Function:  Relay_GetLatencyP50()
+              Relay_GetLatencyP90()
+              Relay_GetLatencyP99()
+              Relay_GetLatencyMax()
+              Relay_GetLatencyCount()
+   Description:
+    Command-to-actuation latency statistics, in microseconds.
+    The percentiles cover the last RELAY_LATENCY_SAMPLES requests,
+    the maximum and the count cover everything since power up.
+ */
+uint16_t Relay_GetLatencyP50(void)
+{
+  return Relay_GetLatencyPercentile(50);
+}
+uint16_t Relay_GetLatencyP90(void)
+{
+  return Relay_GetLatencyPercentile(90);
+}
+uint16_t Relay_GetLatencyP99(void)
+{
+  return Relay_GetLatencyPercentile(99);
+}
+uint16_t Relay_GetLatencyMax(void)
+{
+  return m_nRelayLatencyMax;
+}
+uint16_t Relay_GetLatencyCount(void)
+{
+  return m_nRelayLatencyCount;
+}
+
+/*
+   Function:  Relay_GetFaultReactionLast()
+              Relay_GetFaultReactionMax()
+   Description:
+    Time from a fault being raised to the fault pattern being
+    latched into the DRV8860s, in microseconds.
+ */
+uint16_t Relay_GetFaultReactionLast(void)
+{
+  return m_nRelayFaultReactionLast;
+}
+uint16_t Relay_GetFaultReactionMax(void)
+{
+  return m_nRelayFaultReactionMax;
+}
+
+/*
+   Function:  Relay_GetFaultLineCount()
+              Relay_GetFaultLineTimestamp()
+              Relay_GetFaultLineReadback()
+   Description:
+    Returns the number of edges seen on the DRV8860 fault line since
+    power up, the uptime (in minutes) of the last one, and the time from
+    it to the fault registers being read back, in microseconds.
+    In minutes, the uptime only wraps after about 45 days.
+ */
+uint16_t Relay_GetFaultLineCount(void)
+{
+  return m_nRelayFaultLineCount;
+}
+uint16_t Relay_GetFaultLineTimestamp(void)
+{
+  return (uint16_t) (m_nRelayFaultLineTimestamp / 60000);
+}
+uint16_t Relay_GetFaultLineReadback(void)
+{
+  return m_nRelayFaultLineReadback;
 }
 
 void Relay_Run_Demo()
@@ -219,14 +898,137 @@ void Relay_Run_Demo()
   toggleFlag   = TRUE;
 }
 
+/*
+   Function:  Relay_GetRequestMap()
+              Relay_GetMap()
+              Relay_GetFaultedMap()
+   Description:
+    Returns the relays requested, the relays as last read back from
+    the DRV8860s, and the relays whose read back state differs from
+    what is being driven.
+ */
+RelayMap_T Relay_GetRequestMap(void)
+{
+  return m_nRelayRequestMap;
+}
+RelayMap_T Relay_GetMap(void)
+{
+  return Relay_MapFromDR(m_aDRVerify);
+}
+RelayMap_T Relay_GetFaultedMap(void)
+{
+  return Relay_MapFromDR(m_aDRVerify) ^ Relay_MapFromDR(m_aDR);
+}
+
 uint16_t Relay_Get(void)
 {
-  return (uint16_t) ((m_aDRVerify[DRV8860_B] << 8) | m_aDRVerify[DRV8860_A]);
+  return Relay_GetWord(Relay_GetMap(), 0);
+}
+uint16_t Relay_Get_17_32(void)
+{
+  return Relay_GetWord(Relay_GetMap(), 1);
+}
+uint16_t Relay_Get_33_48(void)
+{
+  return Relay_GetWord(Relay_GetMap(), 2);
+}
+uint16_t Relay_Get_49_64(void)
+{
+  return Relay_GetWord(Relay_GetMap(), 3);
 }
 
 uint16_t Relay_GetFaulted(void)
 {
-  return ((uint16_t) ((m_aDRVerify[DRV8860_B] << 8) | m_aDRVerify[DRV8860_A]) ^ (uint16_t) ((m_aDR[DRV8860_B] << 8) | m_aDR[DRV8860_A]));
+  return Relay_GetWord(Relay_GetFaultedMap(), 0);
+}
+uint16_t Relay_GetFaulted_17_32(void)
+{
+  return Relay_GetWord(Relay_GetFaultedMap(), 1);
+}
+uint16_t Relay_GetFaulted_33_48(void)
+{
+  return Relay_GetWord(Relay_GetFaultedMap(), 2);
+}
+uint16_t Relay_GetFaulted_49_64(void)
+{
+  return Relay_GetWord(Relay_GetFaultedMap(), 3);
+}
+
+#ifdef DRV8860_READ_FAULT_REGISTERS
+/*
+   Function:  Relay_GetOpenLoadMap()
+              Relay_GetOverCurrentMap()
+   Description:
+    Relays reporting open load or over current, as of the last
+    verification. Also exposed 16 relays to a register, as above.
+ */
+RelayMap_T Relay_GetOpenLoadMap(void)
+{
+  return m_nRelayOpenLoadMap;
+}
+RelayMap_T Relay_GetOverCurrentMap(void)
+{
+  return m_nRelayOverCurrentMap;
+}
+
+uint16_t Relay_GetOpenLoad(void)
+{
+  return Relay_GetWord(m_nRelayOpenLoadMap, 0);
+}
+uint16_t Relay_GetOpenLoad_17_32(void)
+{
+  return Relay_GetWord(m_nRelayOpenLoadMap, 1);
+}
+uint16_t Relay_GetOpenLoad_33_48(void)
+{
+  return Relay_GetWord(m_nRelayOpenLoadMap, 2);
+}
+uint16_t Relay_GetOpenLoad_49_64(void)
+{
+  return Relay_GetWord(m_nRelayOpenLoadMap, 3);
+}
+
+uint16_t Relay_GetOverCurrent(void)
+{
+  return Relay_GetWord(m_nRelayOverCurrentMap, 0);
+}
+uint16_t Relay_GetOverCurrent_17_32(void)
+{
+  return Relay_GetWord(m_nRelayOverCurrentMap, 1);
+}
+uint16_t Relay_GetOverCurrent_33_48(void)
+{
+  return Relay_GetWord(m_nRelayOverCurrentMap, 2);
+}
+uint16_t Relay_GetOverCurrent_49_64(void)
+{
+  return Relay_GetWord(m_nRelayOverCurrentMap, 3);
+}
+#endif
+
+/*
+   Function:  Relay_GetCoil()
+              Relay_SetCoil()
+   Description:
+    Single relay access for the Modbus coils.
+    nRelay is zero based (relay 1 is nRelay 0).
+    Reading returns the relay state as read back from the DRV8860s,
+    writing changes the request for that relay only.
+ */
+bool Relay_GetCoil(uint16_t nRelay)
+{
+  return (nRelay < RELAY_COUNT) && ((Relay_GetMap() >> nRelay) & 1);
+}
+ModbusException_T Relay_SetCoil(uint16_t nRelay, bool bState)
+{
+  if (nRelay >= RELAY_COUNT)
+  {
+    return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+  }
+
+  RelayMap_T    nMask = (RelayMap_T) 1 << nRelay;
+
+  return Relay_RequestMap(bState ? (m_nRelayRequestMap | nMask) : (m_nRelayRequestMap & ~nMask));
 }
 
 void Relay_Set_CommRelay(_Bool state)
@@ -15,6 +15,8 @@
 #include <string.h>
 #include "main.h"
 #include "SPIFlash.h"
+#include "Scheduler.h"
+#include "Clock.h"
 #include "stm32l4xx_hal.h"
 
 static const uint8_t m_nWREN = Write_Enable_WREN;    //	A 1 byte command buffer
@@ -30,33 +32,43 @@ static const uint8_t m_nRDSR = Read_Status_Register_RDSR;    //	A 1 byte command
 //	For this implementation, I've chosen instead to use a dynamic SPIStep buffer that can
 //	be "set-up" and used as requested by the SPIFlash driver.
 //	There are numerous "helper" generator steps that can be called by the main generators.
+//
+//	The steps for the request at the head of the queue are generated here by
+//	SPIFlash_Process(), one chunk (a page write, a status poll, a read) at a time.
+//	Once the first step has been kicked off, the DMA completion interrupt
+//	chains straight on to the following steps, and only flags the main loop
+//	once the whole chunk has gone out.
 static SPIStep_T m_aSPIStep[SPIFLASH_MAX_STEPS] = {0};
-static int m_nSPIStepIndex = 0;
-static void (*m_pSPIPostOperationFunc)(void *) = NULL;
-static void * m_pSPIPostOperationFuncArgs = NULL;
+static volatile int m_nSPIStepIndex = 0;
+static int m_nSPIStepCount = 0;
+static volatile bool m_bSPIStepsComplete = false;
+static volatile bool m_bSPIStepsFailed = false;
+
+//	Request queue.
+//	Only touched from the main loop, so no locking is needed.
+static SPIFlash_Request_T * m_pSPIQueueHead = NULL;
+static SPIFlash_Request_T * m_pSPIQueueTail = NULL;
+static SPIFlash_Request_T * m_pSPIActive = NULL;
 
 //	State of SPIFlash_T
 static SPIFlash_State_T m_eSPIFlashState = SPIFLASH_STATE_IDLE;
-static bool m_bSPIOperationInProgress = false;
-
-//	Write status
-static SPIWriteStatus_T m_sSPIWriteStatus = {0};
 
 //	Status register
-static uint8_t m_nSR = {0};
+static uint8_t m_nSR DMA_BUFFER = 0;
 
 //	Command buffer, location of where the command bytes are stored.
 //	Note that not all fields of this command buffer will be used for all commands.
 //	In the format of:	[Byte 0 (OPCODE)] [Byte 1 (UpperAddr)] [Byte 2 (LowerAddr)]
-static uint8_t m_aCommandBuffer[3] = {0};
+static uint8_t m_aCommandBuffer[3] DMA_BUFFER = {0};
 
 //	Debug code
 //	#define DEBUG_SPIFLASH_CONSTANT_READS_AND_WRITES
 #ifdef DEBUG_SPIFLASH_CONSTANT_READS_AND_WRITES
 #define DEBUG_SPIFLASH_BUFFER_SIZE (128)
 	static uint16_t nInternalCounter = 0;
-	static uint8_t aExpectedContentsBuffer[DEBUG_SPIFLASH_BUFFER_SIZE] = {0};
-	static uint8_t aTestBuffer[DEBUG_SPIFLASH_BUFFER_SIZE] = {0};
+	static uint8_t aExpectedContentsBuffer[DEBUG_SPIFLASH_BUFFER_SIZE] DMA_BUFFER = {0};
+	static uint8_t aTestBuffer[DEBUG_SPIFLASH_BUFFER_SIZE] DMA_BUFFER = {0};
+	static SPIFlash_Request_T sTestRequest = {0};
 #endif
 
 /*
@@ -180,379 +192,411 @@ bool SPIStep_ReadStatusRegister(SPIStep_T * pStep)
 	Category:	SPIFlash Operation Functions
 	Description:
 		The following are SPIFlash Operation functions. They use the
-		SPIStep_T helper functions to generate a complete list of steps
-		used for their corresponding functions.
+		SPIStep_T helper functions to generate the steps for each chunk
+		of the request presently being serviced.
 	-----------------------------------------------------------------------
 */
 
 /*
-	Function:	SPIStep_IsFree()
+	Function:	SPIFlash_Init()
+				SPIFlash_UpdateClock()
 	Description:
-		Determines whether or not the SPIStep / SPI bus is free, based on
-		a simple memory compare of the entire range to zero.
+		Sets the SPI1 prescaler so that SCK runs as fast as the
+		CAT25320 allows, given the present APB2 clock.
+		Must be called again if the system clock changes.
 */
-bool SPIFlash_IsFree(void)
+void SPIFlash_Init(void)
 {
-	//	Boolean value, assumes that we are okay until otherwise determined.
-	bool bFree = true;
-
-	//	Pointer to the SPIStep_T structure
-	uint8_t * pBuffer = (uint8_t *) &m_aSPIStep[0];
-
-	//	Counters
-	uint32_t nTotal = sizeof(m_aSPIStep);
-	uint32_t nCntr = 0;
+	SPIFlash_UpdateClock();
+	HAL_GPIO_WritePin(EE_CS_GPIO_Port, EE_CS_Pin, GPIO_PIN_SET);
+}
+void SPIFlash_UpdateClock(void)
+{
+	SPI_HandleTypeDef * pSPI = Main_Get_SPI_Handle();
+	uint32_t nPCLK = HAL_RCC_GetPCLK2Freq();
+	uint32_t nBR = 0;
 
-	//	Check
-	for (nCntr = 0; nCntr < nTotal; nCntr++)
+	//	BR = n divides by 2^(n+1); /2 up to /256.
+	while (nBR < 7 && (nPCLK >> (nBR + 1)) > SPIFLASH_MAX_CLOCK_HZ)
 	{
-		if (pBuffer[nCntr] != 0x00)
-		{
-			bFree = false;
-			break;
-		}
+		nBR++;
 	}
 
-	return bFree;
+	pSPI->Init.BaudRatePrescaler = (nBR << SPI_CR1_BR_Pos);
+
+	__HAL_SPI_DISABLE(pSPI);
+	MODIFY_REG(pSPI->Instance->CR1, SPI_CR1_BR, pSPI->Init.BaudRatePrescaler);
 }
 
 /*
-	Function:	SPIFlash_WriteHelper
+	Function:	SPIFlash_Submit()
 	Description:
-		The responsibility of this function is to set up the SPIFlash write steps
-		based on the parameters defined in the SPIWriteStatus_T structure.
-
-		It will also set up the complete callback step.
+		Adds a request to the end of the queue.
+		Fails if the request is already queued/in progress, or asks for
+		something outside of the flash. Main loop only.
 */
-void SPIFlash_WriteHelper(void * pArgs)
+bool SPIFlash_Submit(SPIFlash_Request_T * pRequest)
 {
-	SPIWriteStatus_T * pSPIWriteStatus = (SPIWriteStatus_T *) pArgs;
+	if (	(pRequest == NULL) ||
+			(pRequest->eState != SPIFLASH_REQUEST_IDLE) ||
+			(pRequest->pBuffer == NULL) ||
+			(pRequest->nSize == 0) ||
+			((uint32_t) pRequest->nAddress + pRequest->nSize > SPIFLASH_CHIP_SIZE))
+	{
+		return false;
+	}
 
-	//	The number of bytes of which will actually get written during this SPI write command.
-	uint32_t nByteCount = (pSPIWriteStatus->nPageOffset + pSPIWriteStatus->nBytesLeft <= SPIFLASH_PAGE_SIZE) ? pSPIWriteStatus->nBytesLeft : (SPIFLASH_PAGE_SIZE - pSPIWriteStatus->nPageOffset);
+	pRequest->bSuccess = false;
+	pRequest->nBytesDone = 0;
+	pRequest->pNext = NULL;
+	pRequest->eState = SPIFLASH_REQUEST_QUEUED;
 
-	//	Before the next write is permitted to occur-- it is required that the
-	//	SR busy bit is set to zero.
-	//	This is to ensure that we don't step on anyone's toes as they're attempting
-	//	to write out data.
-	if (m_nSR & SPIFLASH_RDSR_BUSY_BIT)
+	if (m_pSPIQueueTail == NULL)
 	{
-		//	Something else is in progress.
-		//	Let's come back later after we re-read the SR register.
-		SPIStep_ReadStatusRegister(&m_aSPIStep[0]);
-
-		//	Don't touch the write status.
-		m_pSPIPostOperationFunc = SPIFlash_WriteHelper;
-		m_pSPIPostOperationFuncArgs = pSPIWriteStatus;
+		m_pSPIQueueHead = pRequest;
 	}
 	else
 	{
-		//	Are we done?
-		if (nByteCount > 0)
-		{
-			//	Not quite yet.
-			SPIStep_WriteEnable(&m_aSPIStep[0], true);
-			SPIStep_CommandAddress(&m_aSPIStep[1], Page_Program_PP, pSPIWriteStatus->nPage, pSPIWriteStatus->nPageOffset);
-			SPIStep_Write(&m_aSPIStep[2], pSPIWriteStatus->pBuffer, pSPIWriteStatus->nPage, pSPIWriteStatus->nPageOffset, nByteCount);
-			m_aSPIStep[2].bSetCSHigh = true;
-			SPIStep_ReadStatusRegister(&m_aSPIStep[3]);
-
-			//	Adjust the write status for the next operation.
-			pSPIWriteStatus->pBuffer = &pSPIWriteStatus->pBuffer[nByteCount];
-			pSPIWriteStatus->nPage = pSPIWriteStatus->nPage + 1;
-			pSPIWriteStatus->nPageOffset = (pSPIWriteStatus->nPageOffset + nByteCount) % SPIFLASH_PAGE_SIZE;
-			pSPIWriteStatus->nBytesLeft -= nByteCount;
-
-			m_pSPIPostOperationFunc = SPIFlash_WriteHelper;
-			m_pSPIPostOperationFuncArgs = pSPIWriteStatus;
-		}
+		m_pSPIQueueTail->pNext = pRequest;
 	}
+	m_pSPIQueueTail = pRequest;
+	Clock_Demand(CLOCK_DEMAND_SPIFLASH, true);
 
-
-
-
+	return true;
 }
 
-
 /*
-	Function:	SPIFlash_Write()
+	Function:	SPIFlash_Read()
+				SPIFlash_Write()
 	Description:
-		Kickstarts the process of writing a buffer to the flash.
-		Note that this supports writing across page boundaries.
+		Convenience functions that fill in a request without a
+		callback, and submit it. The caller can then keep an eye on
+		it with SPIFlash_RequestBusy().
+		Writes may cross page boundaries.
 */
-bool SPIFlash_Write(uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize)
+static bool SPIFlash_SubmitSimple(SPIFlash_Request_T * pRequest, SPIFlash_Operation_T eOperation, uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize)
 {
-	//	Boolean value, returning the success or failure of this function
-	//	Until deemed otherwise, we must assume that this function will fail.
-	bool bReturn = false;
-
-	//	Determine if the SPIStep_T is in use.
-	bool bSPIStepsClear = SPIFlash_IsFree();
-
-	//	Determine if the criteria for actually setting this up has passed
-	//	Note that the third check, regarding nPageOffset has changed from its PageWrite equivalent.
-	if ( (pBuffer != NULL) &&
-			(nPage < SPIFLASH_PAGE_COUNT) &&
-				(  (nPageOffset) < SPIFLASH_PAGE_SIZE) &&
-					bSPIStepsClear)
+	if (pRequest == NULL || pRequest->eState != SPIFLASH_REQUEST_IDLE || nPage >= SPIFLASH_PAGE_COUNT || nPageOffset >= SPIFLASH_PAGE_SIZE)
 	{
-		//	We're in good shape to kick off this write.
-		//	Go ahead and pass this to our "write helper" function.
-		m_sSPIWriteStatus.pBuffer = pBuffer;
-		m_sSPIWriteStatus.nPage = nPage;
-		m_sSPIWriteStatus.nBytesLeft = nSize;
-		m_sSPIWriteStatus.nPageOffset = nPageOffset;
-		SPIFlash_WriteHelper(&m_sSPIWriteStatus);
-
-		bReturn = true;
+		return false;
 	}
 
-	return bReturn;
+	pRequest->eOperation = eOperation;
+	pRequest->pBuffer = pBuffer;
+	pRequest->nAddress = (nPage * SPIFLASH_PAGE_SIZE) + nPageOffset;
+	pRequest->nSize = nSize;
+	pRequest->pCallback = NULL;
+	pRequest->pContext = NULL;
+
+	return SPIFlash_Submit(pRequest);
+}
+bool SPIFlash_Read(SPIFlash_Request_T * pRequest, uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize)
+{
+	return SPIFlash_SubmitSimple(pRequest, SPIFLASH_OPERATION_READ, pBuffer, nPage, nPageOffset, nSize);
+}
+bool SPIFlash_Write(SPIFlash_Request_T * pRequest, uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize)
+{
+	return SPIFlash_SubmitSimple(pRequest, SPIFLASH_OPERATION_WRITE, pBuffer, nPage, nPageOffset, nSize);
 }
 
 /*
-	Function:	SPIFlash_Read()
+	Function:	SPIFlash_RequestBusy()
+				SPIFlash_IsFree()
+				SPIFlash_InTransfer()
 	Description:
-		Kickstarts the process of reading from the flash to the buffer.
+		Whether a given request is still queued or in progress,
+		whether the driver has nothing at all left to do, and whether
+		the interrupt is in the middle of a run of steps on the bus.
 */
-bool SPIFlash_Read(uint8_t * pBuffer, uint16_t nPage, uint16_t nPageOffset, uint16_t nSize)
+bool SPIFlash_RequestBusy(const SPIFlash_Request_T * pRequest)
 {
-	//	Boolean value, returning the success or failure of this function
-	//	Until deemed otherwise, we must assume that this function will fail.
-	bool bReturn = false;
+	return (pRequest->eState != SPIFLASH_REQUEST_IDLE);
+}
+bool SPIFlash_IsFree(void)
+{
+	return (m_pSPIActive == NULL) && (m_pSPIQueueHead == NULL);
+}
+bool SPIFlash_InTransfer(void)
+{
+	return (m_eSPIFlashState != SPIFLASH_STATE_IDLE) && !m_bSPIStepsComplete;
+}
 
-	//	Determine if the SPIStep_T is in use.
-	bool bSPIStepsClear = SPIFlash_IsFree();
+/*
+	Function:	SPIFlash_StartStep()
+	Description:
+		Kicks off the DMA transfer for the given step.
 
-	//	Determine if the criteria for actually setting this up has passed
-	if ( (pBuffer != NULL) &&
-			(nPage < SPIFLASH_PAGE_COUNT) &&
-				(  ((nPage * SPIFLASH_PAGE_SIZE) + nPageOffset + nSize) < SPIFLASH_CHIP_SIZE) &&
-					bSPIStepsClear)
+	WARNING:
+		Called from two locations: main processing loop as well as interrupts.
+*/
+static bool SPIFlash_StartStep(int nStepIndex)
+{
+	HAL_StatusTypeDef eOperationStatus = HAL_ERROR;
+	SPIStep_T * pStep = &m_aSPIStep[nStepIndex];
+
+	//	Go ahead and, via software, pull the chip select line low.
+	HAL_GPIO_WritePin(EE_CS_GPIO_Port, EE_CS_Pin, GPIO_PIN_RESET);
+
+	//	What does this step want us to do?
+	if (pStep->pTransmitData != NULL && pStep->nByteCount > 0)
 	{
-		//	Good to go.
-		//	Setup the steps.
-		SPIStep_CommandAddress(&m_aSPIStep[0], Read_Data_Bytes_READ, nPage, nPageOffset);
-		SPIStep_Read(&m_aSPIStep[1], pBuffer, nSize);
-		m_aSPIStep[1].bSetCSHigh = true;
-		bReturn = true;
+		//	Data transmit.
+		eOperationStatus = HAL_SPI_Transmit_DMA(Main_Get_SPI_Handle(), pStep->pTransmitData, pStep->nByteCount);
+	}
+	else if (pStep->pReceiveData != NULL && pStep->nByteCount > 0)
+	{
+		//	Data receive.
+		eOperationStatus = HAL_SPI_Receive_DMA(Main_Get_SPI_Handle(), pStep->pReceiveData, pStep->nByteCount);
+	}
+
+	if (eOperationStatus != HAL_OK)
+	{
+		//	Abandon the transaction.
+		HAL_GPIO_WritePin(EE_CS_GPIO_Port, EE_CS_Pin, GPIO_PIN_SET);
 	}
 
-	return bReturn;
+	return (eOperationStatus == HAL_OK);
 }
 
 /*
-	Function:	SPIFlash_OperationCompleteCallback()
+	Function:	SPIFlash_RunSteps()
 	Description:
-		The operation pending is complete.
-		Run the appropriate helper function, if it exists, and clear it if not.
-		Clear the appropriate flags, so another operation may take place.
+		Runs the nSteps steps set up in m_aSPIStep.
+		Completion is signalled through m_bSPIStepsComplete.
 */
-void SPIFlash_OperationCompleteCallback()
+static void SPIFlash_RunSteps(int nSteps)
 {
-	//	Clear the entirety of the m_aSPIStep
-	memset(m_aSPIStep, 0, sizeof(m_aSPIStep));
-
-	//	Capture the current callback pointers
-	void (*pSPIPostOperationFunc)(void *) = m_pSPIPostOperationFunc;
-	void * pSPIPostOperationFuncArgs = m_pSPIPostOperationFuncArgs;
-
-	//	Reset the complete callback to NULL
-	m_pSPIPostOperationFunc = NULL;
-	m_pSPIPostOperationFuncArgs = NULL;
-
-	//	Reset the step index to zero
+	m_nSPIStepCount = nSteps;
 	m_nSPIStepIndex = 0;
+	m_bSPIStepsComplete = false;
+	m_bSPIStepsFailed = false;
+	m_eSPIFlashState = SPIFLASH_STATE_PROCESS;
 
-	//	If there is a helper function to call, go ahead and run it.
-	if (pSPIPostOperationFunc != NULL)
+	if (!SPIFlash_StartStep(0))
 	{
-		//	If there is a helper function-- we will assume that the
-		//	SPIFlash still needs to process something, so it will
-		//	remain in the SPIFLASH_STATE_PROCESS state unless this
-		//	function explicitly changes it / completes it for us.
-		pSPIPostOperationFunc(pSPIPostOperationFuncArgs);
+		m_bSPIStepsFailed = true;
+		m_bSPIStepsComplete = true;
 	}
-
-	//	Note that it is the responsibility of the function to ensure that there
-	//	is some form of a transition from the SPI
 }
 
-
 /*
-    Function:   SPIFlash_SetupNextOperation
-    Description:
-        Configures the SPI flash to run the next step as specified
-        in the SPIFlash_T array.
-
-    WARNING:
-    	Called from two locations: main processing loop as well as interrupts.
-
+	Function:	SPIFlash_NextChunk()
+	Description:
+		Sets up and starts the next chunk of the active request.
+		Reads are done in a single chunk; writes one page at a time,
+		as the part cannot program across a page boundary.
 */
-static bool SPIFlash_SetupNextOperation(SPIStep_T * aSteps, int nSteps, int nStepIndex)
+static void SPIFlash_NextChunk(SPIFlash_Request_T * pRequest)
 {
-	HAL_StatusTypeDef eOperationStatus = 0xFF;
-	bool bReturn = false;
+	uint16_t nAddress = pRequest->nAddress + pRequest->nBytesDone;
+	uint16_t nPage = nAddress / SPIFLASH_PAGE_SIZE;
+	uint16_t nPageOffset = nAddress % SPIFLASH_PAGE_SIZE;
+	uint16_t nBytesLeft = pRequest->nSize - pRequest->nBytesDone;
 
-	//	Guard to ensure that the parameters passed are indeed valid.
-	if (aSteps != NULL)
+	if (pRequest->eOperation == SPIFLASH_OPERATION_READ)
+	{
+		SPIStep_CommandAddress(&m_aSPIStep[0], Read_Data_Bytes_READ, nPage, nPageOffset);
+		SPIStep_Read(&m_aSPIStep[1], &pRequest->pBuffer[pRequest->nBytesDone], nBytesLeft);
+		m_aSPIStep[1].bSetCSHigh = true;
+		pRequest->nBytesDone += nBytesLeft;
+		SPIFlash_RunSteps(2);
+	}
+	else
 	{
-		//	Boolean flag, to indicate that one of these operations is in progress.
-		//	The only way this flag can be "unset" is if the completion callback is hit.
-		m_bSPIOperationInProgress = true;
+		SPIStep_WriteEnable(&m_aSPIStep[0], true);
+		SPIStep_CommandAddress(&m_aSPIStep[1], Page_Program_PP, nPage, nPageOffset);
+		SPIStep_Write(&m_aSPIStep[2], &pRequest->pBuffer[pRequest->nBytesDone], nPage, nPageOffset, nBytesLeft);
+		m_aSPIStep[2].bSetCSHigh = true;
+		pRequest->nBytesDone += m_aSPIStep[2].nByteCount;
+		SPIFlash_RunSteps(3);
+	}
+}
 
-		//	Go ahead and, via software, pull the chip select line low.
-		HAL_GPIO_WritePin(EE_CS_GPIO_Port, EE_CS_Pin, GPIO_PIN_RESET);
+/*
+	Function:	SPIFlash_Complete()
+	Description:
+		Retires the active request and lets the client know.
+*/
+static void SPIFlash_Complete(bool bSuccess)
+{
+	SPIFlash_Request_T * pRequest = m_pSPIActive;
 
-		//	Figure out what the requested next step is
-		SPIStep_T * pNextStep = &aSteps[nStepIndex];
+	m_pSPIActive = NULL;
+	m_eSPIFlashState = SPIFLASH_STATE_IDLE;
 
-		//	What does this next step want us to do?
-		if (pNextStep->pTransmitData != NULL && pNextStep->nByteCount > 0)
-		{
-			//	Data transmit.
-			eOperationStatus = HAL_SPI_Transmit_IT(Main_Get_SPI_Handle(), pNextStep->pTransmitData, pNextStep->nByteCount);
-		}
-		else if (pNextStep->pReceiveData != NULL && pNextStep->nByteCount > 0)
-		{
-			//	Data receive.
-			eOperationStatus = HAL_SPI_Receive_IT(Main_Get_SPI_Handle(), pNextStep->pReceiveData, pNextStep->nByteCount);
-		}
+	pRequest->bSuccess = bSuccess;
+	pRequest->eState = SPIFLASH_REQUEST_IDLE;
 
-		//	If this was successful, we've kicked off this operation, and so
-		//	we can proceed to move forward with the nStepIndex.
-		if (eOperationStatus == HAL_OK)
-		{
-			bReturn = true;
-		}
-		else
-		{
-			//	Ultimately, nothing was run.
-			//	Go ahead and "unset" this flag before we escape.
-			m_bSPIOperationInProgress = false;
-		}
+	if (pRequest->pCallback != NULL)
+	{
+		pRequest->pCallback(pRequest);
 	}
-
-	return bReturn;
 }
 
 /*
 	Function:	HAL_SPI_TxCpltCallback()
 				HAL_SPI_RxCpltCallback()
-				HAL_SPI_TxRxCpltCallback()
+				HAL_SPI_ErrorCallback()
 	Description:
 		Callback functions, as specified by the HAL.
-		These are overridden from their weak definitions so that they call our callback
-		that was specified.
+		These are overridden from their weak definitions so that the next
+		step is kicked off straight from the interrupt.
 */
-void SPIFlash_Callback(SPIStep_T * aSteps, int nSteps, int * nStepIndex)
+static void SPIFlash_Callback(bool bError)
 {
-	//	Callback function is shared amongst the three types of callbacks
-	//	that could be possibly triggered.
-
-	//	No longer an operation/step in progress.
-	m_bSPIOperationInProgress = false;
+	int nStepIndex = m_nSPIStepIndex;
 
 	//	Does this step request that the CS line be pulled back up?
-	if (aSteps[*nStepIndex].bSetCSHigh)
+	if (m_aSPIStep[nStepIndex].bSetCSHigh || bError)
 	{
 		//	Go ahead and, via software, pull the chip select line high.
 		HAL_GPIO_WritePin(EE_CS_GPIO_Port, EE_CS_Pin, GPIO_PIN_SET);
 	}
 
-	//	Increment this number, and then proceed to set up the next step.
-	*nStepIndex += 1;
+	nStepIndex++;
+	m_nSPIStepIndex = nStepIndex;
+
+	if (bError)
+	{
+		m_bSPIStepsFailed = true;
+		m_bSPIStepsComplete = true;
+	}
+	else if (nStepIndex < m_nSPIStepCount)
+	{
+		//	Chain on to the next step.
+		if (!SPIFlash_StartStep(nStepIndex))
+		{
+			m_bSPIStepsFailed = true;
+			m_bSPIStepsComplete = true;
+		}
+	}
+	else
+	{
+		m_bSPIStepsComplete = true;
+	}
+
+	if (m_bSPIStepsComplete)
+	{
+		Scheduler_Post(SCHEDULER_EVENT_SPIFLASH);
+	}
 }
 
 void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-	SPIFlash_Callback(m_aSPIStep, SPIFLASH_MAX_STEPS, &m_nSPIStepIndex);
+	SPIFlash_Callback(false);
 }
 void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-	SPIFlash_Callback(m_aSPIStep, SPIFLASH_MAX_STEPS, &m_nSPIStepIndex);
+	SPIFlash_Callback(false);
 }
-void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
 {
-	SPIFlash_Callback(m_aSPIStep, SPIFLASH_MAX_STEPS, &m_nSPIStepIndex);
+	SPIFlash_Callback(true);
 }
 
 /*
 	Function:	SPIFlash_Process()
 	Description:
-		The process function continuously reads the SPIFlash, and if it
-		doesn't match what we expect it to in memory (say because of a change),
-		then we'll go ahead and rewrite it out.
+		Services the request queue.
+		Takes the next request off the queue when the bus is free, and moves
+		the active request on to its next chunk once the interrupt has
+		finished with the last one. After each page write, the status register
+		is polled from here until the part has finished programming.
 */
 void SPIFlash_Process(void)
 {
-
 	//	The following is the actual SPIFlash_Process code that should remain
 	//	in the final release of the product build.
 
-	bool bSPIStepsClear = true;
-
 	switch(m_eSPIFlashState)
 	{
 		case SPIFLASH_STATE_IDLE:
 			//	IDLE state of the SPIFlash.
-			//	Determine if there's any operations that are presently pending. If so,
-			//	go ahead and run them
-			bSPIStepsClear = SPIFlash_IsFree();
-			if (!bSPIStepsClear)
+			//	Determine if there's any requests that are presently pending. If so,
+			//	go ahead and start on them.
+			if (m_pSPIQueueHead != NULL)
 			{
-				//	The SPISteps_T buffer is not clear, and in a state of IDLEness.
-				//	Something is waiting to run.
-				//	Kick off that operation.
-				if (SPIFlash_SetupNextOperation(m_aSPIStep, SPIFLASH_MAX_STEPS, m_nSPIStepIndex))
+				m_pSPIActive = m_pSPIQueueHead;
+				m_pSPIQueueHead = m_pSPIActive->pNext;
+				if (m_pSPIQueueHead == NULL)
 				{
-					m_eSPIFlashState = SPIFLASH_STATE_PROCESS;
+					m_pSPIQueueTail = NULL;
+				}
+
+				m_pSPIActive->pNext = NULL;
+				m_pSPIActive->eState = SPIFLASH_REQUEST_ACTIVE;
+				SPIFlash_NextChunk(m_pSPIActive);
+			}
+			break;
+
+		case SPIFLASH_STATE_PROCESS:
+			//	The interrupt runs through the steps for us.
+			//	Wait until it's done.
+			if (m_bSPIStepsComplete)
+			{
+				if (m_bSPIStepsFailed)
+				{
+					SPIFlash_Complete(false);
+				}
+				else if (m_pSPIActive->eOperation == SPIFLASH_OPERATION_WRITE)
+				{
+					//	Wait for the page to be programmed.
+					SPIStep_ReadStatusRegister(&m_aSPIStep[0]);
+					SPIFlash_RunSteps(2);
+					m_eSPIFlashState = SPIFLASH_STATE_POLL;
 				}
 				else
 				{
-					SPIFlash_OperationCompleteCallback();
+					SPIFlash_Complete(true);
 				}
-
-				/*
-				 *	//	Determine where the SPIStep_T array is presently at.
-					if (*nStepIndex < nSteps)
-					{
-						//	Attempt to complete the callback by
-						//	setting up the next operation.
-						bHandled = SPIFlash_SetupNextOperation(aSteps, nSteps, *nStepIndex);
-					}
-
-					if (!bHandled)
-					{
-						//	There weren't any more steps to complete.
-						//	Complete the operation with the generic callback.
-						SPIFlash_OperationCompleteCallback();
-					}
-				 */
 			}
 			break;
-		case SPIFLASH_STATE_PROCESS:
-			//	We ourselves cannot escape this state--
-			//	An interrupt from the SPI1 bus will cause us to escape when all operations are complete.
-			if (!m_bSPIOperationInProgress)
+
+		case SPIFLASH_STATE_POLL:
+			if (m_bSPIStepsComplete)
 			{
-				m_eSPIFlashState = SPIFLASH_STATE_IDLE;
+				if (m_bSPIStepsFailed)
+				{
+					SPIFlash_Complete(false);
+				}
+				else if (m_nSR & SPIFLASH_RDSR_BUSY_BIT)
+				{
+					//	Still programming; ask again.
+					SPIStep_ReadStatusRegister(&m_aSPIStep[0]);
+					SPIFlash_RunSteps(2);
+					m_eSPIFlashState = SPIFLASH_STATE_POLL;
+				}
+				else if (m_pSPIActive->nBytesDone < m_pSPIActive->nSize)
+				{
+					SPIFlash_NextChunk(m_pSPIActive);
+				}
+				else
+				{
+					SPIFlash_Complete(true);
+				}
 			}
 			break;
+
 		default:
+			m_eSPIFlashState = SPIFLASH_STATE_IDLE;
 			break;
 	}
 
+	if (SPIFlash_IsFree())
+	{
+		Clock_Demand(CLOCK_DEMAND_SPIFLASH, false);
+	}
+
 	//	The following is the DEBUG code used to test the state machine as specified above.
 #ifdef DEBUG_SPIFLASH_CONSTANT_READS_AND_WRITES
 	switch(nInternalCounter)
 	{
 		case 0:
-			SPIFlash_Read(aTestBuffer, 0, 0, DEBUG_SPIFLASH_BUFFER_SIZE);
+			SPIFlash_Read(&sTestRequest, aTestBuffer, 0, 0, DEBUG_SPIFLASH_BUFFER_SIZE);
 			nInternalCounter++;
 			break;
 		case 1:
-			if (SPIFlash_IsFree())
+			if (!SPIFlash_RequestBusy(&sTestRequest))
 			{
 				//	Generate a random buffer
 				int nCntr = 0;
@@ -560,19 +604,19 @@ void SPIFlash_Process(void)
 				{
 					aExpectedContentsBuffer[nCntr] = (rand() * rand()) & 0xFF;
 				}
-				SPIFlash_Write(aExpectedContentsBuffer, 0, 0, DEBUG_SPIFLASH_BUFFER_SIZE);
+				SPIFlash_Write(&sTestRequest, aExpectedContentsBuffer, 0, 0, DEBUG_SPIFLASH_BUFFER_SIZE);
 				nInternalCounter++;
 			}
 			break;
 		case 2:
-			if (SPIFlash_IsFree())
+			if (!SPIFlash_RequestBusy(&sTestRequest))
 			{
-				SPIFlash_Read(aTestBuffer, 0, 0, DEBUG_SPIFLASH_BUFFER_SIZE);
+				SPIFlash_Read(&sTestRequest, aTestBuffer, 0, 0, DEBUG_SPIFLASH_BUFFER_SIZE);
 				nInternalCounter++;
 			}
 			break;
 		case 3:
-			if (SPIFlash_IsFree())
+			if (!SPIFlash_RequestBusy(&sTestRequest))
 			{
 				volatile int memory_compare_stat = memcmp(aTestBuffer, aExpectedContentsBuffer, DEBUG_SPIFLASH_BUFFER_SIZE);
 				nInternalCounter++;
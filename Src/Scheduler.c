@@ -0,0 +1,344 @@
+/*
+ * Scheduler.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *  	Cooperative scheduler for the main loop.
+ *  	Each task in the table below runs when its period has elapsed, or
+ *  	as soon as one of its events is posted (usually from an interrupt).
+ *  	Tasks that are ready run once each pass, in order of priority, and
+ *  	when none are the core sleeps (WFI) until the next interrupt. The
+ *  	1 ms SysTick bounds how long that can be, so periods are honoured
+ *  	to the millisecond.
+ *  	The run time of every task is measured against its budget, and
+ *  	its share of the CPU worked out once every SCHEDULER_LOAD_WINDOW_US.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "Scheduler.h"
+#include "Diagnostics.h"
+#include "Timebase.h"
+#include "Clock.h"
+#include "Relay.h"
+#include "ModbusSlave.h"
+#include "SPIFlash.h"
+#include "EEPROM.h"
+#include "Journal.h"
+#include "Fault.h"
+#include "RAMIntegrity.h"
+#include "ADC.h"
+#include "ADCHistory.h"
+#include "ADCCapture.h"
+#include "Configuration.h"
+#include "LED.h"
+#include "Command.h"
+
+//	Interval over which each task's share of the CPU is worked out.
+#define SCHEDULER_LOAD_WINDOW_US	(1000000)
+
+/*
+	Structure:	Scheduler_Task_T
+	Description:
+		A task, as laid out in the table.
+		A period of 0 means the task only runs when one of its events is posted.
+		The budget is how long a single run is expected to take, in microseconds;
+		runs that take longer are counted as overruns.
+*/
+typedef struct
+{
+	void (*pProcess)(void);
+	uint16_t nPeriod;
+	uint8_t nPriority;
+	uint16_t nBudget;
+	uint32_t nEvents;
+}	Scheduler_Task_T;
+
+static const Scheduler_Task_T m_aSchedulerTask[] =
+{
+	//	Process					Period (ms)	Priority	Budget (us)	Events
+	{	Relay_Process,			10,			0,			1000,		SCHEDULER_EVENT_RELAY		},
+	{	ModbusSlave_Process,	5,			1,			1000,		SCHEDULER_EVENT_MODBUS		},
+	{	SPIFlash_Process,		1,			2,			100,		SCHEDULER_EVENT_SPIFLASH	},
+	{	EEPROM_Process,			1,			3,			500,		SCHEDULER_EVENT_SPIFLASH	},
+	{	Journal_Process,		10,			4,			500,		0							},
+	{	Fault_CRC_Process,		10,			5,			100,		0							},
+	{	RAMIntegrity_Process,	10,			6,			RAMINTEGRITY_PASS_BUDGET_US + 50,	0	},
+	{	ADCCapture_Process,		0,			7,			2000,		SCHEDULER_EVENT_ADC			},
+	{	ADC_Process,			ADC_TICK_INCREMENT,	8,	500,		0							},
+	{	ADCHistory_Process,		100,		9,			200,		0							},
+	{	Configuration_Process,	10,			10,			100,		0							},
+	{	LED_Process,			10,			11,			100,		0							},
+	{	Command_Process,		10,			12,			2000,		SCHEDULER_EVENT_COMMAND		},
+};
+
+#define SCHEDULER_TASK_COUNT	(sizeof(m_aSchedulerTask) / sizeof(m_aSchedulerTask[0]))
+
+/*
+	Structure:	Scheduler_TaskState_T
+	Description:
+		The running state and statistics of a task.
+		Times are in microseconds, converted at the end of each run, since
+		the core clock may change between runs; the average is scaled up
+		by DIAGNOSTICS_LOOP_AVERAGE_SHIFT, as in Diagnostics.c.
+*/
+typedef struct
+{
+	volatile uint32_t nPending;
+	uint32_t nLastRun;
+	uint32_t nMicrosecondsMax;
+	uint32_t nMicrosecondsAverageScaled;
+	uint32_t nMicrosecondsWindow;
+	uint16_t nShare;
+	uint16_t nOverruns;
+}	Scheduler_TaskState_T;
+
+static Scheduler_TaskState_T m_aSchedulerState[SCHEDULER_TASK_COUNT];
+
+//	Task indices, highest priority first.
+static uint8_t m_aSchedulerOrder[SCHEDULER_TASK_COUNT];
+
+static uint64_t m_nSchedulerWindowStart = 0;
+static uint16_t m_nSchedulerLoad = 0;
+static uint16_t m_nSchedulerOverruns = 0;
+
+/*
+	Function:	Scheduler_Init()
+	Description:
+		Puts the tasks in order of priority.
+		Every task is due on the first pass.
+*/
+void Scheduler_Init(void)
+{
+	for (uint8_t n = 0; n < SCHEDULER_TASK_COUNT; n++)
+	{
+		uint8_t i = n;
+
+		//	Insertion sort; equal priorities keep their table order.
+		while (i > 0 && m_aSchedulerTask[m_aSchedulerOrder[i - 1]].nPriority > m_aSchedulerTask[n].nPriority)
+		{
+			m_aSchedulerOrder[i] = m_aSchedulerOrder[i - 1];
+			i--;
+		}
+		m_aSchedulerOrder[i] = n;
+
+		m_aSchedulerState[n].nPending = m_aSchedulerTask[n].nEvents;
+		m_aSchedulerState[n].nLastRun = uwTick - m_aSchedulerTask[n].nPeriod;
+	}
+
+	m_nSchedulerWindowStart = Timebase_GetMicroseconds();
+}
+
+/*
+	Function:	Scheduler_Post()
+	Description:
+		Makes every task waiting on any of the given events ready.
+		Safe to call from interrupt context.
+*/
+void Scheduler_Post(uint32_t nEvents)
+{
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	for (uint8_t n = 0; n < SCHEDULER_TASK_COUNT; n++)
+	{
+		m_aSchedulerState[n].nPending |= (nEvents & m_aSchedulerTask[n].nEvents);
+	}
+
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	Scheduler_Ready()
+	Description:
+		Returns true if the task has an event pending, or its period is up.
+*/
+static bool Scheduler_Ready(uint8_t nTask)
+{
+	const Scheduler_Task_T * pTask = &m_aSchedulerTask[nTask];
+
+	return m_aSchedulerState[nTask].nPending != 0
+			|| (pTask->nPeriod != 0 && Timebase_ElapsedMilliseconds(m_aSchedulerState[nTask].nLastRun, pTask->nPeriod));
+}
+
+/*
+	Function:	Scheduler_Dispatch()
+	Description:
+		Runs a single task, and folds its run time into its statistics.
+		Events posted while it runs leave it ready for the next pass.
+*/
+static void Scheduler_Dispatch(uint8_t nTask)
+{
+	Scheduler_TaskState_T * pState = &m_aSchedulerState[nTask];
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+	pState->nPending = 0;
+	__set_PRIMASK(nPRIMASK);
+
+	pState->nLastRun = uwTick;
+
+	uint32_t nStart = DIAGNOSTICS_CYCLES();
+	m_aSchedulerTask[nTask].pProcess();
+	uint32_t nMicroseconds = Diagnostics_CyclesToMicroseconds(DIAGNOSTICS_CYCLES() - nStart);
+
+	if (nMicroseconds > pState->nMicrosecondsMax)
+	{
+		pState->nMicrosecondsMax = nMicroseconds;
+	}
+
+	pState->nMicrosecondsAverageScaled -= (pState->nMicrosecondsAverageScaled >> DIAGNOSTICS_LOOP_AVERAGE_SHIFT);
+	pState->nMicrosecondsAverageScaled += nMicroseconds;
+	pState->nMicrosecondsWindow += nMicroseconds;
+
+	if (nMicroseconds > m_aSchedulerTask[nTask].nBudget)
+	{
+		if (pState->nOverruns < UINT16_MAX)
+		{
+			pState->nOverruns++;
+		}
+		if (m_nSchedulerOverruns < UINT16_MAX)
+		{
+			m_nSchedulerOverruns++;
+		}
+	}
+}
+
+/*
+	Function:	Scheduler_UpdateLoad()
+	Description:
+		At the end of each window, works out each task's share of the CPU
+		over it, and the total, in tenths of a percent.
+*/
+static void Scheduler_UpdateLoad(void)
+{
+	uint64_t nNow = Timebase_GetMicroseconds();
+	uint64_t nElapsed = nNow - m_nSchedulerWindowStart;
+
+	if (nElapsed < SCHEDULER_LOAD_WINDOW_US)
+	{
+		return;
+	}
+
+	uint32_t nLoad = 0;
+
+	for (uint8_t n = 0; n < SCHEDULER_TASK_COUNT; n++)
+	{
+		m_aSchedulerState[n].nShare = (uint16_t) (((uint64_t) m_aSchedulerState[n].nMicrosecondsWindow * 1000) / nElapsed);
+		m_aSchedulerState[n].nMicrosecondsWindow = 0;
+		nLoad += m_aSchedulerState[n].nShare;
+	}
+
+	m_nSchedulerLoad = (nLoad > 1000) ? 1000 : (uint16_t) nLoad;
+	m_nSchedulerWindowStart = nNow;
+}
+
+/*
+	Function:	Scheduler_Run()
+	Description:
+		A single pass of the main loop.
+		First lets the clock policy raise or drop the core clock for the
+		work at hand (see Clock.c), then runs each task that is ready,
+		once, in order of priority. If none were, sleeps until the next
+		interrupt; the check and the sleep are made with interrupts masked,
+		so an event posted in between still wakes us (the interrupt is
+		taken once they are unmasked).
+*/
+void Scheduler_Run(void)
+{
+	bool bRan = false;
+
+	Clock_Process();
+
+	for (uint8_t n = 0; n < SCHEDULER_TASK_COUNT; n++)
+	{
+		uint8_t nTask = m_aSchedulerOrder[n];
+
+		if (Scheduler_Ready(nTask))
+		{
+			Scheduler_Dispatch(nTask);
+			bRan = true;
+		}
+	}
+
+	if (bRan)
+	{
+		Diagnostics_LoopProcess();
+		Scheduler_UpdateLoad();
+		return;
+	}
+
+	uint32_t nPRIMASK = __get_PRIMASK();
+	bool bReady = false;
+
+	__set_PRIMASK(1);
+
+	for (uint8_t n = 0; n < SCHEDULER_TASK_COUNT && !bReady; n++)
+	{
+		bReady = Scheduler_Ready(n);
+	}
+
+	if (!bReady)
+	{
+		__DSB();
+		__WFI();
+	}
+
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	Scheduler_GetLoad()
+				Scheduler_GetOverrunCount()
+	Description:
+		Returns the share of the CPU taken by all of the tasks over the
+		last window, in tenths of a percent, and the number of runs of
+		any task that went over budget, since power up.
+*/
+uint16_t Scheduler_GetLoad(void)
+{
+	return m_nSchedulerLoad;
+}
+uint16_t Scheduler_GetOverrunCount(void)
+{
+	return m_nSchedulerOverruns;
+}
+
+/*
+	Function:	Scheduler_ReadFileRecord()
+	Description:
+		Reads a single record (register) of the task statistics file,
+		as laid out in Scheduler.h.
+*/
+ModbusException_T Scheduler_ReadFileRecord(uint16_t nRecord, uint16_t * pValue)
+{
+	uint16_t nTask = nRecord / SCHEDULER_TASK_REGISTERS;
+
+	if (nTask >= SCHEDULER_TASK_COUNT)
+	{
+		return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+	}
+
+	const Scheduler_Task_T * pTask = &m_aSchedulerTask[nTask];
+	const Scheduler_TaskState_T * pState = &m_aSchedulerState[nTask];
+	uint32_t nValue;
+
+	switch (nRecord % SCHEDULER_TASK_REGISTERS)
+	{
+		case 0:	nValue = pTask->nPeriod;																		break;
+		case 1:	nValue = pTask->nPriority;																		break;
+		case 2:	nValue = pTask->nBudget;																		break;
+		case 3:	nValue = pState->nMicrosecondsMax;																break;
+		case 4:	nValue = pState->nMicrosecondsAverageScaled >> DIAGNOSTICS_LOOP_AVERAGE_SHIFT;					break;
+		case 5:	nValue = pState->nOverruns;																		break;
+		default:	nValue = pState->nShare;																	break;
+	}
+
+	*pValue = (nValue > UINT16_MAX) ? UINT16_MAX : (uint16_t) nValue;
+
+	return MODBUS_EXCEPTION_OK;
+}
@@ -0,0 +1,150 @@
+/*
+ * Timebase.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *  	Microsecond timebase for the Heceta Relay Module.
+ *  	Built on SysTick rather than the DWT cycle counter, since the cycle
+ *  	counter stops while the core sleeps in WFI, and SysTick doesn't:
+ *  	the time is uwTick in milliseconds, extended to 64 bits so that it
+ *  	never wraps, plus the part of the current millisecond that SysTick
+ *  	has counted down. The cycle counter is left to time short stretches
+ *  	of code that run awake (see Diagnostics.h).
+ *  	SysTick is reprogrammed when the core clock changes, which starts
+ *  	the millisecond over, so Timebase_ClockChange() must be called just
+ *  	before that to keep the part already gone.
+ *  	Also holds the helpers for checking whether an interval is up, so
+ *  	that every module compares times the same, wraparound-safe, way.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "Timebase.h"
+
+//	Milliseconds up to m_nTimebaseTick (the uwTick they were last brought
+//	up to date with), and the microseconds banked from the millisecond
+//	that was under way each time SysTick was reprogrammed.
+static uint64_t m_nTimebaseMilliseconds = 0;
+static uint32_t m_nTimebaseTick = 0;
+static uint64_t m_nTimebaseBanked = 0;
+
+/*
+	Function:	Timebase_Init()
+	Description:
+		Starts the timebase from the current uwTick.
+*/
+void Timebase_Init(void)
+{
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+	m_nTimebaseMilliseconds = uwTick;
+	m_nTimebaseTick = uwTick;
+	m_nTimebaseBanked = 0;
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	Timebase_Update()
+	Description:
+		Folds the ticks since the last update into the millisecond count.
+		Called from SysTick, so uwTick is never anywhere near wrapping
+		between updates.
+*/
+void Timebase_Update(void)
+{
+	uint32_t nPRIMASK = __get_PRIMASK();
+
+	__set_PRIMASK(1);
+
+	uint32_t nTick = uwTick;
+
+	m_nTimebaseMilliseconds += (uint32_t) (nTick - m_nTimebaseTick);
+	m_nTimebaseTick = nTick;
+
+	__set_PRIMASK(nPRIMASK);
+}
+
+/*
+	Function:	Timebase_Fraction()
+	Description:
+		Returns how far SysTick is through the current tick, in microseconds,
+		and sets *pTicks to the number of ticks that uwTick is behind by:
+		one if SysTick has reloaded but its interrupt hasn't run yet.
+		Must be called with interrupts disabled.
+		A count of zero is taken as the very start of a tick; that's what's
+		read straight after SysTick is reprogrammed, before it reloads.
+*/
+static uint32_t Timebase_Fraction(uint32_t * pTicks)
+{
+	uint32_t nLoad = SysTick->LOAD + 1;
+	uint32_t nValue = SysTick->VAL;
+
+	*pTicks = 0;
+
+	//	If it reloaded around the read, read it again, after the reload.
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+	{
+		nValue = SysTick->VAL;
+		*pTicks = 1;
+	}
+
+	return (nValue == 0) ? 0 : ((nLoad - nValue) * (1000 * uwTickFreq)) / nLoad;
+}
+
+/*
+	Function:	Timebase_ClockChange()
+	Description:
+		Banks the part of the current tick already gone. Must be called,
+		with interrupts disabled, just before SysTick is reprogrammed for
+		a new core clock.
+*/
+void Timebase_ClockChange(void)
+{
+	uint32_t nTicks;
+
+	m_nTimebaseBanked += Timebase_Fraction(&nTicks);
+}
+
+/*
+	Function:	Timebase_GetMicroseconds()
+	Description:
+		Returns the time since reset, in microseconds.
+		Safe to call from interrupt context.
+*/
+uint64_t Timebase_GetMicroseconds(void)
+{
+	uint32_t nPRIMASK = __get_PRIMASK();
+	uint32_t nTicks;
+
+	__set_PRIMASK(1);
+
+	uint32_t nFraction = Timebase_Fraction(&nTicks);
+	uint64_t nMilliseconds = m_nTimebaseMilliseconds + (uint32_t) (uwTick - m_nTimebaseTick) + (nTicks * uwTickFreq);
+	uint64_t nMicroseconds = (nMilliseconds * 1000) + m_nTimebaseBanked + nFraction;
+
+	__set_PRIMASK(nPRIMASK);
+
+	return nMicroseconds;
+}
+
+/*
+	Function:	Timebase_ElapsedMicroseconds()
+				Timebase_ElapsedMilliseconds()
+	Description:
+		Returns true once at least nInterval has passed since nSince.
+		The first takes a time from Timebase_GetMicroseconds(), the second
+		one from uwTick; the difference is taken first, so the millisecond
+		version stays correct across the wrap of uwTick.
+*/
+bool Timebase_ElapsedMicroseconds(uint64_t nSince, uint64_t nInterval)
+{
+	return Timebase_GetMicroseconds() - nSince >= nInterval;
+}
+bool Timebase_ElapsedMilliseconds(uint32_t nSince, uint32_t nInterval)
+{
+	return (uint32_t) (uwTick - nSince) >= nInterval;
+}
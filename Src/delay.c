@@ -5,20 +5,22 @@
  *      Author: dmcmasters
  */
 
+#include "main.h"
 #include "delay.h"
+#include "Diagnostics.h"
 
+//	The delays are timed on the DWT cycle counter, at the current core
+//	clock, so they hold whatever the clock or the optimisation level.
+//	Longer delays are made up of shorter ones, so that the number of
+//	cycles waited for always fits in the counter.
 
-#define USEC_LIMIT 1
-#define MSEC_LIMIT 727
-#define SEC_LIMIT 726745
-
-
-
-void delay_us(uint32_t delay)
+RAMFUNC void delay_us(uint32_t delay)
 {
-	for(uint32_t j = 0; j < delay; j++)
+	uint32_t nStart = DIAGNOSTICS_CYCLES();
+	uint32_t nCycles = delay * (SystemCoreClock / 1000000);
+
+	while (DIAGNOSTICS_CYCLES() - nStart < nCycles)
 	{
-		for(uint32_t i=0; i<USEC_LIMIT; i++);
 	}
 }
 
@@ -26,7 +28,7 @@ void delay_ms(uint32_t delay)
 {
 	for(uint32_t j = 0; j < delay; j++)
 	{
-		for(uint32_t i=0; i<MSEC_LIMIT; i++);
+		delay_us(1000);
 	}
 }
 
@@ -34,6 +36,6 @@ void delay_sec(uint32_t delay)
 {
 	for(uint32_t j = 0; j < delay; j++)
 	{
-		for(uint32_t i=0; i<SEC_LIMIT; i++);
+		delay_ms(1000);
 	}
 }
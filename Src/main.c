@@ -36,6 +36,12 @@
 #include "SPIFlash.h"
 #include "RAMIntegrity.h"
 #include "OptionByte.h"
+#include "Diagnostics.h"
+#include "Journal.h"
+#include "ADCHistory.h"
+#include "ADCCapture.h"
+#include "Scheduler.h"
+#include "Timebase.h"
 
 /* USER CODE END Includes */
 
@@ -62,19 +68,21 @@ CRC_HandleTypeDef    hcrc;
 IWDG_HandleTypeDef    hiwdg;
 
 SPI_HandleTypeDef    hspi1;
+DMA_HandleTypeDef    hdma_spi1_rx;
+DMA_HandleTypeDef    hdma_spi1_tx;
+DMA_HandleTypeDef    hdma_memtomem_dma1_channel4;
 
 TIM_HandleTypeDef    htim2;
+TIM_HandleTypeDef    htim6;
 
 UART_HandleTypeDef    huart1;
 UART_HandleTypeDef    huart3;
 
 /* USER CODE BEGIN PV */
-__IO uint16_t    aADCxConvertedValues[ADC_NUM_CHANNELS];
+__IO uint16_t    aADCxConvertedValues[ADC_NUM_CHANNELS] DMA_BUFFER;
 
 char    testString[] = "This is a test\n\r";
 
-uint16_t    sequenceIndex = 0;
-
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -88,6 +96,7 @@ static void MX_USART3_UART_Init(void);
 static void MX_CRC_Init(void);
 static void MX_IWDG_Init(void);
 static void MX_TIM2_Init(void);
+static void MX_TIM6_Init(void);
 /* USER CODE BEGIN PFP */
 #ifdef __GNUC__
 /* With GCC, small printf (option LD Linker->Libraries->Small printf
@@ -139,9 +148,15 @@ int main(void)
   MX_CRC_Init();
   MX_IWDG_Init();
   MX_TIM2_Init();
+  MX_TIM6_Init();
   /* USER CODE BEGIN 2 */
   DEBUG_GPIO_INIT();
+  Diagnostics_Init();
+  Timebase_Init();
+  Journal_Init();
+  Relay_Init();
   ModbusSlave_Init();
+  ADC_Init();
 
   /* Run the ADC calibration in single-ended mode */
   if (HAL_ADCEx_Calibration_Start(&hadc1, ADC_SINGLE_ENDED) != HAL_OK)
@@ -160,22 +175,44 @@ int main(void)
     Error_Handler();
   }
 
+  /* Start the timer that triggers each sequence of conversions */
+  if (HAL_TIM_Base_Start(&htim6) != HAL_OK)
+  {
+    /* Start Error */
+    Error_Handler();
+  }
+
   uint32_t    UID = UUID_Get_ID();
 
   OptionByte_Check();
 
   // Flow of execution
-  // -  Pre-main loop self-tests
+  // -  Pre-main loop self-tests, alongside a restricted set of services
   // -  Enter main loop, whether a failure occurs or not.
 
   // Pre-execution self-test processing loop.
   // Responsible for running all of the self tests that occur before the system boots.
+  // Modbus is served in the meantime, so the master doesn't see us drop
+  // off the bus, but writes are answered with SLAVE_DEVICE_BUSY until
+  // the tests are done. The relays are driven to their safe state as
+  // soon as the configuration (and with it the failsafe setting) is in.
   bool    bSelfTestsNotComplete = true;
 
   while (bSelfTestsNotComplete)
   {
     bSelfTestsNotComplete = false;
 
+    if (EEPROM_Ready())
+    {
+      Relay_Process();
+    }
+
+    SPIFlash_Process();
+    EEPROM_Process();
+    Journal_Process();
+    ModbusSlave_Process();
+    Configuration_Process();
+
     // LED Startup Test
     LED_Startup_Process();
 
@@ -199,16 +236,20 @@ int main(void)
     HAL_IWDG_Refresh(&hiwdg);
   }
 
-  // Upon completion of the self-checks, reset the uwTick to zero.
-  uwTick = 0;
+  // Upon completion of the self-checks, open up the rest of Modbus.
+  // uwTick is deliberately left running: the services above have been
+  // timestamping with it all along.
+  ModbusSlave_SetWritesBusy(false);
 
   printf("\n\rAll set? All clear--dispatch. [Self-Test Complete]\n\r");
   printf("\n\rHeceta Relay Module v%d.%d.%d, 0x%08lX\n\r> ", SOFTWARE_VERSION_MAJOR, SOFTWARE_VERSION_MINOR, SOFTWARE_VERSION_BUILD, UID);
-  sequenceIndex = 1;
 
   // Refresh the watchdog, just one more time.
   HAL_IWDG_Refresh(&hiwdg);
 
+  // From here on, the main loop is driven by the scheduler.
+  Scheduler_Init();
+
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -219,39 +260,11 @@ int main(void)
 
     /* USER CODE BEGIN 3 */
 
-    Relay_Process();
-    sequenceIndex = 2;
-
-    Fault_CRC_Process();
-    sequenceIndex = 3;
-
-    RAMIntegrity_Process();
-    sequenceIndex = 4;
-
-    LED_Process();
-    sequenceIndex = 5;
-
-    Command_Process();
-    sequenceIndex = 6;
-
-    SPIFlash_Process();
-    sequenceIndex = 7;
-
-    EEPROM_Process();
-    sequenceIndex = 8;
-
-    ModbusSlave_Process();
-    sequenceIndex = 9;
-
-    Configuration_Process();
-    sequenceIndex = 10;
-
-    ADC_Process();
-    sequenceIndex = 11;
+    // Runs whichever tasks are due (see Scheduler.c),
+    // or sleeps until the next interrupt if none are.
+    Scheduler_Run();
 
     HAL_IWDG_Refresh(&hiwdg);
-    sequenceIndex = 1;
-
   }
   /* USER CODE END 3 */
 }
@@ -273,7 +286,13 @@ void SystemClock_Config(void)
   RCC_OscInitStruct.HSIState            = RCC_HSI_ON;
   RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
   RCC_OscInitStruct.LSIState            = RCC_LSI_ON;
-  RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_NONE;
+  RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource       = RCC_PLLSOURCE_HSI;
+  RCC_OscInitStruct.PLL.PLLM            = 2;
+  RCC_OscInitStruct.PLL.PLLN            = 20;
+  RCC_OscInitStruct.PLL.PLLP            = RCC_PLLP_DIV7;
+  RCC_OscInitStruct.PLL.PLLQ            = RCC_PLLQ_DIV2;
+  RCC_OscInitStruct.PLL.PLLR            = RCC_PLLR_DIV2;
 
   if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
   {
@@ -294,8 +313,8 @@ void SystemClock_Config(void)
   }
   PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_USART1 | RCC_PERIPHCLK_USART3
                                        | RCC_PERIPHCLK_ADC;
-  PeriphClkInit.Usart1ClockSelection    = RCC_USART1CLKSOURCE_PCLK2;
-  PeriphClkInit.Usart3ClockSelection    = RCC_USART3CLKSOURCE_PCLK1;
+  PeriphClkInit.Usart1ClockSelection    = RCC_USART1CLKSOURCE_HSI;
+  PeriphClkInit.Usart3ClockSelection    = RCC_USART3CLKSOURCE_HSI;
   PeriphClkInit.AdcClockSelection       = RCC_ADCCLKSOURCE_PLLSAI1;
   PeriphClkInit.PLLSAI1.PLLSAI1Source   = RCC_PLLSOURCE_HSI;
   PeriphClkInit.PLLSAI1.PLLSAI1M        = 2;
@@ -330,7 +349,8 @@ static void MX_ADC1_Init(void)
 
   /* USER CODE END ADC1_Init 0 */
 
-  ADC_ChannelConfTypeDef    sConfig = {0};
+  ADC_AnalogWDGConfTypeDef  AnalogWDGConfig = {0};
+  ADC_ChannelConfTypeDef    sConfig         = {0};
 
   /* USER CODE BEGIN ADC1_Init 1 */
 
@@ -346,13 +366,16 @@ static void MX_ADC1_Init(void)
   hadc1.Init.LowPowerAutoWait      = DISABLE;
   hadc1.Init.ContinuousConvMode    = DISABLE;
   hadc1.Init.NbrOfConversion       = 4;
-  hadc1.Init.DiscontinuousConvMode = ENABLE;
-  hadc1.Init.NbrOfDiscConversion   = 1;
-  hadc1.Init.ExternalTrigConv      = ADC_SOFTWARE_START;
-  hadc1.Init.ExternalTrigConvEdge  = ADC_EXTERNALTRIGCONVEDGE_NONE;
+  hadc1.Init.DiscontinuousConvMode = DISABLE;
+  hadc1.Init.ExternalTrigConv      = ADC_EXTERNALTRIG_T6_TRGO;
+  hadc1.Init.ExternalTrigConvEdge  = ADC_EXTERNALTRIGCONVEDGE_RISING;
   hadc1.Init.DMAContinuousRequests = ENABLE;
   hadc1.Init.Overrun               = ADC_OVR_DATA_OVERWRITTEN;
-  hadc1.Init.OversamplingMode      = DISABLE;
+  hadc1.Init.OversamplingMode      = ENABLE;
+  hadc1.Init.Oversampling.Ratio                 = ADC_OVERSAMPLING_RATIO_16;
+  hadc1.Init.Oversampling.RightBitShift         = ADC_RIGHTBITSHIFT_4;
+  hadc1.Init.Oversampling.TriggeredMode         = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+  hadc1.Init.Oversampling.OversamplingStopReset = ADC_REGOVERSAMPLING_CONTINUED_MODE;
 
   if (HAL_ADC_Init(&hadc1) != HAL_OK)
   {
@@ -398,6 +421,28 @@ static void MX_ADC1_Init(void)
   {
     Error_Handler();
   }
+  /** Configure Analog WatchDog 1
+   */
+  AnalogWDGConfig.WatchdogNumber = ADC_ANALOGWATCHDOG_1;
+  AnalogWDGConfig.WatchdogMode   = ADC_ANALOGWATCHDOG_SINGLE_REG;
+  AnalogWDGConfig.HighThreshold  = 4095;
+  AnalogWDGConfig.LowThreshold   = 0;
+  AnalogWDGConfig.Channel        = ADC_CHANNEL_1;
+  AnalogWDGConfig.ITMode         = ENABLE;
+
+  if (HAL_ADC_AnalogWDGConfig(&hadc1, &AnalogWDGConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /** Configure Analog WatchDog 2
+   */
+  AnalogWDGConfig.WatchdogNumber = ADC_ANALOGWATCHDOG_2;
+  AnalogWDGConfig.Channel        = ADC_CHANNEL_2;
+
+  if (HAL_ADC_AnalogWDGConfig(&hadc1, &AnalogWDGConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
   /* USER CODE BEGIN ADC1_Init 2 */
 
   /* USER CODE END ADC1_Init 2 */
@@ -489,7 +534,7 @@ static void MX_SPI1_Init(void)
   hspi1.Init.CLKPolarity       = SPI_POLARITY_LOW;
   hspi1.Init.CLKPhase          = SPI_PHASE_1EDGE;
   hspi1.Init.NSS               = SPI_NSS_SOFT;
-  hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_16;
+  hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
   hspi1.Init.FirstBit          = SPI_FIRSTBIT_MSB;
   hspi1.Init.TIMode            = SPI_TIMODE_DISABLE;
   hspi1.Init.CRCCalculation    = SPI_CRCCALCULATION_DISABLE;
@@ -502,6 +547,7 @@ static void MX_SPI1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN SPI1_Init 2 */
+  SPIFlash_Init();
 
   /* USER CODE END SPI1_Init 2 */
 
@@ -586,6 +632,46 @@ static void MX_TIM2_Init(void)
 
 }
 
+/**
+ * @brief TIM6 Initialization Function
+ * @param None
+ * @retval None
+ */
+static void MX_TIM6_Init(void)
+{
+
+  /* USER CODE BEGIN TIM6_Init 0 */
+
+  /* USER CODE END TIM6_Init 0 */
+
+  TIM_MasterConfigTypeDef    sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM6_Init 1 */
+
+  /* USER CODE END TIM6_Init 1 */
+  htim6.Instance               = TIM6;
+  htim6.Init.Prescaler         = 1599;
+  htim6.Init.CounterMode       = TIM_COUNTERMODE_UP;
+  htim6.Init.Period            = 99;
+  htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+  if (HAL_TIM_Base_Init(&htim6) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterSlaveMode     = TIM_MASTERSLAVEMODE_DISABLE;
+
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim6, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM6_Init 2 */
+
+  /* USER CODE END TIM6_Init 2 */
+
+}
+
 /**
  * @brief USART1 Initialization Function
  * @param None
@@ -693,10 +779,32 @@ static void MX_DMA_Init(void)
   /* DMA controller clock enable */
   __HAL_RCC_DMA1_CLK_ENABLE();
 
+  /* Configure DMA request hdma_memtomem_dma1_channel4 on DMA1_Channel4 */
+  hdma_memtomem_dma1_channel4.Instance                 = DMA1_Channel4;
+  hdma_memtomem_dma1_channel4.Init.Request             = DMA_REQUEST_0;
+  hdma_memtomem_dma1_channel4.Init.Direction           = DMA_MEMORY_TO_MEMORY;
+  hdma_memtomem_dma1_channel4.Init.PeriphInc           = DMA_PINC_ENABLE;
+  hdma_memtomem_dma1_channel4.Init.MemInc              = DMA_MINC_DISABLE;
+  hdma_memtomem_dma1_channel4.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+  hdma_memtomem_dma1_channel4.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+  hdma_memtomem_dma1_channel4.Init.Mode                = DMA_NORMAL;
+  hdma_memtomem_dma1_channel4.Init.Priority            = DMA_PRIORITY_LOW;
+
+  if (HAL_DMA_Init(&hdma_memtomem_dma1_channel4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
   /* DMA interrupt init */
   /* DMA1_Channel1_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+  /* DMA1_Channel2_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+  /* DMA1_Channel3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
 
 }
 
@@ -776,11 +884,21 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
-  /*Configure GPIO pins : R_FLT_Pin R_DIN_Pin */
-  GPIO_InitStruct.Pin  = R_FLT_Pin | R_DIN_Pin;
+  /*Configure GPIO pin : R_FLT_Pin */
+  GPIO_InitStruct.Pin  = R_FLT_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(R_FLT_GPIO_Port, &GPIO_InitStruct);
+
+  /*Configure GPIO pin : R_DIN_Pin */
+  GPIO_InitStruct.Pin  = R_DIN_Pin;
   GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
-  HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+  HAL_GPIO_Init(R_DIN_GPIO_Port, &GPIO_InitStruct);
+
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
 
 }
 
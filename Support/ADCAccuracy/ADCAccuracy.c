@@ -0,0 +1,161 @@
+/*
+ * ADCAccuracy.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: BFS
+ *
+ *  Description:
+ *    Host-side check of the fixed-point ADC conversion (Src/ADCConvert.c,
+ *    as used by Src/ADC.c) against the double-precision conversion it
+ *    replaced. Every channel reading from 0 to ADC_MAX_COUNTS is tried
+ *    against every VREFINT reading that puts Vref between 1.8 V and 3.6 V,
+ *    for a spread of factory calibration values. Prints the largest
+ *    difference on each reading, and exits non-zero if any is over
+ *    ADC_ACCURACY_LIMIT.
+ *
+ *    The fixed-point conversion is built from the firmware's own source,
+ *    which doesn't depend on the HAL. The double-precision one is kept
+ *    here, as it was in ADC_Process() before.
+ *
+ *    Build and run from this directory with any host C compiler:
+ *      gcc -O2 -Wall -I../../Inc -o ADCAccuracy ADCAccuracy.c ../../Src/ADCConvert.c && ./ADCAccuracy
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ADC.h"
+#include "ADCConvert.h"
+
+// Largest difference allowed, in mV or degrees C.
+#define ADC_ACCURACY_LIMIT                 (1)
+
+// Range of Vref (mV) the part runs over.
+#define ADC_ACCURACY_VREF_MIN              (1800)
+#define ADC_ACCURACY_VREF_MAX              (3600)
+
+typedef struct
+{
+  uint16_t    nVrefCal;
+  uint16_t    nTempCal1;
+  uint16_t    nTempCal2;
+} ADCAccuracy_Calibration_T;
+
+// Around the typical values, and out to either side of them.
+static const ADCAccuracy_Calibration_T    m_aCalibration[] =
+{
+  {1655, 1034, 1375},
+  {1600,  990, 1320},
+  {1600, 1080, 1430},
+  {1710,  990, 1430},
+  {1710, 1080, 1320},
+  {1500,  900, 1250},
+  {1800, 1150, 1500},
+};
+
+typedef struct
+{
+  const char *    pName;
+  int32_t         nMax;
+  uint32_t        nCounts;
+  uint32_t        nVrefIntCounts;
+  uint32_t        nCalibration;
+} ADCAccuracy_Result_T;
+
+static ADCAccuracy_Result_T    m_aResult[ADC_NUM_CHANNELS] =
+{
+  {"24V (mV)",        0, 0, 0, 0},
+  {"3V3 (mV)",        0, 0, 0, 0},
+  {"Temperature (C)", 0, 0, 0, 0},
+  {"VREFINT (mV)",    0, 0, 0, 0},
+};
+
+// Double-precision conversion, as it was in ADC_Process() before.
+// The temperature is the unfiltered reading.
+static void ADCAccuracy_ConvertDouble(const ADCAccuracy_Calibration_T * pCal, const uint16_t * aCounts, int32_t * aValues)
+{
+  uint16_t    ADC_Vref;
+  double      temporary;
+
+  ADC_Vref = (double)((uint32_t)pCal->nVrefCal * ADC_VREF_CAL_VOLT) /  aCounts[3];
+
+  aValues[0] = (uint16_t) ((double)aCounts[0] * ADC_Vref / ADC_MAX_COUNTS * 10590 / 590);
+  aValues[1] = (uint16_t) ((double)aCounts[1] * ADC_Vref / ADC_MAX_COUNTS * 25000 / 15000);
+
+  temporary  = ((double)aCounts[2] * (uint32_t)pCal->nVrefCal / aCounts[3]) - (uint32_t)pCal->nTempCal1;
+  temporary *= (double)(ADC_TEMP2 - ADC_TEMP1);
+  temporary /= (double)(int32_t)((uint32_t)pCal->nTempCal2 - (uint32_t)pCal->nTempCal1);
+
+  aValues[2] = (int32_t) (temporary + ADC_TEMP1);
+  aValues[3] = (uint16_t) ((double)aCounts[3] * ADC_Vref / ADC_MAX_COUNTS);
+}
+
+static void ADCAccuracy_Record(ADC_Input_T eInput, int32_t nDifference, const uint16_t * aCounts, uint32_t nCalibration)
+{
+  ADCAccuracy_Result_T*    pResult = &m_aResult[eInput];
+
+  nDifference = (nDifference < 0) ? -nDifference : nDifference;
+
+  if (nDifference > pResult->nMax)
+  {
+    pResult->nMax           = nDifference;
+    pResult->nCounts        = aCounts[eInput];
+    pResult->nVrefIntCounts = aCounts[ADC_INPUT_VREFINT];
+    pResult->nCalibration   = nCalibration;
+  }
+}
+
+int main(void)
+{
+  uint64_t    nCombinations = 0;
+  bool        bPass         = true;
+
+  for (uint32_t nCalibration = 0; nCalibration < sizeof(m_aCalibration) / sizeof(m_aCalibration[0]); nCalibration++)
+  {
+    const ADCAccuracy_Calibration_T*    pCal = &m_aCalibration[nCalibration];
+    uint32_t    nVrefIntMin = ((uint32_t) pCal->nVrefCal * ADC_VREF_CAL_VOLT + ADC_ACCURACY_VREF_MAX - 1) / ADC_ACCURACY_VREF_MAX;
+    uint32_t    nVrefIntMax = ((uint32_t) pCal->nVrefCal * ADC_VREF_CAL_VOLT) / ADC_ACCURACY_VREF_MIN;
+
+    ADCConvert_T    sConvert;
+
+    ADCConvert_Init(&sConvert, pCal->nVrefCal, pCal->nTempCal1, pCal->nTempCal2);
+
+    for (uint32_t nVrefInt = nVrefIntMin; nVrefInt <= nVrefIntMax; nVrefInt++)
+    {
+      for (uint32_t nCounts = 0; nCounts <= ADC_MAX_COUNTS; nCounts++)
+      {
+        uint16_t    aCounts[ADC_NUM_CHANNELS] = {nCounts, nCounts, nCounts, nVrefInt};
+        int32_t     aFixed[ADC_NUM_CHANNELS];
+        int32_t     aDouble[ADC_NUM_CHANNELS];
+
+        ADCConvert_Sequence(&sConvert, aCounts, aFixed);
+        ADCAccuracy_ConvertDouble(pCal, aCounts, aDouble);
+
+        ADCAccuracy_Record(ADC_INPUT_24V, aFixed[ADC_INPUT_24V] - aDouble[ADC_INPUT_24V], aCounts, nCalibration);
+        ADCAccuracy_Record(ADC_INPUT_3V3, aFixed[ADC_INPUT_3V3] - aDouble[ADC_INPUT_3V3], aCounts, nCalibration);
+        ADCAccuracy_Record(ADC_INPUT_TEMPERATURE, (aFixed[ADC_INPUT_TEMPERATURE] / 256) - aDouble[ADC_INPUT_TEMPERATURE], aCounts, nCalibration);
+        ADCAccuracy_Record(ADC_INPUT_VREFINT, aFixed[ADC_INPUT_VREFINT] - aDouble[ADC_INPUT_VREFINT], aCounts, nCalibration);
+
+        nCombinations++;
+      }
+    }
+  }
+
+  printf("%llu combinations of readings and calibration values\n", (unsigned long long) nCombinations);
+
+  for (uint32_t nInput = 0; nInput < ADC_NUM_CHANNELS; nInput++)
+  {
+    ADCAccuracy_Result_T*    pResult = &m_aResult[nInput];
+
+    printf("%-16s largest difference %ld (counts %lu, VREFINT %lu, calibration %lu)\n",
+           pResult->pName, (long) pResult->nMax, (unsigned long) pResult->nCounts,
+           (unsigned long) pResult->nVrefIntCounts, (unsigned long) pResult->nCalibration);
+
+    bPass = bPass && (pResult->nMax <= ADC_ACCURACY_LIMIT);
+  }
+
+  printf("%s\n", bPass ? "PASS" : "FAIL");
+
+  return bPass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
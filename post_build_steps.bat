@@ -11,6 +11,9 @@ echo.
 echo Generating the CRC checksum...
 C:\ST\STM32CubeIDE_1.4.0\STM32CubeIDE\plugins\com.st.stm32cube.ide.mcu.externaltools.gnu-tools-for-stm32.7-2018-q2-update.win32_1.4.0.202007081208\tools\arm-none-eabi\bin\objcopy.exe -O ihex "%project_name%.elf"  "%project_name%.hex"
 ..\srecord-1.64-win32\srec_cat.exe "%project_name%.hex" -Intel -fill 0xFF 0x08000000 0x0801FFFC -STM32 0x0801FFFC -o "%project_name%_CRC.hex" -Intel
+echo.
+echo RAM by section (bytes)...
+C:\ST\STM32CubeIDE_1.4.0\STM32CubeIDE\plugins\com.st.stm32cube.ide.mcu.externaltools.gnu-tools-for-stm32.7-2018-q2-update.win32_1.4.0.202007081208\tools\arm-none-eabi\bin\size.exe -A -d "%project_name%.elf" | findstr /b ".ramfunc .data .bss"
 pause
 exit
 